@@ -2,28 +2,55 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cstdlib>
 #include <algorithm>
+#include <numeric>
 #include <random>
 #include <chrono>
 #include <thread>
 #include <typeinfo>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <functional>
+#include <new>
+#include <cerrno>
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+const char RANDOM_CHARACTERS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"; // Printable, so a random string stays on its line
 
 // This code is used to create a function that generates a random string of a specified length.
 std::string generateRandomString(size_t length)
 {
-    std::string randomString;                     // String to store random string
-    std::random_device rd;                        // Obtain a random number from hardware
-    std::mt19937 gen(rd());                       // Seed the generator
-    std::uniform_int_distribution<> dis(11, 1e6); // Define the range
+    std::string randomString;                                             // String to store random string
+    std::random_device rd;                                                // Obtain a random number from hardware
+    std::mt19937 gen(rd());                                               // Seed the generator
+    std::uniform_int_distribution<> dis(0, sizeof(RANDOM_CHARACTERS) - 2); // Define the range
     for (size_t i = 0; i < length; ++i)
     {
-        randomString += static_cast<char>(dis(gen)); // Generate random string
+        randomString += RANDOM_CHARACTERS[dis(gen)]; // Generate random string
     }
     return randomString;
 }
@@ -78,6 +105,42 @@ std::string decryptPassword(const std::string &encryptedPassword, const std::str
     return decryptedPassword;
 }
 
+// This function returns key, or a new random key of the same length if key would encrypt password into a string
+// with a line break in it, which would break up the lines of the user file.
+std::string lineSafeKey(const std::string &key, const std::string &password)
+{
+    std::string safeKey = key.empty() ? generateRandomString(1) : key;
+    for (size_t k = 0; k < safeKey.length(); ++k)
+    {
+        // Whether character c of the key would encrypt one of the characters of the password it is used for into a line break
+        auto breaksLine = [&](char c)
+        {
+            for (size_t i = k; i < password.length(); i += safeKey.length())
+            {
+                if ((password[i] ^ c) == '\n' || (password[i] ^ c) == '\r')
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+        const char *candidate = RANDOM_CHARACTERS + std::random_device()() % (sizeof(RANDOM_CHARACTERS) - 1);
+        for (size_t tried = 0; breaksLine(safeKey[k]); ++tried, ++candidate)
+        {
+            if (tried == sizeof(RANDOM_CHARACTERS) - 1)
+            {
+                throw FinancialException("Error saving user data: The password cannot be encrypted with a key this short.");
+            }
+            if (*candidate == '\0')
+            {
+                candidate = RANDOM_CHARACTERS;
+            }
+            safeKey[k] = *candidate;
+        }
+    }
+    return safeKey;
+}
+
 class InvalidPeriodException : public FinancialException
 {
 public:
@@ -90,613 +153,8939 @@ public:
     InvalidCategoryException() : FinancialException("Invalid category specified.") {}
 };
 
-// This is a class that represents a date. It has three members: day, month, and year.
-// It is used to store the date of a particular event.
+// Instrumentation
+// Built with PFM_STATS defined (the Makefile does so when it is run with STATS=1), the hot paths record how long
+// they take in latency histograms and count the bytes read and written, the allocations made and the transactions
+// scanned. The statistics menu and the "stats" command print them, and they can be dumped as JSON.
+// Without PFM_STATS the STAT_ macros expand to nothing, so the instrumentation costs nothing at all.
 
-class Date
+#ifdef PFM_STATS
+
+enum StatCounter
+{
+    STAT_BYTES_READ,
+    STAT_BYTES_WRITTEN,
+    STAT_ALLOCATIONS,
+    STAT_TRANSACTIONS_SCANNED,
+    STAT_REPORT_CACHE_HITS,
+    STAT_REPORT_CACHE_MISSES,
+    STAT_COUNTER_COUNT
+};
+
+const char *const STAT_COUNTER_NAMES[STAT_COUNTER_COUNT] = {"bytes_read", "bytes_written", "allocations", "transactions_scanned",
+                                                            "report_cache_hits", "report_cache_misses"};
+
+// Plain atomics with static storage, zeroed before anything runs, so that operator new can count into them
+std::atomic<uint64_t> statCounters[STAT_COUNTER_COUNT];
+
+// This class is a histogram of latencies in nanoseconds that several threads can record into at once.
+// Every power of two is split into 16 buckets, so percentiles read from it are within about 6%.
+class LatencyHistogram
 {
 private:
-    int day;
-    int month;
-    int year;
+    static const size_t SUB_BUCKETS = 16;
+    static const size_t BUCKETS = 64 * SUB_BUCKETS;
 
-public:
-    Date(int day, int month, int year) : day(day), month(month), year(year) {}
+    std::string name;
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total; // Sum of the recorded latencies
+    std::atomic<uint64_t> maximum;
 
-    int getDay() const
+    static size_t bucketOf(uint64_t nanoseconds)
     {
-        return day;
+        size_t shift = 0;
+        while (nanoseconds >= 2 * SUB_BUCKETS)
+        {
+            nanoseconds >>= 1;
+            ++shift;
+        }
+        return shift == 0 ? static_cast<size_t>(nanoseconds) : (shift + 1) * SUB_BUCKETS + static_cast<size_t>(nanoseconds - SUB_BUCKETS);
     }
 
-    int getMonth() const
+    static uint64_t bucketLimit(size_t bucket) // The largest latency that falls into bucket
     {
-        return month;
+        if (bucket < 2 * SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        size_t shift = bucket / SUB_BUCKETS - 1;
+        return ((SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift) - 1;
     }
 
-    int getYear() const
-    {
-        return year;
-    }
-    bool checkValidity() // checks if the date is valid or not
+public:
+    explicit LatencyHistogram(const std::string &name) : name(name), count(0), total(0), maximum(0)
     {
-        if (day < 1 || day > 31 || month < 1 || month > 12 || year < 0)
-            return false;
-        if ((month == 4 || month == 6 || month == 9 || month == 11) && day > 30)
-            return false;
-        else if (month == 2)
+        for (auto &bucket : buckets)
         {
-            if (year % 4 == 0 && day > 29)
-                return false;
-            else if (year % 4 != 0 && day > 28)
-                return false;
+            bucket.store(0, std::memory_order_relaxed);
         }
-        else
-            return true;
     }
-};
-
-// This code creates a Category class, which contains a string that stores the name of the category.
-// The class has a constructor that takes a string as a parameter, and sets the name of the category to that string.
-// It has a getter method that returns the name of the category.
-
-class Category
-{
-private:
-    std::string name;
-
-public:
-    Category(const std::string &name) : name(name) {}
 
-    const std::string &getName() const
+    void record(uint64_t nanoseconds)
     {
-        return name;
+        buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (nanoseconds > seen && !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed))
+        {
+        }
     }
-};
-
-// This code creates a base class for transactions.
-// It includes a constructor that takes a double, a string, and a Date.
-// It also includes a virtual destructor, a virtual function that returns the amount,
-// a virtual function that returns the Date, and a virtual function that displays the transaction.
-// It also includes a getter for the description.
-// The class is abstract, so it cannot be instantiated.
-// Members:
-// amount: the amount of the transaction
-// description: a description of the transaction
-// date: the date of the transaction
-
-class Transaction
-{
-protected:
-    double amount;
-    std::string description;
-    Date date;
-
-public:
-    Transaction(double amount, const std::string &description, const Date &date)
-        : amount(amount), description(description), date(date) {}
 
-    virtual double getAmount() const
+    const std::string &getName() const // Getter for name
     {
-        return amount;
+        return name;
     }
 
-    virtual const Date &getDate() const
+    uint64_t getCount() const // Getter for the number of recorded latencies
     {
-        return date;
+        return count.load(std::memory_order_relaxed);
     }
 
-    const std::string &getDescription() const
+    uint64_t getTotal() const // Getter for the sum of the recorded latencies
     {
-        return description;
+        return total.load(std::memory_order_relaxed);
     }
 
-    virtual void display() const = 0;
-
-    virtual ~Transaction() {}
-};
-
-// This code is used to create income and expense objects, which are used in the Budget class.
-// The Income class is a subclass of Transaction, and it has a constructor that takes a double, a string, and a Date.
-// It also has a display method that displays the amount and description of the income.
-
-class Income : public Transaction
-{
-public:
-    Income(double amount, const std::string &description, const Date &date)
-        : Transaction(amount, description, date) {}
-
-    void display() const override
+    uint64_t getMaximum() const // Getter for the largest recorded latency
     {
-        std::cout << "Income: +" << amount << " BDT - " << description << std::endl;
+        return maximum.load(std::memory_order_relaxed);
     }
-};
-
-// The Expense class is a subclass of Transaction, and it has a constructor that takes a double, a string, a Date, and a Category.
-
-class Expense : public Transaction
-{
-private:
-    Category category; // Category of the expense
-
-public:
-    Expense(double amount, const std::string &description, const Date &date, const Category &category)
-        : Transaction(amount, description, date), category(category) {}
 
-    const Category &getCategory() const
+    uint64_t percentile(double fraction) const // Latency that the given fraction of the recorded ones do not exceed
     {
-        return category;
+        uint64_t recorded = getCount();
+        if (recorded == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * recorded)));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+        {
+            seen += buckets[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                return std::min(bucketLimit(bucket), getMaximum());
+            }
+        }
+        return getMaximum();
     }
 
-    void display() const override
+    void reset()
     {
-        std::cout << "Expense: -" << amount << " BDT - " << description << std::endl;
+        for (auto &bucket : buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
     }
 };
 
-std::set<std::string> users;         // Set of usernames, used to check if a username is already taken
-class User;                          // Forward declaration of User class
-void saveUserData(const User &user); // Forward declaration of saveUserData function
-
-// This code creates a User class, which contains a string that stores the username and a string that stores the password.
-// It also contains a double that stores the balance, and a vector of Transaction pointers that stores the transactions.
-
-class User
+// This class holds the latency histogram of every instrumented operation, by name.
+class Stats
 {
 private:
-    std::string id;
-    std::string username;
-    std::string password;
-    double balance;
-    std::vector<Transaction *> transactions; // Vector of Transaction pointers, used to store transactions
+    mutable std::mutex mutex;
+    std::deque<LatencyHistogram> histograms; // A deque, so that histograms do not move when more are added
+
+    Stats() {}
 
 public:
-    User(const std::string &username, const std::string &password) // Constructor that takes a username and a password
-        : username(username), password(password), balance(0.0)
+    static Stats &instance()
     {
-        id = generateRandomString(username.length()); // Generate a random string of the same length as the username, used as a key to encrypt the password
+        static Stats stats;
+        return stats;
     }
 
-    void deepcopy(const User &user) // Deep copy function, used in copy constructor and assignment operator
+    LatencyHistogram &histogram(const std::string &name) // The histogram of an operation, created on first use
     {
-        id = user.id;
-        username = user.username;
-        password = user.password;
-        balance = user.balance;
-        for (const auto &transaction : user.transactions) // Copy transactions
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &histogram : histograms)
         {
-            // using dynamic cast to check if the transaction is an income or expense transaction
-            const Income *incomeTransaction = dynamic_cast<const Income *>(transaction);    // Check if transaction is an income transaction
-            const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction); // Check if transaction is an expense transaction
-            if (incomeTransaction)
-            {
-                transactions.push_back(new Income(incomeTransaction->getAmount(), incomeTransaction->getDescription(), incomeTransaction->getDate()));
-            }
-            else if (expenseTransaction)
+            if (histogram.getName() == name)
             {
-                transactions.push_back(new Expense(expenseTransaction->getAmount(), expenseTransaction->getDescription(), expenseTransaction->getDate(), expenseTransaction->getCategory()));
+                return histogram;
             }
         }
+        histograms.emplace_back(name);
+        return histograms.back();
     }
 
-    User(const User &user) // Copy constructor
+    template <typename Visitor>
+    void forEachHistogram(Visitor visit) const // Call visit for every histogram, in name order
     {
-        deepcopy(user); // Call deepcopy function
+        std::vector<const LatencyHistogram *> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &histogram : histograms)
+            {
+                sorted.push_back(&histogram);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const LatencyHistogram *a, const LatencyHistogram *b)
+                  { return a->getName() < b->getName(); });
+        for (const LatencyHistogram *histogram : sorted)
+        {
+            visit(*histogram);
+        }
     }
 
-    User &operator=(const User &user) // Assignment operator
+    void reset()
     {
-        if (this != &user)
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &histogram : histograms)
         {
-            for (const auto &transaction : transactions) // free memory allocated to transactions
-            {
-                delete transaction;
-            }
-            transactions.clear();
-            deepcopy(user);
+            histogram.reset();
+        }
+        for (auto &counter : statCounters)
+        {
+            counter.store(0, std::memory_order_relaxed);
         }
-        return *this; // Return a reference to the current object, so that the assignment operator can be chained
     }
+};
 
-    const std::string &getId() const // Getter for id
+// This class records the time from its construction to the end of the enclosing scope into a histogram.
+class ScopedTimer
+{
+private:
+    LatencyHistogram &histogram;
+    std::chrono::steady_clock::time_point started;
+
+public:
+    explicit ScopedTimer(LatencyHistogram &histogram) : histogram(histogram), started(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer()
     {
-        return id;
+        histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count()));
     }
+};
 
-    const std::string &getUsername() const // Getter for username
+#define PFM_STAT_CONCAT_(a, b) a##b
+#define PFM_STAT_CONCAT(a, b) PFM_STAT_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as the operation called name. The histogram is looked up once per call site.
+#define STAT_TIMER(name)                                                                                      \
+    static LatencyHistogram &PFM_STAT_CONCAT(statHistogram, __LINE__) = Stats::instance().histogram(name); \
+    ScopedTimer PFM_STAT_CONCAT(statTimer, __LINE__)(PFM_STAT_CONCAT(statHistogram, __LINE__))
+
+// Adds amount to one of the counters
+#define STAT_ADD(counter, amount) statCounters[counter].fetch_add(static_cast<uint64_t>(amount), std::memory_order_relaxed)
+
+// Every allocation goes through these, so that they can be counted
+void *operator new(std::size_t size)
+{
+    STAT_ADD(STAT_ALLOCATIONS, 1);
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (!memory)
     {
-        return username;
+        throw std::bad_alloc();
     }
+    return memory;
+}
 
-    const std::string &getPassword() const // Getter for password, typically not used
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC does not see that operator new above is malloc
+#endif
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// This function prints the latency of every operation and the counters as a table.
+void printStats(std::ostream &out)
+{
+    out << std::left << std::setw(34) << "Operation" << std::right << std::setw(10) << "Count" << std::setw(12) << "p50 (us)"
+        << std::setw(12) << "p99 (us)" << std::setw(12) << "max (us)" << std::setw(14) << "total (ms)" << "\n";
+    out << std::fixed;
+    Stats::instance().forEachHistogram([&](const LatencyHistogram &histogram)
+                                       {
+                                           if (histogram.getCount() == 0)
+                                           {
+                                               return;
+                                           }
+                                           out << std::left << std::setw(34) << histogram.getName() << std::right << std::setw(10) << histogram.getCount()
+                                               << std::setprecision(1) << std::setw(12) << histogram.percentile(0.5) / 1e3
+                                               << std::setw(12) << histogram.percentile(0.99) / 1e3 << std::setw(12) << histogram.getMaximum() / 1e3
+                                               << std::setprecision(3) << std::setw(14) << histogram.getTotal() / 1e6 << "\n"; });
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6) << "\n";
+    for (size_t i = 0; i < STAT_COUNTER_COUNT; ++i)
     {
-        return password;
+        out << std::left << std::setw(34) << STAT_COUNTER_NAMES[i] << std::right << std::setw(10) << statCounters[i].load() << "\n";
     }
+    out.flush();
+}
 
-    const std::vector<Transaction *> &getTransactions() const // Getter for transactions
+// This function writes the statistics as JSON, with latencies in nanoseconds.
+void writeStatsJson(std::ostream &out)
+{
+    out << "{\n  \"operations\": [";
+    bool first = true;
+    Stats::instance().forEachHistogram([&](const LatencyHistogram &histogram)
+                                       {
+                                           out << (first ? "\n" : ",\n") << "    {\"name\": \"" << histogram.getName() << "\", \"count\": " << histogram.getCount()
+                                               << ", \"p50_ns\": " << histogram.percentile(0.5) << ", \"p99_ns\": " << histogram.percentile(0.99)
+                                               << ", \"max_ns\": " << histogram.getMaximum() << ", \"total_ns\": " << histogram.getTotal() << "}";
+                                           first = false; });
+    out << "\n  ],\n  \"counters\": {";
+    for (size_t i = 0; i < STAT_COUNTER_COUNT; ++i)
     {
-        return transactions;
+        out << (i ? ", " : "") << "\"" << STAT_COUNTER_NAMES[i] << "\": " << statCounters[i].load();
     }
+    out << "}\n}\n";
+}
 
-    bool validatePassword(const std::string &inputPassword) const // Validate password
+bool statsEnabled()
+{
+    return true;
+}
+
+#else
+
+#define STAT_TIMER(name) ((void)0)
+#define STAT_ADD(counter, amount) ((void)0)
+
+void printStats(std::ostream &out)
+{
+    out << "Statistics are not compiled into this build. Build with make STATS=1 to record them." << std::endl;
+}
+
+void writeStatsJson(std::ostream &out)
+{
+    out << "{\"enabled\": false}\n";
+}
+
+bool statsEnabled()
+{
+    return false;
+}
+
+#endif
+
+// This function writes the statistics as JSON to a file.
+void dumpStats(const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file)
     {
-        return password == inputPassword;
+        throw FinancialException("Cannot write statistics to " + path + ".");
     }
+    writeStatsJson(file);
+}
 
-    void changePassword(const std::string &newPassword) // Change password
+// Formatting
+// Integers, amounts and dates are written into a buffer the caller provides rather than through the number
+// formatting of the streams, which consults the locale for every number, and rather than through a new string per
+// amount. Each function writes its text at out and returns the position just after it; none of them allocates.
+
+const size_t FORMAT_BUFFER_SIZE = 32; // Room for any integer, amount or date
+
+const char DIGIT_PAIRS[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                           "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                           "8081828384858687888990919293949596979899";
+
+char *formatUnsigned(char *out, uint64_t value)
+{
+    char digits[20];
+    char *p = digits + sizeof(digits);
+    while (value >= 100) // Two digits at a time
     {
-        password = newPassword;                             // Change password
-        std::remove(("data/" + username + ".txt").c_str()); // Delete user file and save updated user data
-        saveUserData(*this);                                // Save updated user data
+        p -= 2;
+        std::memcpy(p, DIGIT_PAIRS + 2 * (value % 100), 2);
+        value /= 100;
+    }
+    if (value >= 10)
+    {
+        p -= 2;
+        std::memcpy(p, DIGIT_PAIRS + 2 * value, 2);
+    }
+    else
+    {
+        *--p = static_cast<char>('0' + value);
     }
+    size_t length = static_cast<size_t>(digits + sizeof(digits) - p);
+    std::memcpy(out, p, length);
+    return out + length;
+}
 
-    double getBalance() const // Getter for balance
+char *formatInteger(char *out, int64_t value)
+{
+    if (value < 0)
     {
-        return balance;
+        *out++ = '-';
+        return formatUnsigned(out, 0 - static_cast<uint64_t>(value));
     }
+    return formatUnsigned(out, static_cast<uint64_t>(value));
+}
 
-    void setBalance(double newBalance) // Setter for balance
+char *formatTwoDigits(char *out, unsigned value) // A value below 100, with a leading zero below 10
+{
+    std::memcpy(out, DIGIT_PAIRS + 2 * value, 2);
+    return out + 2;
+}
+
+// This function writes length characters of text to stream as the inserter of strings does, padded to the width set
+// on the stream with its fill character, on the left unless std::left is set. The width is reset afterwards.
+void writeFormatted(std::ostream &stream, const char *text, size_t length)
+{
+    std::streamsize padding = stream.width() > static_cast<std::streamsize>(length) ? stream.width() - static_cast<std::streamsize>(length) : 0;
+    stream.width(0);
+    bool left = (stream.flags() & std::ios::adjustfield) == std::ios::left;
+    if (!left)
     {
-        balance = newBalance;
+        for (; padding > 0; --padding)
+            stream.put(stream.fill());
     }
+    stream.write(text, static_cast<std::streamsize>(length));
+    for (; padding > 0; --padding)
+        stream.put(stream.fill());
+}
 
-    void addTransaction(Transaction *transaction) // Add new transaction to transactions vector
+// This class collects what is written to it in a buffer of its own and passes it on to the stream buffer of a stream
+// whenever the buffer is full, and when it is flushed or destroyed. Writers that put records together from many small
+// pieces use it, so that a piece is a copy into the buffer rather than a call into the stream. Nothing else may be
+// written to the stream while a RecordWriter holds text for it.
+class RecordWriter
+{
+private:
+    std::ostream &stream;
+    char buffer[8192];
+    size_t used;
+
+    void pass(const char *text, size_t length)
     {
-        // using dynamic cast to check if the transaction is an income or expense transaction
-        transactions.push_back(transaction);
-        if (dynamic_cast<Income *>(transaction))
+        if (stream.rdbuf()->sputn(text, static_cast<std::streamsize>(length)) != static_cast<std::streamsize>(length))
         {
-            balance += transaction->getAmount(); // Add amount to balance
+            stream.setstate(std::ios::badbit);
         }
-        else if (dynamic_cast<Expense *>(transaction))
+    }
+
+public:
+    explicit RecordWriter(std::ostream &stream) : stream(stream), used(0) {}
+
+    RecordWriter(const RecordWriter &) = delete;
+    RecordWriter &operator=(const RecordWriter &) = delete;
+
+    ~RecordWriter()
+    {
+        flush();
+    }
+
+    char *reserve(size_t length) // Room to format up to length characters into; pass the end of what was formatted to commit
+    {
+        if (length > sizeof(buffer) - used)
         {
-            balance -= transaction->getAmount(); // Subtract amount from balance
+            flush();
         }
-        saveUserData(*this); // Save updated user data
+        return buffer + used;
+    }
+
+    void commit(const char *end)
+    {
+        used = static_cast<size_t>(end - buffer);
     }
 
-    void removeTransaction(int index) // Remove transaction at index
+    void write(const char *text, size_t length)
     {
-        if (index >= 0 && index < transactions.size())
+        if (length > sizeof(buffer) - used)
         {
-            Transaction *transaction = transactions[index]; // Get transaction at index
-            if (dynamic_cast<Income *>(transaction))        // Check if transaction is an income transaction
-            {
-                balance -= transaction->getAmount(); // Subtract amount from balance
-            }
-            else if (dynamic_cast<Expense *>(transaction)) // Check if transaction is an expense transaction
+            flush();
+            if (length > sizeof(buffer))
             {
-                balance += transaction->getAmount(); // Add amount to balance
+                pass(text, length);
+                return;
             }
-            transactions.erase(transactions.begin() + index); // Remove transaction from transactions vector
-            delete transaction;                               // Free memory allocated to transaction
-            saveUserData(*this);                              // Save updated user data
         }
+        std::memcpy(buffer + used, text, length);
+        used += length;
     }
 
-    double calculateOverallBalance() const // Calculate overall balance
+    void write(const std::string &text)
     {
-        return balance;
+        write(text.data(), text.size());
     }
 
-    double calculateIncomeForPeriod(const Date &startDate, const Date &endDate) const // Calculate income for a period
+    void put(char c)
     {
-        double income = 0.0;
-        for (const auto &transaction : transactions)
+        if (used == sizeof(buffer))
         {
-            const Income *incomeTransaction = dynamic_cast<const Income *>(transaction); // Check if transaction is an income transaction
-            if (incomeTransaction && isDateInRange(incomeTransaction->getDate(), startDate, endDate))
-            {
-                income += incomeTransaction->getAmount();
-            }
+            flush();
         }
-        return income;
+        buffer[used++] = c;
     }
 
-    double calculateExpensesForPeriod(const Date &startDate, const Date &endDate) const // Calculate expenses for a period
+    void flush()
     {
-        double expenses = 0.0;
-        for (const auto &transaction : transactions) // Check if transaction is an expense transaction
+        if (used > 0)
         {
-            const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
-            if (expenseTransaction && isDateInRange(expenseTransaction->getDate(), startDate, endDate))
-            {
-                expenses += expenseTransaction->getAmount();
-            }
+            pass(buffer, used);
+            used = 0;
         }
-        return expenses;
     }
+};
+
+// This is a class that represents a date. It has three members: day, month, and year.
+// It is used to store the date of a particular event.
+// Alongside the calendar fields the date carries its ordinal (days since 01/01/1970),
+// so comparing two dates or taking their difference is a single integer operation.
+
+class Date
+{
+private:
+    int32_t ordinal; // Days since 01/01/1970, used for comparison and difference
+    int16_t year;
+    int8_t month;
+    int8_t day;
 
-    double calculateNetSavingsForPeriod(const Date &startDate, const Date &endDate) const // Calculate net savings for a period
+    // Helpers for the days-from-civil conversion. Each one is a single expression so that
+    // the conversion stays constexpr under C++11.
+    static constexpr int32_t shiftedYear(int32_t y, int32_t m) { return m <= 2 ? y - 1 : y; } // Years start in March
+    static constexpr int32_t eraOfYear(int32_t y) { return (y >= 0 ? y : y - 399) / 400; }
+    static constexpr int32_t dayOfShiftedYear(int32_t m, int32_t d) { return (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1; }
+    static constexpr int32_t dayOfEra(int32_t yoe, int32_t doy) { return yoe * 365 + yoe / 4 - yoe / 100 + doy; }
+    static constexpr int32_t daysFromShifted(int32_t y, int32_t m, int32_t d)
     {
-        double income = calculateIncomeForPeriod(startDate, endDate);
-        double expenses = calculateExpensesForPeriod(startDate, endDate);
-        return income - expenses;
+        return eraOfYear(y) * 146097 + dayOfEra(y - eraOfYear(y) * 400, dayOfShiftedYear(m, d)) - 719468;
     }
 
-    double calculateExpensesByCategory(const std::string &categoryName) const // Calculate expenses by category
+    // Helpers for the inverse (civil-from-days) conversion
+    static constexpr int32_t eraOfDays(int32_t z) { return (z >= 0 ? z : z - 146096) / 146097; }
+    static constexpr int32_t dayOfEraFromDays(int32_t z) { return z - eraOfDays(z) * 146097; }
+    static constexpr int32_t yearOfEra(int32_t doe) { return (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; }
+    static constexpr int32_t dayOfYearFromDoe(int32_t doe) { return doe - dayOfEra(yearOfEra(doe), 0); }
+    static constexpr int32_t shiftedMonth(int32_t doy) { return (5 * doy + 2) / 153; }
+    static constexpr int32_t dayFromDoy(int32_t doy) { return doy - (153 * shiftedMonth(doy) + 2) / 5 + 1; }
+    static constexpr int32_t monthFromDoy(int32_t doy) { return shiftedMonth(doy) < 10 ? shiftedMonth(doy) + 3 : shiftedMonth(doy) - 9; }
+
+public:
+    static constexpr int32_t daysFromCivil(int32_t y, int32_t m, int32_t d) // Convert a calendar date to days since 01/01/1970
     {
-        double expenses = 0.0;
-        for (const auto &transaction : transactions)
+        return daysFromShifted(shiftedYear(y, m), m, d);
+    }
+
+    static constexpr int32_t dayFromDays(int32_t days) // Day of month of an ordinal
+    {
+        return dayFromDoy(dayOfYearFromDoe(dayOfEraFromDays(days + 719468)));
+    }
+
+    static constexpr int32_t monthFromDays(int32_t days) // Month of an ordinal
+    {
+        return monthFromDoy(dayOfYearFromDoe(dayOfEraFromDays(days + 719468)));
+    }
+
+    static constexpr int32_t yearFromDays(int32_t days) // Year of an ordinal
+    {
+        return yearOfEra(dayOfEraFromDays(days + 719468)) + eraOfDays(days + 719468) * 400 + (monthFromDays(days) <= 2 ? 1 : 0);
+    }
+
+    // Out of range fields are stored as 0 (or -1 for the year) so that they can never wrap around
+    // into a valid value; checkValidity() rejects them.
+    constexpr Date(int day, int month, int year)
+        : ordinal(daysFromCivil(year, month, day)),
+          year(year < 0 || year > 9999 ? -1 : year),
+          month(month < 1 || month > 12 ? 0 : month),
+          day(day < 1 || day > 31 ? 0 : day) {}
+
+    constexpr Date() : Date(1, 1, 1970) {}
+
+    static constexpr Date fromOrdinal(int32_t days) // Create a date from days since 01/01/1970
+    {
+        return Date(dayFromDays(days), monthFromDays(days), yearFromDays(days));
+    }
+
+    constexpr int getDay() const
+    {
+        return day;
+    }
+
+    constexpr int getMonth() const
+    {
+        return month;
+    }
+
+    constexpr int getYear() const
+    {
+        return year;
+    }
+
+    constexpr int32_t toOrdinal() const // Days since 01/01/1970
+    {
+        return ordinal;
+    }
+
+    static constexpr bool isLeapYear(int year)
+    {
+        return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    }
+
+    static constexpr int daysInMonth(int month, int year)
+    {
+        return month == 2 ? (isLeapYear(year) ? 29 : 28) : (month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31;
+    }
+
+    bool checkValidity() const // checks if the date is valid or not
+    {
+        if (day < 1 || month < 1 || month > 12 || year < 0)
+            return false;
+        return day <= daysInMonth(month, year);
+    }
+
+    // This function parses a dd/mm/yyyy date from the characters in [begin, end) without allocating.
+    // Day and month may have one or two digits, the year one to four. Trailing spaces and '\r' are ignored.
+    // Returns false if the text is not a date; the parsed date still has to pass checkValidity().
+    static bool parse(const char *begin, const char *end, Date &date)
+    {
+        int fields[3] = {0, 0, 0};
+        const int maxDigits[3] = {2, 2, 4};
+        const char *p = begin;
+        for (int field = 0; field < 3; ++field)
         {
-            // Check if transaction is an expense transaction and if the category name matches
-            const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
-            if (expenseTransaction && expenseTransaction->getCategory().getName() == categoryName)
+            int digits = 0;
+            while (p != end && *p >= '0' && *p <= '9' && digits < maxDigits[field])
+            {
+                fields[field] = fields[field] * 10 + (*p - '0');
+                ++p;
+                ++digits;
+            }
+            if (digits == 0)
+                return false;
+            if (field < 2)
             {
-                expenses += expenseTransaction->getAmount(); // Add amount to expenses
+                if (p == end || *p != '/')
+                    return false;
+                ++p;
             }
         }
-        return expenses;
+        while (p != end && (*p == ' ' || *p == '\r'))
+            ++p;
+        if (p != end)
+            return false;
+        date = Date(fields[0], fields[1], fields[2]);
+        return true;
     }
 
-    // Generate reports
+    static bool parse(const std::string &text, Date &date)
+    {
+        return parse(text.data(), text.data() + text.size(), date);
+    }
 
-    // This function generates a summary report for a period specified by startDate and endDate.
-    void generateSummaryReport(const Date &startDate, const Date &endDate) const
+    char *format(char *out) const // Writes the date as dd/mm/yyyy, the form parse reads
     {
-        std::cout << "Summary Report from " << startDate.getDay() << "/" << startDate.getMonth() << "/" << startDate.getYear()
-                  << " to " << endDate.getDay() << "/" << endDate.getMonth() << "/" << endDate.getYear() << std::endl;
-        std::cout << "--------------------------------------" << std::endl;
-        std::cout << "Total Income: " << calculateIncomeForPeriod(startDate, endDate) << " BDT" << std::endl;
-        std::cout << "Total Expenses: " << calculateExpensesForPeriod(startDate, endDate) << " BDT" << std::endl;
-        std::cout << "Net Savings: " << calculateNetSavingsForPeriod(startDate, endDate) << " BDT" << std::endl;
-        std::cout << "--------------------------------------" << std::endl;
+        out = day >= 0 && day < 100 ? formatTwoDigits(out, static_cast<unsigned>(day)) : formatInteger(out, day);
+        *out++ = '/';
+        out = month >= 0 && month < 100 ? formatTwoDigits(out, static_cast<unsigned>(month)) : formatInteger(out, month);
+        *out++ = '/';
+        if (year >= 0 && year < 10000)
+        {
+            out = formatTwoDigits(out, static_cast<unsigned>(year / 100));
+            return formatTwoDigits(out, static_cast<unsigned>(year % 100));
+        }
+        return formatInteger(out, year);
     }
 
-    // This function generates a category report for a category specified by categoryName.
-    void generateCategoryReport(const std::string &categoryName) const
+    static Date today() // The current local date
     {
-        std::cout << "Category Report: " << categoryName << std::endl;
-        std::cout << "--------------------------------------" << std::endl;
-        std::cout << "Total Expenses in Category: " << calculateExpensesByCategory(categoryName) << " BDT" << std::endl;
-        std::cout << "--------------------------------------" << std::endl;
+        std::time_t now = std::time(nullptr);
+        std::tm local;
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local); // localtime is not safe to call from the batch report threads
+#endif
+        return Date(local.tm_mday, local.tm_mon + 1, local.tm_year + 1900);
     }
 
-    // This function generates a summary report for a period specified by startDate and endDate and saves it to a file.
-    void createSummaryReportFile(const Date &startDate, const Date &endDate) const
+    constexpr bool operator==(const Date &other) const { return ordinal == other.ordinal; }
+    constexpr bool operator!=(const Date &other) const { return ordinal != other.ordinal; }
+    constexpr bool operator<(const Date &other) const { return ordinal < other.ordinal; }
+    constexpr bool operator<=(const Date &other) const { return ordinal <= other.ordinal; }
+    constexpr bool operator>(const Date &other) const { return ordinal > other.ordinal; }
+    constexpr bool operator>=(const Date &other) const { return ordinal >= other.ordinal; }
+
+    constexpr int32_t operator-(const Date &other) const // Number of days between two dates
     {
-        std::string fileName = username + "_" + "summary_report_" + std::to_string(startDate.getDay()) + "_" + std::to_string(startDate.getMonth()) + "_" + std::to_string(startDate.getYear()) + "_" + std::to_string(endDate.getDay()) + "_" + std::to_string(endDate.getMonth()) + "_" + std::to_string(endDate.getYear()) + ".txt";
-        std::ofstream file("reports/" + fileName); // Open file
-        if (!file)
-        {
-            throw FinancialException("Error creating summary report file."); // Throw exception if file cannot be opened
-        }
+        return ordinal - other.ordinal;
+    }
+};
 
-        // Write report to file
-        file << "Summary Report from " << startDate.getDay() << "/" << startDate.getMonth() << "/" << startDate.getYear()
-             << " to " << endDate.getDay() << "/" << endDate.getMonth() << "/" << endDate.getYear() << std::endl;
-        file << "--------------------------------------" << std::endl;
-        file << "Total Income: " << calculateIncomeForPeriod(startDate, endDate) << " BDT" << std::endl;
-        file << "Total Expenses: " << calculateExpensesForPeriod(startDate, endDate) << " BDT" << std::endl;
-        file << "Net Savings: " << calculateNetSavingsForPeriod(startDate, endDate) << " BDT" << std::endl;
-        file << "--------------------------------------" << std::endl;
+static_assert(Date(1, 1, 1970).toOrdinal() == 0, "Date epoch must be 01/01/1970");
+static_assert(Date(29, 2, 2000).toOrdinal() == 11016, "Date conversion is broken");
+static_assert(Date::fromOrdinal(11016).getDay() == 29 && Date::fromOrdinal(11016).getMonth() == 2 &&
+                  Date::fromOrdinal(11016).getYear() == 2000,
+              "Date inverse conversion is broken");
 
-        file.close();
-        std::cout << "Summary report file created successfully." << std::endl;
+std::ostream &operator<<(std::ostream &stream, const Date &date)
+{
+    char text[FORMAT_BUFFER_SIZE];
+    writeFormatted(stream, text, static_cast<size_t>(date.format(text) - text));
+    return stream;
+}
+
+// This class represents an amount of money as a whole number of minor units (paisa/cents).
+// All arithmetic is exact 64-bit integer arithmetic, so balances do not drift over long histories
+// and amounts survive being written to and read back from the user file unchanged.
+
+class Money
+{
+private:
+    int64_t minorUnits; // Amount in 1/100 of the currency unit
+
+    constexpr explicit Money(int64_t minorUnits) : minorUnits(minorUnits) {}
+
+public:
+    static const int64_t MINOR_PER_UNIT = 100;
+    static const int FRACTION_DIGITS = 2;
+
+    constexpr Money() : minorUnits(0) {}
+
+    static constexpr Money fromMinorUnits(int64_t minorUnits)
+    {
+        return Money(minorUnits);
     }
 
-    // This function generates a category report for a category specified by categoryName and saves it to a file.
-    void createCategoryReportFile(const std::string &categoryName) const
+    constexpr int64_t getMinorUnits() const
     {
-        std::string fileName = username + "_" + categoryName + "_report.txt";
-        std::ofstream file("reports/" + fileName); // Open file
-        if (!file)
-        {
-            throw FinancialException("Error creating category report file."); // Throw exception if file cannot be opened
-        }
+        return minorUnits;
+    }
 
-        // Write report to file
-        file << "Category Report: " << categoryName << std::endl;
-        file << "--------------------------------------" << std::endl;
-        file << "Total Expenses in Category: " << calculateExpensesByCategory(categoryName) << " BDT" << std::endl;
-        file << "--------------------------------------" << std::endl;
+    Money &operator+=(const Money &other)
+    {
+        minorUnits += other.minorUnits;
+        return *this;
+    }
 
-        file.close();
-        std::cout << "Category report file created successfully." << std::endl;
+    Money &operator-=(const Money &other)
+    {
+        minorUnits -= other.minorUnits;
+        return *this;
     }
 
-    ~User() // Destructor
+    constexpr Money operator+(const Money &other) const { return Money(minorUnits + other.minorUnits); }
+    constexpr Money operator-(const Money &other) const { return Money(minorUnits - other.minorUnits); }
+    constexpr Money operator-() const { return Money(-minorUnits); }
+
+    Money dividedBy(int64_t divisor) const // Divide, rounding half away from zero
     {
-        // Free memory allocated to transactions
-        for (const auto &transaction : transactions)
+        int64_t quotient = minorUnits / divisor;
+        int64_t remainder = minorUnits % divisor;
+        if (2 * (remainder < 0 ? -remainder : remainder) >= (divisor < 0 ? -divisor : divisor))
         {
-            delete transaction;
+            quotient += (minorUnits < 0) == (divisor < 0) ? 1 : -1;
         }
+        return Money(quotient);
     }
 
-private:
-    bool isDateInRange(const Date &date, const Date &startDate, const Date &endDate) const // Check if date is in range
+    constexpr bool operator==(const Money &other) const { return minorUnits == other.minorUnits; }
+    constexpr bool operator!=(const Money &other) const { return minorUnits != other.minorUnits; }
+    constexpr bool operator<(const Money &other) const { return minorUnits < other.minorUnits; }
+    constexpr bool operator<=(const Money &other) const { return minorUnits <= other.minorUnits; }
+    constexpr bool operator>(const Money &other) const { return minorUnits > other.minorUnits; }
+    constexpr bool operator>=(const Money &other) const { return minorUnits >= other.minorUnits; }
+
+    // Formats the amount with exactly two fraction digits, e.g. "-1234.05"
+    char *format(char *out) const
     {
-        return date.getYear() >= startDate.getYear() && date.getYear() <= endDate.getYear() &&
-               date.getMonth() >= startDate.getMonth() && date.getMonth() <= endDate.getMonth() &&
-               date.getDay() >= startDate.getDay() && date.getDay() <= endDate.getDay();
+        uint64_t magnitude = minorUnits < 0 ? 0 - static_cast<uint64_t>(minorUnits) : static_cast<uint64_t>(minorUnits);
+        if (minorUnits < 0)
+        {
+            *out++ = '-';
+        }
+        out = formatUnsigned(out, magnitude / MINOR_PER_UNIT);
+        *out++ = '.';
+        return formatTwoDigits(out, static_cast<unsigned>(magnitude % MINOR_PER_UNIT));
     }
-};
 
-// This function saves the user data to a file.
-void saveUserData(const User &user)
-{
-    std::string key = user.getId();                            // Get key
-    std::ofstream file("data/" + user.getUsername() + ".txt"); // Open file associated with user
-    if (!file)
+    std::string toString() const
     {
-        throw FinancialException("Error saving user data: User file Cannot be opened."); // Throw exception if file cannot be opened
+        char text[FORMAT_BUFFER_SIZE];
+        return std::string(text, format(text));
     }
-    file.clear(); // Clear file contents in order to overwrite
 
-    // Write user data to file
-    file << key << std::endl;
-    file << encryptPassword(user.getPassword(), key) << std::endl;
-    file << user.getUsername() << std::endl;
-    file << user.getBalance() << std::endl;
-    for (const auto &transaction : user.getTransactions())
+    // This function parses a decimal amount such as "12", "-12.5" or "12.345" from the characters in
+    // [begin, end) without allocating. Digits beyond the second fraction digit are rounded half away
+    // from zero. An exponent ("1.5e+06") is accepted so that files written with the old double format
+    // still load. Returns false if the text is not a number or does not fit into 64 bits.
+    static bool parse(const char *begin, const char *end, Money &money)
     {
-        const Income *incomeTransaction = dynamic_cast<const Income *>(transaction);    // Check if transaction is an income transaction
-        const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction); // Check if transaction is an expense transaction
-        if (incomeTransaction)
+        const char *p = begin;
+        while (p != end && *p == ' ')
+            ++p;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+'))
+        {
+            negative = *p == '-';
+            ++p;
+        }
+        uint64_t digits = 0;    // Significant digits read so far
+        int scale = 0;          // Power of ten that digits has to be multiplied by
+        bool anyDigit = false;
+        bool inFraction = false;
+        bool dropping = false;  // Set once digits no longer fit into 'digits'
+        for (; p != end; ++p)
+        {
+            if (*p == '.' && !inFraction)
+            {
+                inFraction = true;
+                continue;
+            }
+            if (*p < '0' || *p > '9')
+                break;
+            anyDigit = true;
+            if (!dropping && digits <= (UINT64_MAX - 9) / 10)
+            {
+                digits = digits * 10 + static_cast<uint64_t>(*p - '0');
+                if (inFraction)
+                    --scale;
+            }
+            else
+            {
+                dropping = true; // Only matters far below the second fraction digit, or makes the amount overflow
+                if (!inFraction)
+                    ++scale;
+            }
+        }
+        if (!anyDigit)
+            return false;
+        if (p != end && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            bool negativeExponent = false;
+            if (p != end && (*p == '-' || *p == '+'))
+            {
+                negativeExponent = *p == '-';
+                ++p;
+            }
+            int exponent = 0;
+            bool anyExponentDigit = false;
+            for (; p != end && *p >= '0' && *p <= '9'; ++p)
+            {
+                anyExponentDigit = true;
+                if (exponent < 1000)
+                    exponent = exponent * 10 + (*p - '0');
+            }
+            if (!anyExponentDigit)
+                return false;
+            scale += negativeExponent ? -exponent : exponent;
+        }
+        while (p != end && (*p == ' ' || *p == '\r'))
+            ++p;
+        if (p != end)
+            return false;
+
+        // Bring the digits to minor units
+        scale += FRACTION_DIGITS;
+        bool roundUp = false; // Set when the dropped digit right after the second fraction digit is 5 or more
+        while (scale < 0)
         {
-            // Write income transaction data to file
-            file << "Income" << std::endl;
-            file << incomeTransaction->getAmount() << std::endl;
-            file << incomeTransaction->getDescription() << std::endl;
-            file << incomeTransaction->getDate().getDay() << "/" << incomeTransaction->getDate().getMonth()
-                 << "/" << incomeTransaction->getDate().getYear() << std::endl;
+            if (digits == 0)
+            {
+                roundUp = false; // The digits ran out before that position, so the amount rounds to zero
+                break;
+            }
+            roundUp = scale == -1 && digits % 10 >= 5;
+            digits /= 10;
+            ++scale;
         }
-        else if (expenseTransaction)
+        if (digits == 0)
+            scale = 0;
+        while (scale > 0)
         {
-            // Write expense transaction data to file
-            file << "Expense" << std::endl;
-            file << expenseTransaction->getAmount() << std::endl;
-            file << expenseTransaction->getDescription() << std::endl;
-            file << expenseTransaction->getDate().getDay() << "/" << expenseTransaction->getDate().getMonth()
-                 << "/" << expenseTransaction->getDate().getYear() << std::endl;
-            file << expenseTransaction->getCategory().getName() << std::endl;
+            if (digits > static_cast<uint64_t>(INT64_MAX) / 10)
+                return false;
+            digits *= 10;
+            --scale;
         }
+        if (roundUp)
+            ++digits;
+        if (digits > static_cast<uint64_t>(INT64_MAX))
+            return false;
+        int64_t value = static_cast<int64_t>(digits);
+        money = Money(negative ? -value : value);
+        return true;
     }
 
-    file.close();
+    static bool parse(const std::string &text, Money &money)
+    {
+        return parse(text.data(), text.data() + text.size(), money);
+    }
+};
+
+std::ostream &operator<<(std::ostream &stream, const Money &money)
+{
+    char text[FORMAT_BUFFER_SIZE];
+    writeFormatted(stream, text, static_cast<size_t>(money.format(text) - text));
+    return stream;
 }
 
-// This function loads the user data from a file.
-int loadUserData(const std::string &username, const std::string &password, User *&user)
+// This class is a three letter currency code such as BDT or USD, packed into an integer.
+
+class Currency
 {
-    std::ifstream file("data/" + username + ".txt"); // Open file associated with user
-    if (!file)
+private:
+    uint32_t code; // The three letters, first letter in the highest byte
+
+    constexpr explicit Currency(uint32_t code) : code(code) {}
+
+public:
+    constexpr Currency() : code((uint32_t('B') << 16) | (uint32_t('D') << 8) | uint32_t('T')) {} // BDT
+
+    constexpr uint32_t getCode() const
     {
-        throw FinancialException("User data not found."); // Throw exception if file cannot be opened
+        return code;
     }
-    std::string key;
-    std::getline(file, key); // Get key from file
-    std::string loadedPassword;
-    std::getline(file, loadedPassword); // Get encrypted password from file
-    std::string loadedUsername;
-    std::getline(file, loadedUsername); // Get username from file
-    if (loadedUsername != username)     // Check if username matches
+
+    std::string toString() const
     {
-        return -1;
+        return std::string{static_cast<char>(code >> 16), static_cast<char>((code >> 8) & 0xff), static_cast<char>(code & 0xff)};
     }
 
-    loadedPassword = decryptPassword(loadedPassword, key); // Decrypt password
-    if (loadedPassword != password)                        // Check if password matches
+    char *format(char *out) const // Writes the three letters
     {
-        return -2;
+        out[0] = static_cast<char>(code >> 16);
+        out[1] = static_cast<char>((code >> 8) & 0xff);
+        out[2] = static_cast<char>(code & 0xff);
+        return out + 3;
+    }
+
+    // Parses a code of three letters from [begin, end); lowercase letters are accepted. Trailing spaces and '\r' are ignored.
+    static bool parse(const char *begin, const char *end, Currency &currency)
+    {
+        while (end != begin && (end[-1] == ' ' || end[-1] == '\r'))
+            --end;
+        if (end - begin != 3)
+            return false;
+        uint32_t packed = 0;
+        for (const char *p = begin; p != end; ++p)
+        {
+            if (!std::isalpha(static_cast<unsigned char>(*p)))
+                return false;
+            packed = (packed << 8) | static_cast<uint32_t>(std::toupper(static_cast<unsigned char>(*p)));
+        }
+        currency = Currency(packed);
+        return true;
+    }
+
+    static bool parse(const std::string &text, Currency &currency)
+    {
+        return parse(text.data(), text.data() + text.size(), currency);
+    }
+
+    constexpr bool operator==(const Currency &other) const { return code == other.code; }
+    constexpr bool operator!=(const Currency &other) const { return code != other.code; }
+};
+
+// The home currency. Balances, budgets, recurring transactions and all totals kept by a User are in it;
+// transactions in other currencies are converted at the rate of their date.
+const Currency BASE_CURRENCY;
+
+// This class holds the exchange rates from data/rates.txt. Each line gives the rate of a currency from a day on:
+//     <currency> <dd/mm/yyyy> <units of the home currency per unit of the currency>
+// The rate on a day is the last one given on or before it, or the first one for earlier days, found by binary
+// search. Lookups are cached per currency and day. Every thread has its own cache, because loading and the
+// batch reports convert amounts on several threads.
+
+class ExchangeRates
+{
+private:
+    std::unordered_map<uint32_t, std::vector<std::pair<int32_t, double>>> rates; // Rates by currency code, sorted by day
+    uint64_t generation;                                                         // Changes on every load, so that stale caches are dropped
+
+    static uint64_t nextGeneration()
+    {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
     }
 
-    user = new User(username, password); // Create new user object
+public:
+    ExchangeRates() : generation(nextGeneration()) {}
 
-    // Load user data
-    std::string transactionType;
-    while (std::getline(file, transactionType))
+    // Loads the rates from a file, replacing the ones loaded before. A missing file means there are no other
+    // currencies than the home currency. Throws FinancialException if a line is invalid, keeping the old rates.
+    void load(const std::string &path)
     {
-        if (transactionType == "Income")
+        std::unordered_map<uint32_t, std::vector<std::pair<int32_t, double>>> loaded;
+        std::ifstream file(path);
+        size_t lineNumber = 0;
+        for (std::string line; std::getline(file, line);)
         {
-            std::string amountString;
-            std::getline(file, amountString);
-            double amount = std::stod(amountString);
-            std::string description;
-            std::getline(file, description);
-            std::string dateString;
-            std::getline(file, dateString);
-            int day, month, year;
-            sscanf(dateString.c_str(), "%d/%d/%d", &day, &month, &year);
-            Date date(day, month, year);
-            user->addTransaction(new Income(amount, description, date)); // Add income transaction
+            ++lineNumber;
+            std::istringstream fields(line);
+            std::string codeString, dateString, rateString;
+            if (!(fields >> codeString) || codeString[0] == '#') // Blank line or comment
+            {
+                continue;
+            }
+            Currency currency;
+            Date date;
+            char *rateEnd = nullptr;
+            double rate = 0;
+            if (fields >> dateString >> rateString)
+            {
+                rate = std::strtod(rateString.c_str(), &rateEnd);
+            }
+            if (!Currency::parse(codeString, currency) || currency == BASE_CURRENCY || !Date::parse(dateString, date) ||
+                !date.checkValidity() || !rateEnd || *rateEnd != '\0' || !(rate > 0))
+            {
+                throw FinancialException("Invalid exchange rate on line " + std::to_string(lineNumber) + " of " + path + ".");
+            }
+            loaded[currency.getCode()].push_back(std::make_pair(date.toOrdinal(), rate));
         }
-        else if (transactionType == "Expense")
+        for (auto &currencyRates : loaded)
         {
-            std::string amountString;
-            std::getline(file, amountString);
-            double amount = std::stod(amountString);
-            std::string description;
-            std::getline(file, description);
-            std::string dateString;
-            std::getline(file, dateString);
-            int day, month, year;
-            sscanf(dateString.c_str(), "%d/%d/%d", &day, &month, &year);
-            Date date(day, month, year);
-            std::string categoryName;
-            std::getline(file, categoryName);
-            Category category(categoryName);
-            user->addTransaction(new Expense(amount, description, date, category)); // Add expense transaction
+            std::stable_sort(currencyRates.second.begin(), currencyRates.second.end(),
+                             [](const std::pair<int32_t, double> &a, const std::pair<int32_t, double> &b)
+                             { return a.first < b.first; }); // A later line for the same day wins
         }
+        rates.swap(loaded);
+        generation = nextGeneration();
     }
 
-    file.close();
-    return 0;
-}
+    bool has(const Currency &currency) const // Whether amounts in currency can be converted
+    {
+        return currency == BASE_CURRENCY || rates.count(currency.getCode()) > 0;
+    }
 
-// This function registers a new user.
-User *registerUser(const std::string &username, const std::string &password)
-{
-    // Check if user already exists
-    if (users.count(username))
+    bool empty() const // True if no currency besides the home currency is known
     {
-        throw FinancialException("User already exists.");
+        return rates.empty();
     }
-    // Add user to the set of users
-    users.insert(username);
-    std::ofstream file("data/users.txt", std::ios::app);
-    if (!file)
+
+    double rate(const Currency &currency, int32_t day) const // Units of the home currency per unit of currency on day
     {
-        throw FinancialException("Error saving user data: User file Cannot be opened.");
+        if (currency == BASE_CURRENCY)
+        {
+            return 1.0;
+        }
+        static thread_local std::unordered_map<uint64_t, double> cache;
+        static thread_local uint64_t cacheGeneration = 0;
+        if (cacheGeneration != generation)
+        {
+            cache.clear();
+            cacheGeneration = generation;
+        }
+        uint64_t key = (static_cast<uint64_t>(currency.getCode()) << 32) | static_cast<uint32_t>(day);
+        auto cached = cache.find(key);
+        if (cached != cache.end())
+        {
+            return cached->second;
+        }
+        auto it = rates.find(currency.getCode());
+        if (it == rates.end())
+        {
+            throw FinancialException("No exchange rate for " + currency.toString() + ".");
+        }
+        const std::vector<std::pair<int32_t, double>> &currencyRates = it->second;
+        auto next = std::upper_bound(currencyRates.begin(), currencyRates.end(), day, [](int32_t d, const std::pair<int32_t, double> &r)
+                                     { return d < r.first; });
+        double found = next == currencyRates.begin() ? next->second : (next - 1)->second;
+        cache[key] = found;
+        return found;
     }
-    file << username << std::endl;
-    // Create a new user
-    User user(username, password);
-    // Save user data
-    saveUserData(user);
-    std::cout << "User " << username << " registered successfully." << std::endl;
-    return new User(user);
-}
 
-// This function deletes a user.
-User *deleteUser(const std::string &username, const std::string &password)
-{
-    // Check if user exists
-    auto it = users.find(username);
-    if (it == users.end())
+    int64_t convert(int64_t minorUnits, const Currency &from, const Currency &to, int32_t day) const // Convert an amount at the rates of day
     {
-        throw FinancialException("User does not exist.");
+        if (from == to)
+        {
+            return minorUnits;
+        }
+        return std::llround(static_cast<double>(minorUnits) * rate(from, day) / rate(to, day));
+    }
+};
+
+ExchangeRates exchangeRates; // Loaded from data/rates.txt at startup
+
+// This code creates a Category class, which contains a string that stores the name of the category.
+// The class has a constructor that takes a string as a parameter, and sets the name of the category to that string.
+// It has a getter method that returns the name of the category.
+
+class Category
+{
+private:
+    std::string name;
+
+public:
+    Category(const std::string &name) : name(name) {}
+
+    const std::string &getName() const
+    {
+        return name;
+    }
+};
+
+// This code creates a base class for transactions.
+// It includes a constructor that takes a Money amount, a string, and a Date.
+// It also includes a virtual destructor, a virtual function that returns the amount,
+// a virtual function that returns the Date, and a virtual function that displays the transaction.
+// It also includes a getter for the description.
+// The class is abstract, so it cannot be instantiated.
+// Members:
+// amount: the amount of the transaction
+// description: a description of the transaction
+// date: the date of the transaction
+// id: a number that identifies the transaction for its whole life, assigned by the User that owns it
+// currency: the currency of the amount, the home currency unless set otherwise
+
+class Transaction
+{
+protected:
+    Money amount;
+    std::string description;
+    Date date;
+    uint64_t id;
+    Currency currency;
+
+public:
+    Transaction(const Money &amount, const std::string &description, const Date &date)
+        : amount(amount), description(description), date(date), id(0) {}
+
+    uint64_t getId() const
+    {
+        return id;
+    }
+
+    void setId(uint64_t newId)
+    {
+        id = newId;
+    }
+
+    virtual Money getAmount() const
+    {
+        return amount;
+    }
+
+    virtual const Date &getDate() const
+    {
+        return date;
+    }
+
+    const std::string &getDescription() const
+    {
+        return description;
+    }
+
+    const Currency &getCurrency() const // Currency of the amount
+    {
+        return currency;
+    }
+
+    void setCurrency(const Currency &newCurrency)
+    {
+        currency = newCurrency;
+    }
+
+    void setAmount(const Money &newAmount)
+    {
+        amount = newAmount;
+    }
+
+    void setDescription(const std::string &newDescription)
+    {
+        description = newDescription;
+    }
+
+    void setDate(const Date &newDate)
+    {
+        date = newDate;
+    }
+
+    virtual void display() const = 0;
+
+    virtual ~Transaction() {}
+};
+
+// This code is used to create income and expense objects, which are used in the Budget class.
+// The Income class is a subclass of Transaction, and it has a constructor that takes a Money amount, a string, and a Date.
+// It also has a display method that displays the amount and description of the income.
+
+class Income : public Transaction
+{
+public:
+    Income(const Money &amount, const std::string &description, const Date &date)
+        : Transaction(amount, description, date) {}
+
+    void display() const override
+    {
+        std::cout << "Income: +" << amount << " " << currency.toString() << " - " << description << std::endl;
+    }
+};
+
+// The Expense class is a subclass of Transaction, and it has a constructor that takes a Money amount, a string, a Date, and a Category.
+
+class Expense : public Transaction
+{
+private:
+    Category category; // Category of the expense
+
+public:
+    Expense(const Money &amount, const std::string &description, const Date &date, const Category &category)
+        : Transaction(amount, description, date), category(category) {}
+
+    const Category &getCategory() const
+    {
+        return category;
+    }
+
+    void setCategory(const Category &newCategory)
+    {
+        category = newCategory;
+    }
+
+    void display() const override
+    {
+        std::cout << "Expense: -" << amount << " " << currency.toString() << " - " << description << std::endl;
+    }
+};
+
+// Type tags stored next to each transaction in the column arrays of a User.
+// NO_TRANSACTION marks a slot that must never match any aggregation.
+
+enum TransactionType : uint8_t
+{
+    NO_TRANSACTION = 0,
+    INCOME_TRANSACTION = 1,
+    EXPENSE_TRANSACTION = 2
+};
+
+// Aggregation kernels
+// Each kernel sums amounts[i] over the rows whose tag matches, using a branch-free masked compare
+// followed by a masked sum. The SSE2 and AVX2 versions process 4 and 8 rows per step; the scalar
+// version is the fallback for other CPUs and for the tail of the arrays.
+
+// Sums the amounts of rows with the given type whose date lies in [startDay, endDay]
+typedef int64_t (*PeriodSumKernel)(const int64_t *amounts, const int32_t *dates, const uint8_t *types, size_t count,
+                                   uint8_t type, int32_t startDay, int32_t endDay);
+
+int64_t sumPeriodScalar(const int64_t *amounts, const int32_t *dates, const uint8_t *types, size_t count,
+                        uint8_t type, int32_t startDay, int32_t endDay)
+{
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int64_t match = (types[i] == type) & (dates[i] >= startDay) & (dates[i] <= endDay);
+        sum += amounts[i] & -match; // All ones if the row matches, zero otherwise
+    }
+    return sum;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PFM_X86_KERNELS 1
+#include <immintrin.h>
+
+__attribute__((target("sse2"))) int64_t sumPeriodSse2(const int64_t *amounts, const int32_t *dates, const uint8_t *types, size_t count,
+                                                      uint8_t type, int32_t startDay, int32_t endDay)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vType = _mm_set1_epi32(type);
+    const __m128i vStart = _mm_set1_epi32(startDay);
+    const __m128i vEnd = _mm_set1_epi32(endDay);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        int32_t packedTypes;
+        std::memcpy(&packedTypes, types + i, sizeof(packedTypes));
+        __m128i vTypes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedTypes), zero), zero);
+        __m128i vDates = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dates + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(vStart, vDates), _mm_cmpgt_epi32(vDates, vEnd));
+        __m128i mask = _mm_andnot_si128(outside, _mm_cmpeq_epi32(vTypes, vType));
+        // Widen the four 32-bit lane masks to 64-bit lane masks
+        __m128i maskLow = _mm_unpacklo_epi32(mask, mask);
+        __m128i maskHigh = _mm_unpackhi_epi32(mask, mask);
+        acc = _mm_add_epi64(acc, _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(amounts + i)), maskLow));
+        acc = _mm_add_epi64(acc, _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(amounts + i + 2)), maskHigh));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    return lanes[0] + lanes[1] + sumPeriodScalar(amounts + i, dates + i, types + i, count - i, type, startDay, endDay);
+}
+
+__attribute__((target("avx2"))) int64_t sumPeriodAvx2(const int64_t *amounts, const int32_t *dates, const uint8_t *types, size_t count,
+                                                      uint8_t type, int32_t startDay, int32_t endDay)
+{
+    const __m256i vType = _mm256_set1_epi32(type);
+    const __m256i vStart = _mm256_set1_epi32(startDay);
+    const __m256i vEnd = _mm256_set1_epi32(endDay);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i vTypes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(types + i)));
+        __m256i vDates = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dates + i));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(vStart, vDates), _mm256_cmpgt_epi32(vDates, vEnd));
+        __m256i mask = _mm256_andnot_si256(outside, _mm256_cmpeq_epi32(vTypes, vType));
+        __m256i maskLow = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask));
+        __m256i maskHigh = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1));
+        acc = _mm256_add_epi64(acc, _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(amounts + i)), maskLow));
+        acc = _mm256_add_epi64(acc, _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(amounts + i + 4)), maskHigh));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           sumPeriodScalar(amounts + i, dates + i, types + i, count - i, type, startDay, endDay);
+}
+#endif
+
+// The set of kernels used for aggregation, chosen once at startup from the features of the CPU.
+
+struct AggregationKernels
+{
+    PeriodSumKernel sumPeriod;
+    const char *name;
+};
+
+const AggregationKernels &aggregationKernels()
+{
+    static const AggregationKernels kernels = []() -> AggregationKernels
+    {
+#ifdef PFM_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return AggregationKernels{sumPeriodAvx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse2"))
+        {
+            return AggregationKernels{sumPeriodSse2, "sse2"};
+        }
+#endif
+        return AggregationKernels{sumPeriodScalar, "scalar"};
+    }();
+    return kernels;
+}
+
+// Intervals by which the time series report groups transactions.
+
+enum TimeInterval
+{
+    DAILY,
+    WEEKLY,
+    MONTHLY,
+    YEARLY
+};
+
+// This function returns the number of the interval that the day with the given ordinal falls into.
+// Weeks start on Monday; 01/01/1970 was a Thursday.
+int64_t intervalBucket(int32_t day, TimeInterval interval)
+{
+    switch (interval)
+    {
+    case DAILY:
+        return day;
+    case WEEKLY:
+        return (static_cast<int64_t>(day) + 3 - ((day + 3) % 7 + 7) % 7) / 7;
+    case MONTHLY:
+        return static_cast<int64_t>(Date::yearFromDays(day)) * 12 + Date::monthFromDays(day) - 1;
+    default:
+        return Date::yearFromDays(day);
+    }
+}
+
+// This function returns the first day of the interval with the given number.
+Date intervalStart(int64_t bucket, TimeInterval interval)
+{
+    switch (interval)
+    {
+    case DAILY:
+        return Date::fromOrdinal(static_cast<int32_t>(bucket));
+    case WEEKLY:
+        return Date::fromOrdinal(static_cast<int32_t>(bucket * 7 - 3));
+    case MONTHLY:
+        return Date(1, static_cast<int>(bucket % 12) + 1, static_cast<int>(bucket / 12));
+    default:
+        return Date(1, 1, static_cast<int>(bucket));
+    }
+}
+
+// This struct sums monthly totals for a least-squares trend line: total is the sum of the amounts and weighted the
+// sum of every amount times the number of its month (year * 12 + month - 1). A month without transactions has a
+// total of 0, so the sums over the month numbers themselves follow from the range of months alone, and adding or
+// removing a transaction only changes these two sums.
+struct TrendSums
+{
+    int64_t total;
+    int64_t weighted;
+
+    TrendSums() : total(0), weighted(0) {}
+
+    void add(int32_t month, int64_t amount)
+    {
+        total += amount;
+        weighted += static_cast<int64_t>(month) * amount;
+    }
+
+    void add(const TrendSums &other, int64_t sign = 1)
+    {
+        total += sign * other.total;
+        weighted += sign * other.weighted;
+    }
+};
+
+// This struct is the trend line fitted to the totals of the months firstMonth to lastMonth: the average total and
+// how much it changes from one month to the next.
+struct Trend
+{
+    double average;
+    double slope;
+    double middleMonth;
+
+    Trend(const TrendSums &sums, int32_t firstMonth, int32_t lastMonth) : average(0), slope(0), middleMonth(0.5 * (firstMonth + lastMonth))
+    {
+        double months = lastMonth - firstMonth + 1.0;
+        if (months < 1)
+        {
+            return;
+        }
+        average = sums.total / months;
+        if (months >= 2)
+        {
+            // With x the month and y its total, the slope is sum((x - mean x) * y) / sum((x - mean x)^2); twice the
+            // numerator is exact in integers, and the denominator is n(n^2 - 1)/12 for n consecutive months.
+            int64_t twiceCovariance = 2 * sums.weighted - static_cast<int64_t>(firstMonth + lastMonth) * sums.total;
+            slope = 6.0 * twiceCovariance / (months * (months * months - 1));
+        }
+    }
+
+    double at(int32_t month) const // The expected total of a month, never below 0
+    {
+        return std::max(0.0, average + slope * (month - middleMonth));
+    }
+};
+
+// Copy-on-write storage
+// A snapshot of a user (see User::snapshot) shares the storage of the user instead of copying it. Storage that a
+// copy shares is never changed: the copy that changes it first clones it, and only the part it changes, so taking a
+// snapshot costs a few reference counts however many transactions the user has.
+
+// This function tells whether anyone but the holder of pointer holds it too. Reads by holders that let go of it
+// happen before the changes made once it is not shared.
+template <typename T>
+bool isShared(const std::shared_ptr<T> &pointer)
+{
+    if (pointer.use_count() > 1)
+    {
+        return true;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return false;
+}
+
+// This class holds a value that its copies share until one of them changes it. Reading goes through * and ->;
+// changing goes through write(), which clones the value first if a copy still holds it.
+template <typename T>
+class CopyOnWrite
+{
+private:
+    std::shared_ptr<T> value;
+
+public:
+    CopyOnWrite() : value(std::make_shared<T>()) {}
+
+    const T &operator*() const
+    {
+        return *value;
+    }
+
+    const T *operator->() const
+    {
+        return value.get();
+    }
+
+    T &write() // The value, to change
+    {
+        if (isShared(value))
+        {
+            value = std::make_shared<T>(*value);
+        }
+        return *value;
+    }
+};
+
+// This class is a vector stored in chunks of CHUNK_SIZE elements. Its copies share the chunks; changing an element
+// or appending clones the chunk it lands in if a copy still holds it, so after a copy only the chunks that change
+// are cloned and the first change costs a chunk, not the whole vector.
+template <typename T>
+class ChunkedVector
+{
+public:
+    static const size_t CHUNK_SIZE = 4096;
+    typedef std::vector<T> Chunk;
+
+private:
+    CopyOnWrite<std::vector<std::shared_ptr<Chunk>>> chunks;
+    size_t count;
+
+    Chunk &writableChunk(size_t chunk) // A chunk, to change
+    {
+        std::shared_ptr<Chunk> &held = chunks.write()[chunk];
+        if (isShared(held))
+        {
+            held = std::make_shared<Chunk>(*held);
+        }
+        return *held;
+    }
+
+public:
+    ChunkedVector() : count(0) {}
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    const T &operator[](size_t index) const
+    {
+        return (*(*chunks)[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    void set(size_t index, const T &value)
+    {
+        writableChunk(index / CHUNK_SIZE)[index % CHUNK_SIZE] = value;
+    }
+
+    void push_back(const T &value)
+    {
+        if (count % CHUNK_SIZE == 0)
+        {
+            chunks.write().push_back(std::make_shared<Chunk>());
+        }
+        writableChunk(count / CHUNK_SIZE).push_back(value);
+        ++count;
+    }
+
+    void clear()
+    {
+        chunks.write().clear();
+        count = 0;
+    }
+
+    size_t chunkCount() const
+    {
+        return chunks->size();
+    }
+
+    const Chunk &chunk(size_t chunk) const // The elements from chunk * CHUNK_SIZE on, contiguous
+    {
+        return *(*chunks)[chunk];
+    }
+
+    class const_iterator
+    {
+    private:
+        const ChunkedVector *vector;
+        size_t index;
+
+    public:
+        const_iterator(const ChunkedVector *vector, size_t index) : vector(vector), index(index) {}
+
+        const T &operator*() const
+        {
+            return (*vector)[index];
+        }
+
+        const_iterator &operator++()
+        {
+            ++index;
+            return *this;
+        }
+
+        bool operator!=(const const_iterator &other) const
+        {
+            return index != other.index;
+        }
+    };
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, count);
+    }
+};
+
+// This class keeps materialized totals for every calendar month: income, expenses and expenses per category.
+// The totals are updated in O(1) when a transaction is added or removed and are saved with the user data,
+// so logging in does not have to recompute them. Each month also lists its transactions, so a report over a
+// date range only looks at individual transactions in the partly covered months at either end of the range.
+// The sums of the trend lines of income, expenses and every category over all months are kept the same way.
+
+class MonthlyRollups
+{
+public:
+    struct Entry
+    {
+        const Transaction *transaction;
+        int64_t amount;
+        int32_t date;
+        uint8_t type;
+        uint32_t category;
+    };
+
+    struct Month
+    {
+        int64_t income;
+        int64_t expenses;
+        std::unordered_map<uint32_t, int64_t> categoryExpenses;
+        std::vector<Entry> entries;
+        std::unordered_map<const Transaction *, size_t> positions; // Index of every transaction in entries
+
+        Month() : income(0), expenses(0) {}
+    };
+
+private:
+    // Copies of the rollups share the months; a month is cloned by the first copy that changes it (see writableMonth)
+    std::unordered_map<int32_t, std::shared_ptr<Month>> months; // Keyed by year * 12 + month - 1
+    std::unordered_map<uint32_t, int64_t> categoryTotals;       // Expenses per category over all months
+    std::set<int32_t> monthKeys;                                // Keys of the months that have entries, in order
+    TrendSums incomeTrend;                                // Trend sums over all months
+    TrendSums expensesTrend;
+    std::unordered_map<uint32_t, TrendSums> categoryTrends;
+
+    static Month &writableMonth(std::shared_ptr<Month> &month) // A month, to change
+    {
+        if (isShared(month))
+        {
+            month = std::make_shared<Month>(*month);
+        }
+        return *month;
+    }
+
+    static int32_t monthKey(int32_t day)
+    {
+        return Date::yearFromDays(day) * 12 + Date::monthFromDays(day) - 1;
+    }
+
+    static int32_t firstDayOfMonth(int32_t key)
+    {
+        return Date::daysFromCivil(key / 12, key % 12 + 1, 1);
+    }
+
+    static int32_t lastDayOfMonth(int32_t key)
+    {
+        return Date::daysFromCivil(key / 12, key % 12 + 1, Date::daysInMonth(key % 12 + 1, key / 12));
+    }
+
+    void addToTotals(Month &month, const Entry &entry, int64_t sign)
+    {
+        if (entry.type == INCOME_TRANSACTION)
+        {
+            month.income += sign * entry.amount;
+            incomeTrend.add(monthKey(entry.date), sign * entry.amount);
+        }
+        else if (entry.type == EXPENSE_TRANSACTION)
+        {
+            month.expenses += sign * entry.amount;
+            month.categoryExpenses[entry.category] += sign * entry.amount;
+            categoryTotals[entry.category] += sign * entry.amount;
+            expensesTrend.add(monthKey(entry.date), sign * entry.amount);
+            categoryTrends[entry.category].add(monthKey(entry.date), sign * entry.amount);
+        }
+    }
+
+    // Whether the income and expenses of a saved month are those of its entries, and its category totals add up to
+    // its expenses. Far cheaper than recomputing the month, as it needs no lookups per entry.
+    static bool agrees(const Month &savedMonth, const std::vector<Entry> &entries)
+    {
+        int64_t income = 0, expenses = 0, categories = 0;
+        for (const auto &entry : entries)
+        {
+            if (entry.type == INCOME_TRANSACTION)
+            {
+                income += entry.amount;
+            }
+            else if (entry.type == EXPENSE_TRANSACTION)
+            {
+                expenses += entry.amount;
+            }
+        }
+        for (const auto &category : savedMonth.categoryExpenses)
+        {
+            categories += category.second;
+        }
+        return income == savedMonth.income && expenses == savedMonth.expenses && categories == expenses;
+    }
+
+    void clearTrends()
+    {
+        incomeTrend = TrendSums();
+        expensesTrend = TrendSums();
+        categoryTrends.clear();
+    }
+
+    // Sums the entries of one month that match and are dated in [firstDay, lastDay]
+    int64_t sumEntries(int32_t key, uint8_t type, bool anyCategory, uint32_t category, int32_t firstDay, int32_t lastDay) const
+    {
+        auto it = months.find(key);
+        if (it == months.end())
+        {
+            return 0;
+        }
+        int64_t sum = 0;
+        STAT_ADD(STAT_TRANSACTIONS_SCANNED, it->second->entries.size());
+        for (const auto &entry : it->second->entries)
+        {
+            if (entry.type == type && (anyCategory || entry.category == category) && entry.date >= firstDay && entry.date <= lastDay)
+            {
+                sum += entry.amount;
+            }
+        }
+        return sum;
+    }
+
+    // Returns the materialized total of one whole month
+    int64_t monthTotal(const Month &month, uint8_t type, bool anyCategory, uint32_t category) const
+    {
+        if (anyCategory)
+        {
+            return type == INCOME_TRANSACTION ? month.income : month.expenses;
+        }
+        if (type != EXPENSE_TRANSACTION)
+        {
+            return 0;
+        }
+        auto it = month.categoryExpenses.find(category);
+        return it == month.categoryExpenses.end() ? 0 : it->second;
+    }
+
+    std::vector<const Month *> monthsInRange(int32_t firstDay, int32_t lastDay) const // Months overlapping [firstDay, lastDay], in no particular order
+    {
+        std::vector<const Month *> found;
+        if (lastDay < firstDay)
+        {
+            return found;
+        }
+        int32_t firstKey = monthKey(firstDay);
+        int32_t lastKey = monthKey(lastDay);
+        if (static_cast<size_t>(lastKey - firstKey) <= months.size())
+        {
+            for (int32_t key = firstKey; key <= lastKey; ++key)
+            {
+                auto it = months.find(key);
+                if (it != months.end())
+                {
+                    found.push_back(it->second.get());
+                }
+            }
+        }
+        else // The range is longer than the history
+        {
+            for (const auto &month : months)
+            {
+                if (month.first >= firstKey && month.first <= lastKey)
+                {
+                    found.push_back(month.second.get());
+                }
+            }
+        }
+        return found;
+    }
+
+    int64_t sum(uint8_t type, bool anyCategory, uint32_t category, int32_t firstDay, int32_t lastDay) const
+    {
+        if (lastDay < firstDay)
+        {
+            return 0;
+        }
+        int32_t firstKey = monthKey(firstDay);
+        int32_t lastKey = monthKey(lastDay);
+        if (firstKey == lastKey)
+        {
+            if (firstDay != firstDayOfMonth(firstKey) || lastDay != lastDayOfMonth(lastKey))
+            {
+                return sumEntries(firstKey, type, anyCategory, category, firstDay, lastDay);
+            }
+            auto it = months.find(firstKey);
+            return it == months.end() ? 0 : monthTotal(*it->second, type, anyCategory, category);
+        }
+
+        // Edge months, which may be covered only in part
+        int64_t total = sumEntries(firstKey, type, anyCategory, category, firstDay, lastDayOfMonth(firstKey)) +
+                        sumEntries(lastKey, type, anyCategory, category, firstDayOfMonth(lastKey), lastDay);
+        // Whole months in between
+        if (static_cast<size_t>(lastKey - firstKey - 1) <= months.size())
+        {
+            for (int32_t key = firstKey + 1; key < lastKey; ++key)
+            {
+                auto it = months.find(key);
+                if (it != months.end())
+                {
+                    total += monthTotal(*it->second, type, anyCategory, category);
+                }
+            }
+        }
+        else // The range is longer than the history; walk the months that exist instead
+        {
+            for (const auto &month : months)
+            {
+                if (month.first > firstKey && month.first < lastKey)
+                {
+                    total += monthTotal(*month.second, type, anyCategory, category);
+                }
+            }
+        }
+        return total;
+    }
+
+public:
+    void add(const Entry &entry, bool updateTotals = true) // Add a transaction to its month
+    {
+        std::shared_ptr<Month> &held = months[monthKey(entry.date)];
+        if (!held)
+        {
+            held = std::make_shared<Month>();
+            monthKeys.insert(monthKey(entry.date));
+        }
+        Month &month = writableMonth(held);
+        month.positions[entry.transaction] = month.entries.size();
+        month.entries.push_back(entry);
+        if (updateTotals)
+        {
+            addToTotals(month, entry, 1);
+        }
+    }
+
+    void remove(const Transaction *transaction, int32_t date) // Remove a transaction from its month
+    {
+        auto it = months.find(monthKey(date));
+        if (it == months.end() || !it->second->positions.count(transaction))
+        {
+            return;
+        }
+        Month &month = writableMonth(it->second);
+        std::vector<Entry> &entries = month.entries;
+        size_t i = month.positions[transaction];
+        addToTotals(month, entries[i], -1);
+        entries[i] = entries.back(); // The order within a month does not matter
+        month.positions[entries[i].transaction] = i;
+        entries.pop_back();
+        month.positions.erase(transaction);
+        if (entries.empty())
+        {
+            monthKeys.erase(it->first);
+            months.erase(it);
+        }
+    }
+
+    void clear()
+    {
+        months.clear();
+        categoryTotals.clear();
+        monthKeys.clear();
+        clearTrends();
+    }
+
+    bool verifyTotals() // Rebuild every total from the entries. Returns false if any of them was wrong, as saved totals can be
+    {
+        std::map<int32_t, std::map<uint32_t, int64_t>> before; // The totals of every month, the category ones with the category id plus 2
+        for (const auto &month : months)
+        {
+            std::map<uint32_t, int64_t> &totals = before[month.first];
+            totals[0] = month.second->income;
+            totals[1] = month.second->expenses;
+            for (const auto &category : month.second->categoryExpenses)
+            {
+                if (category.second != 0)
+                {
+                    totals[category.first + 2] = category.second;
+                }
+            }
+        }
+        recomputeTotals();
+        for (const auto &month : months)
+        {
+            std::map<uint32_t, int64_t> &totals = before[month.first];
+            if (totals[0] != month.second->income || totals[1] != month.second->expenses)
+            {
+                return false;
+            }
+            for (const auto &category : month.second->categoryExpenses)
+            {
+                if (category.second != 0 && totals[category.first + 2] != category.second)
+                {
+                    return false;
+                }
+                totals.erase(category.first + 2);
+            }
+            if (totals.size() != 2)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void recomputeTotals() // Rebuild every total from the entries
+    {
+        categoryTotals.clear();
+        clearTrends();
+        for (auto &held : months)
+        {
+            Month &month = writableMonth(held.second);
+            month.income = 0;
+            month.expenses = 0;
+            month.categoryExpenses.clear();
+            for (const auto &entry : month.entries)
+            {
+                addToTotals(month, entry, 1);
+            }
+        }
+    }
+
+    bool span(int32_t &firstDay, int32_t &lastDay) const // First and last day of the months that have entries, false if there are none
+    {
+        if (monthKeys.empty())
+        {
+            return false;
+        }
+        firstDay = firstDayOfMonth(*monthKeys.begin());
+        lastDay = lastDayOfMonth(*monthKeys.rbegin());
+        return true;
+    }
+
+    size_t countEntries(int32_t firstDay, int32_t lastDay) const // Number of entries in the months overlapping [firstDay, lastDay]
+    {
+        size_t count = 0;
+        for (const Month *month : monthsInRange(firstDay, lastDay))
+        {
+            count += month->entries.size();
+        }
+        return count;
+    }
+
+    template <typename Visitor>
+    void forEachEntry(int32_t firstDay, int32_t lastDay, Visitor visit) const // Call visit for every entry dated in [firstDay, lastDay]
+    {
+        for (const Month *month : monthsInRange(firstDay, lastDay))
+        {
+            STAT_ADD(STAT_TRANSACTIONS_SCANNED, month->entries.size());
+            for (const auto &entry : month->entries)
+            {
+                if (entry.date >= firstDay && entry.date <= lastDay)
+                {
+                    visit(entry);
+                }
+            }
+        }
+    }
+
+    int64_t sumForPeriod(uint8_t type, const Date &startDate, const Date &endDate) const
+    {
+        return sum(type, true, 0, startDate.toOrdinal(), endDate.toOrdinal());
+    }
+
+    int64_t sumForCategoryPeriod(uint32_t category, const Date &startDate, const Date &endDate) const
+    {
+        return sum(EXPENSE_TRANSACTION, false, category, startDate.toOrdinal(), endDate.toOrdinal());
+    }
+
+    int64_t sumForCategory(uint32_t category) const // Expenses of a category over all months
+    {
+        auto it = categoryTotals.find(category);
+        return it == categoryTotals.end() ? 0 : it->second;
+    }
+
+    // Adds the trend sums of the months before beforeMonth to income, expenses and categories, and lowers firstMonth
+    // to the first month with entries. The months from beforeMonth on, usually just the current one, are taken out
+    // again; only their totals are looked at, not their entries, and no other month is looked at.
+    void addTrendSums(int32_t beforeMonth, int32_t &firstMonth, TrendSums &income, TrendSums &expenses,
+                      std::unordered_map<uint32_t, TrendSums> &categories) const
+    {
+        income.add(incomeTrend);
+        expenses.add(expensesTrend);
+        for (const auto &category : categoryTrends)
+        {
+            categories[category.first].add(category.second);
+        }
+        if (!monthKeys.empty() && *monthKeys.begin() < beforeMonth)
+        {
+            firstMonth = std::min(firstMonth, *monthKeys.begin());
+        }
+        for (auto key = monthKeys.lower_bound(beforeMonth); key != monthKeys.end(); ++key)
+        {
+            const Month &month = *months.at(*key);
+            income.add(*key, -month.income);
+            expenses.add(*key, -month.expenses);
+            for (const auto &category : month.categoryExpenses)
+            {
+                categories[category.first].add(*key, -category.second);
+            }
+        }
+    }
+
+    // Writes one "Rollup" line per month and one "CategoryRollup" line per month and category, in month order:
+    //     Rollup <month>/<year> <transaction count> <income> <expenses>
+    //     CategoryRollup <month>/<year> <expenses> <category name>
+    void write(std::ostream &file, const std::vector<std::string> &categoryNames) const
+    {
+        std::vector<int32_t> keys;
+        for (const auto &month : months)
+        {
+            keys.push_back(month.first);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (int32_t key : keys)
+        {
+            const Month &month = *months.at(key);
+            std::string period = std::to_string(key % 12 + 1) + "/" + std::to_string(key / 12);
+            file << "Rollup " << period << " " << month.entries.size() << " " << Money::fromMinorUnits(month.income) << " "
+                 << Money::fromMinorUnits(month.expenses) << "\n";
+            std::vector<std::pair<uint32_t, int64_t>> categories(month.categoryExpenses.begin(), month.categoryExpenses.end());
+            std::sort(categories.begin(), categories.end());
+            for (const auto &category : categories)
+            {
+                if (category.second != 0)
+                {
+                    file << "CategoryRollup " << period << " " << Money::fromMinorUnits(category.second) << " "
+                         << categoryNames[category.first] << "\n";
+                }
+            }
+        }
+    }
+
+    // This function takes over the totals saved in the user file, given as the lines written by write().
+    // internCategory maps a category name to its id. The saved totals are only used if every month lists
+    // as many transactions as were loaded for it and its income and expenses add up to those of its entries;
+    // otherwise the totals are recomputed from the entries. Returns true if the saved totals were used.
+    bool adoptSaved(const std::vector<std::string> &lines, const std::function<uint32_t(const std::string &)> &internCategory)
+    {
+        std::unordered_map<int32_t, Month> saved;
+        std::unordered_map<int32_t, size_t> savedCounts;
+        bool valid = true;
+        for (const auto &line : lines)
+        {
+            const char *p = line.data();
+            const char *end = line.data() + line.size();
+            // Splits off the next space separated field
+            auto field = [&p, end](const char *&fieldBegin, const char *&fieldEnd) -> bool
+            {
+                while (p != end && *p == ' ')
+                    ++p;
+                fieldBegin = p;
+                while (p != end && *p != ' ')
+                    ++p;
+                fieldEnd = p;
+                return fieldBegin != fieldEnd;
+            };
+            const char *b, *e;
+            if (!field(b, e))
+            {
+                valid = false;
+                break;
+            }
+            bool isCategory = std::string(b, e) == "CategoryRollup";
+            int32_t month = 0, year = 0;
+            const char *slash;
+            if (!field(b, e) || (slash = std::find(b, e, '/')) == e)
+            {
+                valid = false;
+                break;
+            }
+            month = std::atoi(std::string(b, slash).c_str());
+            year = std::atoi(std::string(slash + 1, e).c_str());
+            int32_t key = year * 12 + month - 1;
+            Money first, second;
+            if (isCategory)
+            {
+                if (!field(b, e) || !Money::parse(b, e, first))
+                {
+                    valid = false;
+                    break;
+                }
+                if (p != end) // The space before the name; the name itself may start with spaces
+                    ++p;
+                saved[key].categoryExpenses[internCategory(std::string(p, end))] += first.getMinorUnits();
+            }
+            else
+            {
+                const char *countBegin, *countEnd;
+                if (!field(countBegin, countEnd) || !field(b, e) || !Money::parse(b, e, first) || !field(b, e) || !Money::parse(b, e, second))
+                {
+                    valid = false;
+                    break;
+                }
+                savedCounts[key] = std::strtoul(std::string(countBegin, countEnd).c_str(), nullptr, 10);
+                saved[key].income = first.getMinorUnits();
+                saved[key].expenses = second.getMinorUnits();
+            }
+        }
+        valid = valid && !lines.empty() && savedCounts.size() == months.size() && saved.size() == months.size();
+        for (auto it = months.begin(); valid && it != months.end(); ++it)
+        {
+            auto count = savedCounts.find(it->first);
+            valid = count != savedCounts.end() && count->second == it->second->entries.size() &&
+                    agrees(saved[it->first], it->second->entries);
+        }
+        if (!valid)
+        {
+            recomputeTotals();
+            return false;
+        }
+        categoryTotals.clear();
+        clearTrends();
+        for (auto &held : months)
+        {
+            Month &savedMonth = saved[held.first];
+            Month &month = writableMonth(held.second);
+            month.income = savedMonth.income;
+            month.expenses = savedMonth.expenses;
+            month.categoryExpenses.swap(savedMonth.categoryExpenses);
+            incomeTrend.add(held.first, month.income);
+            expensesTrend.add(held.first, month.expenses);
+            for (const auto &category : month.categoryExpenses)
+            {
+                categoryTotals[category.first] += category.second;
+                categoryTrends[category.first].add(held.first, category.second);
+            }
+        }
+        return true;
+    }
+};
+
+// This class stores the fields that the aggregations read as arrays, one entry per transaction of a User and in
+// the same order. The arrays are chunked (see ChunkedVector), so that copies share them; every chunk is
+// contiguous, so that the kernels above can scan it.
+// Category names are interned to small ids; id 0 means "no category" (income).
+
+class TransactionColumns
+{
+private:
+    struct Categories
+    {
+        std::vector<std::string> names;
+        std::map<std::string, uint32_t> ids;
+
+        Categories() : names(1) {}
+    };
+
+    ChunkedVector<int64_t> amounts;     // Amount in minor units of the home currency
+    ChunkedVector<int32_t> dates;       // Date ordinal
+    ChunkedVector<uint8_t> types;       // TransactionType tag
+    ChunkedVector<uint32_t> categories; // Category id
+    CopyOnWrite<Categories> categoryNames;
+    bool converted; // Set once an amount in another currency was converted
+
+    static int64_t homeAmount(const Transaction *transaction) // Amount of a transaction in the home currency
+    {
+        return exchangeRates.convert(transaction->getAmount().getMinorUnits(), transaction->getCurrency(), BASE_CURRENCY,
+                                     transaction->getDate().toOrdinal());
+    }
+
+public:
+    TransactionColumns() : converted(false) {}
+
+    bool hasConvertedAmounts() const // Whether any amount depends on the exchange rates
+    {
+        return converted;
+    }
+
+    uint32_t internCategory(const std::string &name) // Get the id of a category, adding it if it is new
+    {
+        uint32_t categoryId;
+        if (findCategory(name, categoryId))
+        {
+            return categoryId;
+        }
+        Categories &known = categoryNames.write();
+        categoryId = static_cast<uint32_t>(known.names.size());
+        known.names.push_back(name);
+        known.ids[name] = categoryId;
+        return categoryId;
+    }
+
+    bool findCategory(const std::string &name, uint32_t &categoryId) const // Look up the id of a known category
+    {
+        auto it = categoryNames->ids.find(name);
+        if (it == categoryNames->ids.end())
+        {
+            return false;
+        }
+        categoryId = it->second;
+        return true;
+    }
+
+    std::vector<std::string> getCategoryNames() const // Names of all interned categories
+    {
+        return std::vector<std::string>(categoryNames->names.begin() + 1, categoryNames->names.end());
+    }
+
+    void append(const Transaction *transaction) // Append the fields of a transaction
+    {
+        const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+        amounts.push_back(homeAmount(transaction));
+        converted = converted || transaction->getCurrency() != BASE_CURRENCY;
+        dates.push_back(transaction->getDate().toOrdinal());
+        if (expenseTransaction)
+        {
+            types.push_back(EXPENSE_TRANSACTION);
+            categories.push_back(internCategory(expenseTransaction->getCategory().getName()));
+        }
+        else
+        {
+            types.push_back(dynamic_cast<const Income *>(transaction) ? INCOME_TRANSACTION : NO_TRANSACTION);
+            categories.push_back(0);
+        }
+    }
+
+    size_t size() const
+    {
+        return amounts.size();
+    }
+
+    const std::string &categoryName(uint32_t categoryId) const
+    {
+        return categoryNames->names[categoryId];
+    }
+
+    const std::vector<std::string> &allCategoryNames() const // Indexed by category id, entry 0 is "no category"
+    {
+        return categoryNames->names;
+    }
+
+    MonthlyRollups::Entry entryAt(size_t index, const Transaction *transaction) const // The fields of a row, as a rollup entry
+    {
+        MonthlyRollups::Entry entry;
+        entry.transaction = transaction;
+        entry.amount = amounts[index];
+        entry.date = dates[index];
+        entry.type = types[index];
+        entry.category = categories[index];
+        return entry;
+    }
+
+    void appendColumns(const TransactionColumns &other) // Append all entries of other, mapping its category ids to ours
+    {
+        std::vector<uint32_t> categoryMap(other.categoryNames->names.size(), 0);
+        for (size_t i = 1; i < other.categoryNames->names.size(); ++i)
+        {
+            categoryMap[i] = internCategory(other.categoryNames->names[i]);
+        }
+        converted = converted || other.converted;
+        for (size_t i = 0; i < other.size(); ++i)
+        {
+            amounts.push_back(other.amounts[i]);
+            dates.push_back(other.dates[i]);
+            types.push_back(other.types[i]);
+            categories.push_back(categoryMap[other.categories[i]]);
+        }
+    }
+
+    void update(size_t index, const Transaction *transaction) // Refresh the entry at index after the transaction was edited
+    {
+        const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+        amounts.set(index, homeAmount(transaction));
+        converted = converted || transaction->getCurrency() != BASE_CURRENCY;
+        dates.set(index, transaction->getDate().toOrdinal());
+        categories.set(index, expenseTransaction ? internCategory(expenseTransaction->getCategory().getName()) : 0);
+    }
+
+    void markRemoved(size_t index) // Mark the entry at index as removed, so that no aggregation matches it
+    {
+        amounts.set(index, 0);
+        types.set(index, NO_TRANSACTION);
+    }
+
+    void removeMarked() // Drop the entries marked as removed, keeping the order of the others
+    {
+        TransactionColumns kept;
+        kept.categoryNames = categoryNames;
+        kept.converted = converted;
+        for (size_t i = 0; i < size(); ++i)
+        {
+            if (types[i] != NO_TRANSACTION)
+            {
+                kept.amounts.push_back(amounts[i]);
+                kept.dates.push_back(dates[i]);
+                kept.types.push_back(types[i]);
+                kept.categories.push_back(categories[i]);
+            }
+        }
+        *this = kept;
+    }
+
+    void clear()
+    {
+        amounts.clear();
+        dates.clear();
+        types.clear();
+        categories.clear();
+    }
+
+    int64_t sumForDays(uint8_t type, int32_t firstDay, int32_t lastDay) const
+    {
+        STAT_ADD(STAT_TRANSACTIONS_SCANNED, amounts.size());
+        int64_t total = 0;
+        for (size_t chunk = 0; chunk < amounts.chunkCount(); ++chunk)
+        {
+            total += aggregationKernels().sumPeriod(amounts.chunk(chunk).data(), dates.chunk(chunk).data(), types.chunk(chunk).data(),
+                                                    amounts.chunk(chunk).size(), type, firstDay, lastDay);
+        }
+        return total;
+    }
+
+    // Adds the amount of every row dated in [firstDay, lastDay] to the income or expenses of the interval it falls into.
+    // Intervals are numbered from firstBucket, so the whole series is built in a single pass over the rows.
+    void accumulateByInterval(int32_t firstDay, int32_t lastDay, TimeInterval interval, int64_t firstBucket,
+                              std::vector<int64_t> &income, std::vector<int64_t> &expenses) const
+    {
+        STAT_ADD(STAT_TRANSACTIONS_SCANNED, amounts.size());
+        for (size_t chunk = 0; chunk < amounts.chunkCount(); ++chunk)
+        {
+            const std::vector<int64_t> &chunkAmounts = amounts.chunk(chunk);
+            const std::vector<int32_t> &chunkDates = dates.chunk(chunk);
+            const std::vector<uint8_t> &chunkTypes = types.chunk(chunk);
+            for (size_t i = 0; i < chunkAmounts.size(); ++i)
+            {
+                if (chunkTypes[i] == NO_TRANSACTION || chunkDates[i] < firstDay || chunkDates[i] > lastDay)
+                {
+                    continue;
+                }
+                size_t bucket = static_cast<size_t>(intervalBucket(chunkDates[i], interval) - firstBucket);
+                (chunkTypes[i] == INCOME_TRANSACTION ? income : expenses)[bucket] += chunkAmounts[i];
+            }
+        }
+    }
+};
+
+void insertSortedId(std::vector<uint64_t> &ids, uint64_t id) // Insert id into a sorted list of ids, unless it is there
+{
+    if (ids.empty() || ids.back() < id) // New transactions have the largest id
+    {
+        ids.push_back(id);
+        return;
+    }
+    auto position = std::lower_bound(ids.begin(), ids.end(), id);
+    if (*position != id)
+    {
+        ids.insert(position, id);
+    }
+}
+
+void eraseSortedId(std::vector<uint64_t> &ids, uint64_t id) // Remove id from a sorted list of ids
+{
+    auto position = std::lower_bound(ids.begin(), ids.end(), id);
+    if (position != ids.end() && *position == id)
+    {
+        ids.erase(position);
+    }
+}
+
+// This class is an inverted index over the words of transaction descriptions and expense categories.
+// Every word maps to the sorted ids of the transactions that contain it. The words are kept in order, so
+// the words that start with a prefix are next to each other and a prefix query is a range of the map.
+class SearchIndex
+{
+private:
+    std::map<std::string, std::vector<uint64_t>> postings; // Ids of the transactions containing each word
+
+    static std::vector<std::string> transactionWords(const Transaction *transaction) // Distinct words of a transaction
+    {
+        std::vector<std::string> words = tokenize(transaction->getDescription());
+        const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+        if (expenseTransaction)
+        {
+            std::vector<std::string> categoryWords = tokenize(expenseTransaction->getCategory().getName());
+            words.insert(words.end(), categoryWords.begin(), categoryWords.end());
+        }
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        return words;
+    }
+
+    std::vector<uint64_t> matchPrefix(const std::string &prefix) const // Sorted ids of the transactions with a word starting with prefix
+    {
+        std::vector<uint64_t> ids;
+        size_t words = 0;
+        for (auto it = postings.lower_bound(prefix); it != postings.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            ids.insert(ids.end(), it->second.begin(), it->second.end());
+            ++words;
+        }
+        if (words > 1) // Postings of several words overlap
+        {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+        return ids;
+    }
+
+public:
+    static std::vector<std::string> tokenize(const std::string &text) // Split text into lowercase words of letters and digits
+    {
+        std::vector<std::string> words;
+        std::string word;
+        for (char c : text)
+        {
+            if (std::isalnum(static_cast<unsigned char>(c)))
+            {
+                word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            else if (!word.empty())
+            {
+                words.push_back(word);
+                word.clear();
+            }
+        }
+        if (!word.empty())
+        {
+            words.push_back(word);
+        }
+        return words;
+    }
+
+    void add(const Transaction *transaction) // Index the words of a transaction
+    {
+        for (const auto &word : transactionWords(transaction))
+        {
+            insertSortedId(postings[word], transaction->getId());
+        }
+    }
+
+    void remove(const Transaction *transaction) // Drop a transaction from the index; call before changing its fields
+    {
+        for (const auto &word : transactionWords(transaction))
+        {
+            auto it = postings.find(word);
+            if (it == postings.end())
+            {
+                continue;
+            }
+            eraseSortedId(it->second, transaction->getId());
+            if (it->second.empty())
+            {
+                postings.erase(it);
+            }
+        }
+    }
+
+    // Return the sorted ids of the transactions that have, for every word of the query, a word starting with it.
+    std::vector<uint64_t> search(const std::string &query) const
+    {
+        std::vector<std::string> terms = tokenize(query);
+        if (terms.empty())
+        {
+            return std::vector<uint64_t>();
+        }
+        std::vector<std::vector<uint64_t>> matches;
+        for (const auto &term : terms)
+        {
+            matches.push_back(matchPrefix(term));
+            if (matches.back().empty())
+            {
+                return std::vector<uint64_t>();
+            }
+        }
+        std::sort(matches.begin(), matches.end(), [](const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+                  { return a.size() < b.size(); }); // Intersect the shortest lists first
+        std::vector<uint64_t> result = matches[0];
+        for (size_t i = 1; i < matches.size() && !result.empty(); ++i)
+        {
+            std::vector<uint64_t> common;
+            std::set_intersection(result.begin(), result.end(), matches[i].begin(), matches[i].end(), std::back_inserter(common));
+            result.swap(common);
+        }
+        return result;
+    }
+
+    // Whether a transaction has, for every word of the query, a word starting with it, as search() would find it.
+    // Used for transactions that are not in the index.
+    static bool matches(const Transaction *transaction, const std::string &query)
+    {
+        std::vector<std::string> terms = tokenize(query);
+        std::vector<std::string> words = transactionWords(transaction);
+        for (const auto &term : terms)
+        {
+            if (std::none_of(words.begin(), words.end(), [&](const std::string &word)
+                             { return word.compare(0, term.size(), term) == 0; }))
+            {
+                return false;
+            }
+        }
+        return !terms.empty();
+    }
+
+    void clear()
+    {
+        postings.clear();
+    }
+};
+
+// This class maps every category id to the sorted ids of the expenses in that category.
+class CategoryIndex
+{
+private:
+    std::unordered_map<uint32_t, std::vector<uint64_t>> expenses;
+
+public:
+    void add(const MonthlyRollups::Entry &entry, uint64_t transactionId)
+    {
+        if (entry.type == EXPENSE_TRANSACTION)
+        {
+            insertSortedId(expenses[entry.category], transactionId);
+        }
+    }
+
+    void remove(const MonthlyRollups::Entry &entry, uint64_t transactionId)
+    {
+        auto it = expenses.find(entry.category);
+        if (entry.type == EXPENSE_TRANSACTION && it != expenses.end())
+        {
+            eraseSortedId(it->second, transactionId);
+        }
+    }
+
+    const std::vector<uint64_t> &find(uint32_t category) const // Ids of the expenses in a category
+    {
+        static const std::vector<uint64_t> none;
+        auto it = expenses.find(category);
+        return it == expenses.end() ? none : it->second;
+    }
+
+    void clear()
+    {
+        expenses.clear();
+    }
+};
+
+// Duplicate detection
+// Two transactions are duplicates if they have the same type, date, amount, currency, category and description, where
+// descriptions are compared regardless of case, punctuation and spacing ("Coffee,  Cafe" matches "coffee cafe").
+// Each transaction is reduced to a 64 bit fingerprint of these fields, so that the transactions like a new one are
+// found with a hash lookup and all duplicates of a user in a single pass. Transactions with the same fingerprint are
+// compared field by field, so that a collision never makes two different transactions duplicates.
+
+std::string normalizeDescription(const std::string &description) // Lowercase words separated by single spaces
+{
+    std::string normalized;
+    bool separator = false;
+    for (char c : description)
+    {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (std::isalnum(byte) || byte >= 0x80) // Bytes of non-ASCII letters are kept as they are
+        {
+            if (separator && !normalized.empty())
+            {
+                normalized.push_back(' ');
+            }
+            separator = false;
+            normalized.push_back(static_cast<char>(std::tolower(byte)));
+        }
+        else
+        {
+            separator = true;
+        }
+    }
+    return normalized;
+}
+
+uint64_t fingerprintTransaction(const Transaction *transaction) // FNV-1a hash of the fields that make transactions duplicates
+{
+    const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    uint8_t type = expenseTransaction ? EXPENSE_TRANSACTION : INCOME_TRANSACTION;
+    int32_t date = transaction->getDate().toOrdinal();
+    int64_t amount = transaction->getAmount().getMinorUnits();
+    uint32_t currency = transaction->getCurrency().getCode();
+    std::string description = normalizeDescription(transaction->getDescription());
+    mix(&type, sizeof(type));
+    mix(&date, sizeof(date));
+    mix(&amount, sizeof(amount));
+    mix(&currency, sizeof(currency));
+    mix(description.data(), description.size());
+    if (expenseTransaction)
+    {
+        mix("\n", 1); // Keeps "ab" + "c" apart from "a" + "bc"
+        mix(expenseTransaction->getCategory().getName().data(), expenseTransaction->getCategory().getName().size());
+    }
+    return hash;
+}
+
+bool sameTransaction(const Transaction *a, const Transaction *b) // Whether two transactions are duplicates of each other
+{
+    const Expense *expenseA = dynamic_cast<const Expense *>(a);
+    const Expense *expenseB = dynamic_cast<const Expense *>(b);
+    return (expenseA != nullptr) == (expenseB != nullptr) && a->getDate() == b->getDate() && a->getAmount() == b->getAmount() &&
+           a->getCurrency() == b->getCurrency() && (!expenseA || expenseA->getCategory().getName() == expenseB->getCategory().getName()) &&
+           normalizeDescription(a->getDescription()) == normalizeDescription(b->getDescription());
+}
+
+// This class maps every fingerprint to the ids of the transactions that have it; there is usually one.
+class FingerprintIndex
+{
+private:
+    std::unordered_map<uint64_t, std::vector<uint64_t>> ids;
+
+public:
+    void add(const Transaction *transaction)
+    {
+        ids[fingerprintTransaction(transaction)].push_back(transaction->getId());
+    }
+
+    void remove(const Transaction *transaction)
+    {
+        auto it = ids.find(fingerprintTransaction(transaction));
+        if (it == ids.end())
+        {
+            return;
+        }
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), transaction->getId()), it->second.end());
+        if (it->second.empty())
+        {
+            ids.erase(it);
+        }
+    }
+
+    const std::vector<uint64_t> &find(const Transaction *transaction) const // Ids of the transactions with the fingerprint of transaction
+    {
+        static const std::vector<uint64_t> none;
+        auto it = ids.find(fingerprintTransaction(transaction));
+        return it == ids.end() ? none : it->second;
+    }
+
+    void clear()
+    {
+        ids.clear();
+    }
+};
+
+// This struct describes which transactions a query selects. Every condition that is set must hold.
+struct TransactionQuery
+{
+    bool income;                         // Select income
+    bool expenses;                       // Select expenses
+    bool hasDateRange;                   // Only transactions dated between startDate and endDate, inclusive
+    Date startDate;
+    Date endDate;
+    std::vector<std::string> categories; // Only expenses in one of these categories, if not empty
+    bool hasAmountRange;                 // Only transactions with an amount between minAmount and maxAmount, inclusive
+    Money minAmount;
+    Money maxAmount;
+    std::string text;                    // Only transactions matching these search words (see SearchIndex), if not empty
+    bool listTransactions;               // Return the matching transactions, not only the totals
+
+    TransactionQuery() : income(true), expenses(true), hasDateRange(false), hasAmountRange(false), listTransactions(true) {}
+};
+
+// This struct is the answer to a TransactionQuery.
+struct QueryResult
+{
+    size_t count;
+    Money income;
+    Money expenses;
+    std::vector<const Transaction *> transactions; // In the order they were added, then occurrences of recurring transactions by date; empty unless listTransactions was set
+
+    QueryResult() : count(0) {}
+};
+
+// This class is a rule that repeats a transaction every day, week, month or year from startDate on, up to
+// endDate if it has one. Its occurrences are never stored: totals over a period are counted from the rule, and
+// the occurrences up to today are generated in memory, as read-only transactions without an id, so that they can
+// be listed, searched, queried and checked for duplicates (see User::generateOccurrences). A monthly rule started
+// on the 31st falls on the last day of shorter months, a yearly rule started on 29/2 on 28/2 in other years.
+class RecurringRule
+{
+private:
+    uint64_t id;
+    TransactionType type;
+    Money amount;
+    std::string description;
+    std::string categoryName; // Empty for income
+    TimeInterval cadence;
+    Date startDate;
+    bool hasEndDate;
+    Date endDate;
+
+    int64_t firstOccurrenceFrom(int64_t day) const // Number of the first occurrence on or after day
+    {
+        if (day <= startDate.toOrdinal())
+        {
+            return 0;
+        }
+        const double averageDays[] = {1.0, 7.0, 365.2425 / 12, 365.2425};
+        int64_t index = static_cast<int64_t>((day - startDate.toOrdinal()) / averageDays[cadence]); // Off by at most one
+        while (index > 0 && occurrenceDay(index - 1) >= day)
+        {
+            --index;
+        }
+        while (occurrenceDay(index) < day)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+public:
+    RecurringRule(TransactionType type, const Money &amount, const std::string &description, const std::string &categoryName,
+                  TimeInterval cadence, const Date &startDate, bool hasEndDate, const Date &endDate)
+        : id(0), type(type), amount(amount), description(description), categoryName(type == EXPENSE_TRANSACTION ? categoryName : ""),
+          cadence(cadence), startDate(startDate), hasEndDate(hasEndDate), endDate(endDate) {}
+
+    uint64_t getId() const // Getter for id
+    {
+        return id;
+    }
+
+    void setId(uint64_t newId)
+    {
+        id = newId;
+    }
+
+    TransactionType getType() const
+    {
+        return type;
+    }
+
+    const Money &getAmount() const
+    {
+        return amount;
+    }
+
+    const std::string &getDescription() const
+    {
+        return description;
+    }
+
+    const std::string &getCategoryName() const
+    {
+        return categoryName;
+    }
+
+    TimeInterval getCadence() const
+    {
+        return cadence;
+    }
+
+    const Date &getStartDate() const
+    {
+        return startDate;
+    }
+
+    bool getHasEndDate() const
+    {
+        return hasEndDate;
+    }
+
+    const Date &getEndDate() const
+    {
+        return endDate;
+    }
+
+    Transaction *makeOccurrence(int32_t day) const // Makes the transaction of the occurrence on the given day; it has no id
+    {
+        Date date = Date::fromOrdinal(day);
+        if (type == INCOME_TRANSACTION)
+        {
+            return new Income(amount, description, date);
+        }
+        return new Expense(amount, description, date, Category(categoryName));
+    }
+
+    int64_t occurrenceDay(int64_t index) const // Day ordinal of the occurrence with the given number, counting from 0
+    {
+        int64_t year = startDate.getYear(), month = startDate.getMonth();
+        switch (cadence)
+        {
+        case DAILY:
+            return startDate.toOrdinal() + index;
+        case WEEKLY:
+            return startDate.toOrdinal() + 7 * index;
+        case MONTHLY:
+            year += (month - 1 + index) / 12;
+            month = (month - 1 + index) % 12 + 1;
+            break;
+        default:
+            year += index;
+            break;
+        }
+        int day = std::min(startDate.getDay(), Date::daysInMonth(static_cast<int>(month), static_cast<int>(year)));
+        return Date::daysFromCivil(static_cast<int32_t>(year), static_cast<int32_t>(month), day);
+    }
+
+    // Numbers of the occurrences dated in [firstDay, lastDay], as the half-open range [first, last)
+    void occurrencesBetween(int32_t firstDay, int32_t lastDay, int64_t &first, int64_t &last) const
+    {
+        const int32_t lastSupportedDay = Date(31, 12, 9999).toOrdinal();
+        lastDay = std::min(lastDay, hasEndDate ? endDate.toOrdinal() : lastSupportedDay);
+        lastDay = std::min(lastDay, lastSupportedDay);
+        if (lastDay < firstDay || lastDay < startDate.toOrdinal())
+        {
+            first = last = 0;
+            return;
+        }
+        first = firstOccurrenceFrom(firstDay);
+        last = firstOccurrenceFrom(static_cast<int64_t>(lastDay) + 1);
+    }
+
+    int64_t totalBetween(int32_t firstDay, int32_t lastDay) const // Sum of the occurrences dated in [firstDay, lastDay], in minor units
+    {
+        int64_t first, last;
+        occurrencesBetween(firstDay, lastDay, first, last);
+        return (last - first) * amount.getMinorUnits();
+    }
+
+    template <typename Visitor>
+    void forEachOccurrence(int32_t firstDay, int32_t lastDay, Visitor visit) const // Call visit with the day of every occurrence in [firstDay, lastDay]
+    {
+        int64_t first, last;
+        occurrencesBetween(firstDay, lastDay, first, last);
+        for (int64_t index = first; index < last; ++index)
+        {
+            visit(static_cast<int32_t>(occurrenceDay(index)));
+        }
+    }
+
+    // Writes the rule to the user file:
+    //     Recurring <id> <Income|Expense> <Daily|Weekly|Monthly|Yearly> <start date> <end date or ->
+    //     <amount>
+    //     <description>
+    //     <category>        (expenses only)
+    void write(std::ostream &file) const
+    {
+        const char *cadenceNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+        file << "Recurring " << id << (type == EXPENSE_TRANSACTION ? " Expense " : " Income ") << cadenceNames[cadence] << " "
+             << startDate << " ";
+        if (hasEndDate)
+        {
+            file << endDate << "\n";
+        }
+        else
+        {
+            file << "-\n";
+        }
+        file << amount << "\n"
+             << description << "\n";
+        if (type == EXPENSE_TRANSACTION)
+        {
+            file << categoryName << "\n";
+        }
+    }
+
+    static size_t recordLength(const std::string &header) // Number of lines of the rule that starts with this "Recurring" line
+    {
+        return header.find(" Expense ") != std::string::npos ? 4 : 3;
+    }
+
+    // Parses a rule written by write(), given as its lines. Returns false if they are not a valid rule.
+    static bool parse(const std::vector<std::string> &lines, RecurringRule &rule)
+    {
+        std::istringstream header(lines[0]);
+        std::string keyword, typeName, cadenceName, startString, endString;
+        uint64_t ruleId;
+        if (!(header >> keyword >> ruleId >> typeName >> cadenceName >> startString >> endString) || lines.size() != recordLength(lines[0]))
+        {
+            return false;
+        }
+        const char *cadenceNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+        int cadence = static_cast<int>(std::find(cadenceNames, cadenceNames + 4, cadenceName) - cadenceNames);
+        Date start, end;
+        Money ruleAmount;
+        bool bounded = endString != "-";
+        if (cadence == 4 || (typeName != "Income" && typeName != "Expense") || !Date::parse(startString, start) || !start.checkValidity() ||
+            (bounded && (!Date::parse(endString, end) || !end.checkValidity())) || !Money::parse(lines[1], ruleAmount))
+        {
+            return false;
+        }
+        std::string ruleDescription = lines[2];
+        if (!ruleDescription.empty() && ruleDescription.back() == '\r')
+        {
+            ruleDescription.pop_back();
+        }
+        std::string ruleCategory = lines.size() > 3 ? lines[3] : "";
+        if (!ruleCategory.empty() && ruleCategory.back() == '\r')
+        {
+            ruleCategory.pop_back();
+        }
+        rule = RecurringRule(typeName == "Expense" ? EXPENSE_TRANSACTION : INCOME_TRANSACTION, ruleAmount, ruleDescription, ruleCategory,
+                             static_cast<TimeInterval>(cadence), start, bounded, end);
+        rule.setId(ruleId);
+        return true;
+    }
+};
+
+// This class is a spending limit per day, week, month or year, for one category or, if it has no category,
+// for all expenses. It keeps the recorded expenses it covers per period, updated as transactions are added,
+// removed and edited, so checking it never looks at the history. Reaching warningPercent of the limit
+// raises a warning, reaching the limit an alert.
+class Budget
+{
+private:
+    uint64_t id;
+    std::string categoryName; // Empty for a budget over all expenses
+    uint32_t categoryId;      // Interned id of categoryName, set by the user the budget belongs to
+    TimeInterval period;
+    Money limit;
+    int warningPercent;
+    std::unordered_map<int64_t, int64_t> spent; // Recorded expenses per period, keyed by intervalBucket
+
+public:
+    Budget(const std::string &categoryName, TimeInterval period, const Money &limit, int warningPercent)
+        : id(0), categoryName(categoryName), categoryId(0), period(period), limit(limit), warningPercent(warningPercent) {}
+
+    uint64_t getId() const // Getter for id
+    {
+        return id;
+    }
+
+    void setId(uint64_t newId)
+    {
+        id = newId;
+    }
+
+    const std::string &getCategoryName() const
+    {
+        return categoryName;
+    }
+
+    void setCategoryId(uint32_t newCategoryId) // Also forgets the tracked expenses, which have to be tracked again
+    {
+        categoryId = newCategoryId;
+        spent.clear();
+    }
+
+    TimeInterval getPeriod() const
+    {
+        return period;
+    }
+
+    const Money &getLimit() const
+    {
+        return limit;
+    }
+
+    int getWarningPercent() const
+    {
+        return warningPercent;
+    }
+
+    bool covers(const MonthlyRollups::Entry &entry) const // Whether the budget counts this transaction
+    {
+        return entry.type == EXPENSE_TRANSACTION && (categoryName.empty() || entry.category == categoryId);
+    }
+
+    void track(const MonthlyRollups::Entry &entry, int64_t sign) // Count a transaction (sign 1) or stop counting it (sign -1)
+    {
+        if (!covers(entry))
+        {
+            return;
+        }
+        int64_t bucket = intervalBucket(entry.date, period);
+        int64_t &total = spent[bucket];
+        total += sign * entry.amount;
+        if (total == 0)
+        {
+            spent.erase(bucket);
+        }
+    }
+
+    int64_t spentIn(int64_t bucket) const // Recorded expenses in a period, in minor units
+    {
+        auto it = spent.find(bucket);
+        return it == spent.end() ? 0 : it->second;
+    }
+
+    int level(int64_t amountSpent) const // 0 below the warning, 1 at or above the warning, 2 at or above the limit
+    {
+        if (amountSpent >= limit.getMinorUnits())
+        {
+            return 2;
+        }
+        return amountSpent * 100 >= limit.getMinorUnits() * warningPercent ? 1 : 0;
+    }
+
+    // Writes the budget to the user file as one line:
+    //     Budget <id> <Daily|Weekly|Monthly|Yearly> <limit> <warning percent> <category, empty for all expenses>
+    void write(std::ostream &file) const
+    {
+        const char *periodNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+        file << "Budget " << id << " " << periodNames[period] << " " << limit << " " << warningPercent << " " << categoryName << "\n";
+    }
+
+    static bool parse(const std::string &line, Budget &budget) // Parses a line written by write()
+    {
+        std::istringstream fields(line);
+        std::string keyword, periodName, limitString;
+        uint64_t budgetId;
+        int percent;
+        Money budgetLimit;
+        if (!(fields >> keyword >> budgetId >> periodName >> limitString >> percent) || !Money::parse(limitString, budgetLimit))
+        {
+            return false;
+        }
+        const char *periodNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+        int budgetPeriod = static_cast<int>(std::find(periodNames, periodNames + 4, periodName) - periodNames);
+        if (budgetPeriod == 4)
+        {
+            return false;
+        }
+        std::string name;
+        fields.get(); // The space before the category
+        std::getline(fields, name);
+        if (!name.empty() && name.back() == '\r')
+        {
+            name.pop_back();
+        }
+        budget = Budget(name, static_cast<TimeInterval>(budgetPeriod), budgetLimit, percent);
+        budget.setId(budgetId);
+        return true;
+    }
+};
+
+// Writes the amount line of a record. Amounts in the home currency are written without a currency code,
+// as before there were other currencies; others are followed by their code, as in "12.50 USD".
+void writeRecordAmount(RecordWriter &out, const Transaction *transaction)
+{
+    char *end = transaction->getAmount().format(out.reserve(FORMAT_BUFFER_SIZE + 5));
+    if (transaction->getCurrency() != BASE_CURRENCY)
+    {
+        *end++ = ' ';
+        end = transaction->getCurrency().format(end);
+    }
+    *end++ = '\n';
+    out.commit(end);
+}
+
+// This function writes a transaction as a record of the user file: a type line carrying the id of the
+// transaction, then amount, description, date and, for expenses, the category, each on its own line.
+void writeTransactionRecord(RecordWriter &out, const Transaction *transaction)
+{
+    const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction); // Check if transaction is an expense transaction
+    if (expenseTransaction)
+    {
+        out.write("Expense ", 8);
+    }
+    else if (dynamic_cast<const Income *>(transaction)) // Check if transaction is an income transaction
+    {
+        out.write("Income ", 7);
+    }
+    else
+    {
+        return;
+    }
+    char *end = formatUnsigned(out.reserve(FORMAT_BUFFER_SIZE), transaction->getId());
+    *end++ = '\n';
+    out.commit(end);
+    writeRecordAmount(out, transaction);
+    out.write(transaction->getDescription());
+    out.put('\n');
+    end = transaction->getDate().format(out.reserve(FORMAT_BUFFER_SIZE));
+    *end++ = '\n';
+    out.commit(end);
+    if (expenseTransaction)
+    {
+        out.write(expenseTransaction->getCategory().getName());
+        out.put('\n');
+    }
+}
+
+void writeTransactionRecord(std::ostream &file, const Transaction *transaction)
+{
+    RecordWriter out(file);
+    writeTransactionRecord(out, transaction);
+}
+
+// Archive tier
+// Transactions dated in years that ended before a horizon can be sealed into archive segments, one per user and year,
+// in data/<username>.<year>.<generation>.archive. A segment never changes once written: archiving more transactions
+// of a year writes the next generation, and the user file names the generation in use with an "Archive <year>
+// <generation>" line. A segment is a header line, a compressed body and a summary footer:
+//     Archive <year> <transaction count> <largest id> <body size in bytes>
+//     <body>
+//     Categories <count>, then one category name per line
+//     Month <month> <transaction count> <income> <expenses>
+//     MonthCategory <month> <category number> <expenses>
+//     End
+// The body holds the transactions in date order. Descriptions and currencies are stored once and referred to by
+// number, and ids, dates and amounts are written as variable-length integers, the ids and dates as differences from
+// the transaction before. The footer amounts are minor units of the home currency. Logging in reads only the footers;
+// the body of a year is decompressed when a report needs single transactions of it rather than monthly totals.
+
+const int ARCHIVE_HORIZON_MONTHS = 24; // By default, the archive command seals the years that ended this many months ago
+
+void putVarint(std::string &out, uint64_t value) // Append value in groups of 7 bits, lowest group first
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool getVarint(const char *&position, const char *end, uint64_t &value) // Read a value written by putVarint
+{
+    value = 0;
+    for (int shift = 0; position != end && shift < 64; shift += 7)
+    {
+        uint8_t byte = static_cast<uint8_t>(*position++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzagEncode(int64_t value) // Interleave negative and positive values, so that small ones of either sign stay short
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// This class is an archive segment as described by its header and footer. The transactions are only read
+// from the file by readEntries.
+class ArchiveSegment
+{
+public:
+    struct MonthTotals
+    {
+        size_t count;
+        int64_t income;
+        int64_t expenses;
+        std::map<uint32_t, int64_t> categoryExpenses; // By category number, the position in categoryNames
+
+        MonthTotals() : count(0), income(0), expenses(0) {}
+    };
+
+    int32_t year;
+    uint64_t generation;
+    size_t count;
+    uint64_t largestId;
+    std::string path;
+    std::vector<std::string> categoryNames;
+    MonthTotals months[12];
+
+    ArchiveSegment() : year(0), generation(0), count(0), largestId(0) {}
+
+    static std::string pathFor(const std::string &username, int32_t year, uint64_t generation)
+    {
+        return "data/" + username + "." + std::to_string(year) + "." + std::to_string(generation) + ".archive";
+    }
+
+    static bool parseReference(const std::string &line, int32_t &year, uint64_t &generation) // Parse an "Archive <year> <generation>" line of a user file
+    {
+        std::istringstream fields(line);
+        std::string tag;
+        return (fields >> tag >> year >> generation) && tag == "Archive";
+    }
+
+    int32_t firstDay() const
+    {
+        return Date::daysFromCivil(year, 1, 1);
+    }
+
+    int32_t lastDay() const
+    {
+        return Date::daysFromCivil(year, 12, 31);
+    }
+
+    // This function writes the given transactions, all dated in year, as generation of the segment of the year,
+    // and returns the new segment.
+    static ArchiveSegment write(const std::string &username, int32_t year, uint64_t generation, std::vector<const Transaction *> sealed)
+    {
+        std::sort(sealed.begin(), sealed.end(), [](const Transaction *a, const Transaction *b)
+                  { return a->getDate().toOrdinal() < b->getDate().toOrdinal() ||
+                           (a->getDate().toOrdinal() == b->getDate().toOrdinal() && a->getId() < b->getId()); });
+        ArchiveSegment segment;
+        segment.year = year;
+        segment.generation = generation;
+        segment.count = sealed.size();
+        segment.path = pathFor(username, year, generation);
+        std::map<std::string, uint32_t> categoryNumbers;
+        std::map<std::string, uint64_t> descriptionNumbers;
+        std::map<uint32_t, uint64_t> currencyNumbers;
+        std::string descriptions, currencies, records;
+        int32_t previousDate = segment.firstDay();
+        uint64_t previousId = 0;
+        for (const Transaction *transaction : sealed)
+        {
+            const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+            int32_t date = transaction->getDate().toOrdinal();
+            int64_t homeAmount = exchangeRates.convert(transaction->getAmount().getMinorUnits(), transaction->getCurrency(), BASE_CURRENCY, date);
+            MonthTotals &month = segment.months[transaction->getDate().getMonth() - 1];
+            ++month.count;
+            uint64_t kind = 0; // 0 for income, the category number plus one for expenses
+            if (expenseTransaction)
+            {
+                auto category = categoryNumbers.insert(std::make_pair(expenseTransaction->getCategory().getName(), static_cast<uint32_t>(categoryNumbers.size())));
+                if (category.second)
+                {
+                    segment.categoryNames.push_back(category.first->first);
+                }
+                kind = category.first->second + 1;
+                month.expenses += homeAmount;
+                month.categoryExpenses[category.first->second] += homeAmount;
+            }
+            else
+            {
+                month.income += homeAmount;
+            }
+            auto description = descriptionNumbers.insert(std::make_pair(transaction->getDescription(), static_cast<uint64_t>(descriptionNumbers.size())));
+            if (description.second)
+            {
+                putVarint(descriptions, transaction->getDescription().size());
+                descriptions += transaction->getDescription();
+            }
+            auto currency = currencyNumbers.insert(std::make_pair(transaction->getCurrency().getCode(), static_cast<uint64_t>(currencyNumbers.size())));
+            if (currency.second)
+            {
+                currencies += transaction->getCurrency().toString();
+            }
+            putVarint(records, static_cast<uint64_t>(date - previousDate));
+            putVarint(records, zigzagEncode(static_cast<int64_t>(transaction->getId() - previousId)));
+            putVarint(records, kind);
+            putVarint(records, zigzagEncode(transaction->getAmount().getMinorUnits()));
+            putVarint(records, description.first->second);
+            putVarint(records, currency.first->second);
+            if (transaction->getCurrency() != BASE_CURRENCY) // The converted amount, so that the footer and the body agree whatever the rates become
+            {
+                putVarint(records, zigzagEncode(homeAmount));
+            }
+            previousDate = date;
+            previousId = transaction->getId();
+            segment.largestId = std::max(segment.largestId, transaction->getId());
+        }
+        std::string body;
+        putVarint(body, descriptionNumbers.size());
+        body += descriptions;
+        putVarint(body, currencyNumbers.size());
+        body += currencies;
+        body += records;
+
+        std::ofstream file(segment.path, std::ios::binary);
+        if (!file)
+        {
+            throw FinancialException("Error archiving transactions: Archive file Cannot be opened.");
+        }
+        file << "Archive " << year << " " << segment.count << " " << segment.largestId << " " << body.size() << "\n";
+        file.write(body.data(), static_cast<std::streamsize>(body.size()));
+        file << "Categories " << segment.categoryNames.size() << "\n";
+        for (const auto &name : segment.categoryNames)
+        {
+            file << name << "\n";
+        }
+        for (int month = 0; month < 12; ++month)
+        {
+            const MonthTotals &totals = segment.months[month];
+            if (totals.count == 0)
+            {
+                continue;
+            }
+            file << "Month " << month + 1 << " " << totals.count << " " << totals.income << " " << totals.expenses << "\n";
+            for (const auto &category : totals.categoryExpenses)
+            {
+                file << "MonthCategory " << month + 1 << " " << category.first << " " << category.second << "\n";
+            }
+        }
+        file << "End\n";
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+        file.close();
+        if (!file)
+        {
+            std::remove(segment.path.c_str());
+            throw FinancialException("Error archiving transactions: Archive file Cannot be written.");
+        }
+        return segment;
+    }
+
+    // This function reads the header and the footer of the given generation of the segment of year, skipping the body.
+    static ArchiveSegment read(const std::string &username, int32_t year, uint64_t generation)
+    {
+        ArchiveSegment segment;
+        segment.path = pathFor(username, year, generation);
+        segment.generation = generation;
+        std::ifstream file(segment.path, std::ios::binary);
+        std::string line;
+        uint64_t bodySize = 0;
+        if (!file || !std::getline(file, line) || !segment.parseHeader(line, bodySize) || segment.year != year ||
+            !file.seekg(static_cast<std::streamoff>(bodySize), std::ios::cur))
+        {
+            throw FinancialException("Error loading user data: Archive " + segment.path + " is damaged.");
+        }
+        size_t bytesRead = line.size() + 1;
+        size_t categoryCount = 0;
+        bool ended = false;
+        if (std::getline(file, line))
+        {
+            bytesRead += line.size() + 1;
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag >> categoryCount;
+            for (size_t i = 0; fields && tag == "Categories" && i < categoryCount && std::getline(file, line); ++i)
+            {
+                bytesRead += line.size() + 1;
+                segment.categoryNames.push_back(line);
+            }
+        }
+        while (segment.categoryNames.size() == categoryCount && std::getline(file, line))
+        {
+            bytesRead += line.size() + 1;
+            std::istringstream fields(line);
+            std::string tag;
+            int month = 0;
+            if ((fields >> tag) && tag == "End")
+            {
+                ended = true;
+                break;
+            }
+            if (!(fields >> month) || month < 1 || month > 12)
+            {
+                break;
+            }
+            MonthTotals &totals = segment.months[month - 1];
+            uint32_t category = 0;
+            int64_t expenses = 0;
+            if (tag == "Month" && !(fields >> totals.count >> totals.income >> totals.expenses))
+            {
+                break;
+            }
+            if (tag == "MonthCategory")
+            {
+                if (!(fields >> category >> expenses) || category >= categoryCount)
+                {
+                    break;
+                }
+                totals.categoryExpenses[category] += expenses;
+            }
+        }
+        STAT_ADD(STAT_BYTES_READ, bytesRead);
+        if (!ended)
+        {
+            throw FinancialException("Error loading user data: Archive " + segment.path + " is damaged.");
+        }
+        return segment;
+    }
+
+    // This function decompresses the body of the segment into entries in date order. The category of an entry is the
+    // category number in the segment and its amount is in the home currency. The caller owns the transactions.
+    std::vector<MonthlyRollups::Entry> readEntries() const
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::string line;
+        ArchiveSegment header;
+        uint64_t bodySize = 0;
+        std::string body;
+        if (file && std::getline(file, line) && header.parseHeader(line, bodySize) && header.year == year && header.count == count)
+        {
+            body.resize(static_cast<size_t>(bodySize));
+            file.read(&body[0], static_cast<std::streamsize>(body.size()));
+        }
+        if (!file || body.size() != bodySize)
+        {
+            throw FinancialException("Error reading archive " + path + ": File is damaged.");
+        }
+        STAT_ADD(STAT_BYTES_READ, line.size() + 1 + body.size());
+
+        const char *position = body.data();
+        const char *end = body.data() + body.size();
+        std::vector<std::string> descriptions;
+        std::vector<Currency> currencies;
+        uint64_t tableSize = 0, value = 0;
+        bool valid = getVarint(position, end, tableSize);
+        for (uint64_t i = 0; valid && i < tableSize; ++i)
+        {
+            valid = getVarint(position, end, value) && value <= static_cast<uint64_t>(end - position);
+            if (valid)
+            {
+                descriptions.push_back(std::string(position, static_cast<size_t>(value)));
+                position += value;
+            }
+        }
+        valid = valid && getVarint(position, end, tableSize);
+        for (uint64_t i = 0; valid && i < tableSize; ++i)
+        {
+            Currency currency;
+            valid = end - position >= 3 && Currency::parse(position, position + 3, currency);
+            currencies.push_back(currency);
+            position += 3;
+        }
+        std::vector<MonthlyRollups::Entry> entries;
+        entries.reserve(count);
+        int32_t date = firstDay();
+        uint64_t id = 0;
+        while (valid && entries.size() < count)
+        {
+            uint64_t dayDelta, idDelta, kind, amount, description, currency;
+            valid = getVarint(position, end, dayDelta) && getVarint(position, end, idDelta) && getVarint(position, end, kind) &&
+                    getVarint(position, end, amount) && getVarint(position, end, description) && getVarint(position, end, currency) &&
+                    kind <= categoryNames.size() && description < descriptions.size() && currency < currencies.size();
+            if (!valid)
+            {
+                break;
+            }
+            date += static_cast<int32_t>(dayDelta);
+            id += static_cast<uint64_t>(zigzagDecode(idDelta));
+            Money money = Money::fromMinorUnits(zigzagDecode(amount));
+            MonthlyRollups::Entry entry;
+            if (kind == 0)
+            {
+                entry.transaction = new Income(money, descriptions[description], Date::fromOrdinal(date));
+                entry.type = INCOME_TRANSACTION;
+                entry.category = 0;
+            }
+            else
+            {
+                entry.transaction = new Expense(money, descriptions[description], Date::fromOrdinal(date), Category(categoryNames[kind - 1]));
+                entry.type = EXPENSE_TRANSACTION;
+                entry.category = static_cast<uint32_t>(kind - 1);
+            }
+            Transaction *transaction = const_cast<Transaction *>(entry.transaction);
+            transaction->setId(id);
+            transaction->setCurrency(currencies[currency]);
+            entry.amount = money.getMinorUnits();
+            entry.date = date;
+            entries.push_back(entry);
+            if (currencies[currency] != BASE_CURRENCY)
+            {
+                valid = getVarint(position, end, value);
+                entries.back().amount = zigzagDecode(value);
+            }
+        }
+        if (!valid || position != end || entries.size() != count)
+        {
+            for (const auto &entry : entries)
+            {
+                delete entry.transaction;
+            }
+            throw FinancialException("Error reading archive " + path + ": File is damaged.");
+        }
+        return entries;
+    }
+
+    // This function decompresses the body and checks it against the footer: every transaction dated in the year
+    // and every total of the footer equal to the sum of the transactions. Returns false if anything differs.
+    bool verify() const
+    {
+        std::vector<MonthlyRollups::Entry> entries;
+        try
+        {
+            entries = readEntries();
+        }
+        catch (const FinancialException &)
+        {
+            return false;
+        }
+        MonthTotals sums[12];
+        bool valid = true;
+        for (const auto &entry : entries)
+        {
+            valid = valid && entry.date >= firstDay() && entry.date <= lastDay();
+            if (valid)
+            {
+                MonthTotals &totals = sums[Date::monthFromDays(entry.date) - 1];
+                ++totals.count;
+                if (entry.type == INCOME_TRANSACTION)
+                {
+                    totals.income += entry.amount;
+                }
+                else
+                {
+                    totals.expenses += entry.amount;
+                    totals.categoryExpenses[entry.category] += entry.amount;
+                }
+            }
+            delete entry.transaction;
+        }
+        for (int month = 0; valid && month < 12; ++month)
+        {
+            valid = sums[month].count == months[month].count && sums[month].income == months[month].income &&
+                    sums[month].expenses == months[month].expenses && sums[month].categoryExpenses == months[month].categoryExpenses;
+        }
+        return valid;
+    }
+
+private:
+    bool parseHeader(const std::string &line, uint64_t &bodySize) // Parse the "Archive <year> <count> <largest id> <body size>" line
+    {
+        std::istringstream fields(line);
+        std::string tag;
+        return (fields >> tag >> year >> count >> largestId >> bodySize) && tag == "Archive";
+    }
+};
+
+// This class holds the archive segments of a user. The footer totals of every segment are kept in memory, with the
+// category numbers of the segment mapped to the category ids of the user, and answer the sums over whole months.
+// The transactions of a segment are decompressed the first time a sum covers part of one of its months, or a query,
+// search or conversion needs them, and are then kept until the user is freed. Reports may read a snapshot of the
+// user on several threads, so decompressing happens under a mutex.
+class ArchiveTier
+{
+public:
+    struct Detail // The transactions of a segment, in date order
+    {
+        std::vector<std::unique_ptr<Transaction>> transactions;
+        std::vector<MonthlyRollups::Entry> entries;
+        std::unordered_map<uint64_t, size_t> positions; // Position in entries, by transaction id
+    };
+
+private:
+    struct Sealed
+    {
+        ArchiveSegment segment;
+        std::vector<uint32_t> categoryIds;                         // Category id of every category number of the segment
+        std::unordered_map<uint32_t, int64_t> categoryExpenses[12]; // Expenses per month and category id
+        mutable std::shared_ptr<const Detail> detail;               // Set once the body was decompressed
+    };
+
+    std::map<int32_t, Sealed> sealedYears; // By year
+    int64_t income;                        // Totals over all segments
+    int64_t expenses;
+    size_t count;
+    std::unordered_map<uint32_t, int64_t> categoryTotals; // Expenses per category id over all segments
+    TrendSums incomeTrend;                                // Trend sums over all segments
+    TrendSums expensesTrend;
+    std::unordered_map<uint32_t, TrendSums> categoryTrends;
+    mutable std::mutex detailMutex;
+
+    std::shared_ptr<const Detail> load(const Sealed &sealed) const
+    {
+        std::lock_guard<std::mutex> lock(detailMutex);
+        if (!sealed.detail)
+        {
+            std::shared_ptr<Detail> detail = std::make_shared<Detail>();
+            detail->entries = sealed.segment.readEntries();
+            detail->transactions.reserve(detail->entries.size());
+            for (size_t i = 0; i < detail->entries.size(); ++i)
+            {
+                MonthlyRollups::Entry &entry = detail->entries[i];
+                detail->transactions.emplace_back(const_cast<Transaction *>(entry.transaction));
+                if (entry.type == EXPENSE_TRANSACTION)
+                {
+                    entry.category = sealed.categoryIds[entry.category];
+                }
+                detail->positions[entry.transaction->getId()] = i;
+            }
+            sealed.detail = detail;
+        }
+        return sealed.detail;
+    }
+
+    template <typename Visitor>
+    void visitDetail(const Sealed &sealed, int32_t firstDay, int32_t lastDay, Visitor visit) const // Call visit for every entry of the segment dated in [firstDay, lastDay]
+    {
+        std::shared_ptr<const Detail> detail = load(sealed);
+        auto entry = std::lower_bound(detail->entries.begin(), detail->entries.end(), firstDay, [](const MonthlyRollups::Entry &entry, int32_t day)
+                                      { return entry.date < day; });
+        size_t scanned = 0;
+        for (; entry != detail->entries.end() && entry->date <= lastDay; ++entry)
+        {
+            visit(*entry);
+            ++scanned;
+        }
+        STAT_ADD(STAT_TRANSACTIONS_SCANNED, scanned);
+    }
+
+    // Calls whole(month, first day of month) for every month of the segments that lies in [firstDay, lastDay] and has
+    // transactions, and part(month, first day, last day) with the covered days of every month that lies in it in part.
+    template <typename Whole, typename Part>
+    void forEachMonth(int32_t firstDay, int32_t lastDay, Whole whole, Part part) const
+    {
+        for (const auto &year : sealedYears)
+        {
+            const Sealed &sealed = year.second;
+            if (sealed.segment.lastDay() < firstDay || sealed.segment.firstDay() > lastDay)
+            {
+                continue;
+            }
+            for (int month = 0; month < 12; ++month)
+            {
+                int32_t monthFirst = Date::daysFromCivil(year.first, month + 1, 1);
+                int32_t monthLast = Date::daysFromCivil(year.first, month + 1, Date::daysInMonth(month + 1, year.first));
+                if (sealed.segment.months[month].count == 0 || monthLast < firstDay || monthFirst > lastDay)
+                {
+                    continue;
+                }
+                if (firstDay <= monthFirst && monthLast <= lastDay)
+                {
+                    whole(sealed, month, monthFirst);
+                }
+                else
+                {
+                    part(sealed, std::max(firstDay, monthFirst), std::min(lastDay, monthLast));
+                }
+            }
+        }
+    }
+
+public:
+    ArchiveTier() : income(0), expenses(0), count(0) {}
+
+    ArchiveTier(const ArchiveTier &other) // The copy shares the transactions other has decompressed so far
+        : income(0), expenses(0), count(0)
+    {
+        std::lock_guard<std::mutex> lock(other.detailMutex);
+        sealedYears = other.sealedYears;
+        income = other.income;
+        expenses = other.expenses;
+        count = other.count;
+        categoryTotals = other.categoryTotals;
+        incomeTrend = other.incomeTrend;
+        expensesTrend = other.expensesTrend;
+        categoryTrends = other.categoryTrends;
+    }
+
+    // Add a segment, replacing the one of the same year if there is one. internCategory maps a category name to
+    // its id in the user.
+    void attach(const ArchiveSegment &segment, const std::function<uint32_t(const std::string &)> &internCategory)
+    {
+        detach(segment.year);
+        Sealed &sealed = sealedYears[segment.year];
+        sealed.segment = segment;
+        for (const auto &name : segment.categoryNames)
+        {
+            sealed.categoryIds.push_back(internCategory(name));
+        }
+        for (int month = 0; month < 12; ++month)
+        {
+            income += segment.months[month].income;
+            expenses += segment.months[month].expenses;
+            count += segment.months[month].count;
+            incomeTrend.add(segment.year * 12 + month, segment.months[month].income);
+            expensesTrend.add(segment.year * 12 + month, segment.months[month].expenses);
+            for (const auto &category : segment.months[month].categoryExpenses)
+            {
+                uint32_t categoryId = sealed.categoryIds[category.first];
+                sealed.categoryExpenses[month][categoryId] += category.second;
+                categoryTotals[categoryId] += category.second;
+                categoryTrends[categoryId].add(segment.year * 12 + month, category.second);
+            }
+        }
+    }
+
+    void detach(int32_t year) // Forget the segment of a year
+    {
+        auto it = sealedYears.find(year);
+        if (it == sealedYears.end())
+        {
+            return;
+        }
+        for (int month = 0; month < 12; ++month)
+        {
+            income -= it->second.segment.months[month].income;
+            expenses -= it->second.segment.months[month].expenses;
+            count -= it->second.segment.months[month].count;
+            incomeTrend.add(year * 12 + month, -it->second.segment.months[month].income);
+            expensesTrend.add(year * 12 + month, -it->second.segment.months[month].expenses);
+            for (const auto &category : it->second.categoryExpenses[month])
+            {
+                categoryTotals[category.first] -= category.second;
+                categoryTrends[category.first].add(year * 12 + month, -category.second);
+            }
+        }
+        sealedYears.erase(it);
+    }
+
+    void clear()
+    {
+        sealedYears.clear();
+        income = expenses = 0;
+        count = 0;
+        categoryTotals.clear();
+        incomeTrend = TrendSums();
+        expensesTrend = TrendSums();
+        categoryTrends.clear();
+    }
+
+    std::vector<ArchiveSegment> segments() const // The segments, in year order
+    {
+        std::vector<ArchiveSegment> found;
+        for (const auto &year : sealedYears)
+        {
+            found.push_back(year.second.segment);
+        }
+        return found;
+    }
+
+    const ArchiveSegment *find(int32_t year) const // The segment of a year, nullptr if there is none
+    {
+        auto it = sealedYears.find(year);
+        return it == sealedYears.end() ? nullptr : &it->second.segment;
+    }
+
+    std::shared_ptr<const Detail> readDetail(int32_t year) const // The transactions of the segment of a year, nullptr if there is none
+    {
+        auto it = sealedYears.find(year);
+        return it == sealedYears.end() ? nullptr : load(it->second);
+    }
+
+    size_t size() const // Number of archived transactions
+    {
+        return count;
+    }
+
+    bool span(int32_t &firstDay, int32_t &lastDay) const // First and last day of the archived years, false if there are none
+    {
+        if (sealedYears.empty())
+        {
+            return false;
+        }
+        firstDay = Date::daysFromCivil(sealedYears.begin()->first, 1, 1);
+        lastDay = Date::daysFromCivil(sealedYears.rbegin()->first, 12, 31);
+        return true;
+    }
+
+    int64_t net() const // Income minus expenses over all segments
+    {
+        return income - expenses;
+    }
+
+    void write(std::ostream &file) const // Write the "Archive <year> <generation>" lines of the user file
+    {
+        for (const auto &year : sealedYears)
+        {
+            file << "Archive " << year.first << " " << year.second.segment.generation << "\n";
+        }
+    }
+
+    bool findEntry(uint64_t transactionId, MonthlyRollups::Entry &entry) const // Look up a transaction among the decompressed segments
+    {
+        std::lock_guard<std::mutex> lock(detailMutex);
+        for (const auto &year : sealedYears)
+        {
+            const Detail *detail = year.second.detail.get();
+            if (!detail)
+            {
+                continue;
+            }
+            auto position = detail->positions.find(transactionId);
+            if (position != detail->positions.end())
+            {
+                entry = detail->entries[position->second];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int64_t sum(uint8_t type, bool anyCategory, uint32_t category, int32_t firstDay, int32_t lastDay) const
+    {
+        int64_t total = 0;
+        forEachMonth(firstDay, lastDay, [&](const Sealed &sealed, int month, int32_t)
+                     {
+                         if (anyCategory)
+                         {
+                             total += type == INCOME_TRANSACTION ? sealed.segment.months[month].income : sealed.segment.months[month].expenses;
+                         }
+                         else if (type == EXPENSE_TRANSACTION)
+                         {
+                             auto it = sealed.categoryExpenses[month].find(category);
+                             total += it == sealed.categoryExpenses[month].end() ? 0 : it->second;
+                         } },
+                     [&](const Sealed &sealed, int32_t partFirst, int32_t partLast)
+                     { visitDetail(sealed, partFirst, partLast, [&](const MonthlyRollups::Entry &entry)
+                                   {
+                                       if (entry.type == type && (anyCategory || entry.category == category))
+                                       {
+                                           total += entry.amount;
+                                       } }); });
+        return total;
+    }
+
+    int64_t sumForCategory(uint32_t category) const // Expenses of a category over all segments
+    {
+        auto it = categoryTotals.find(category);
+        return it == categoryTotals.end() ? 0 : it->second;
+    }
+
+    // Adds the trend sums of all segments to income, expenses and categories, and lowers firstMonth to the first
+    // archived month with transactions. Only years that are over are archived, so all of it is history.
+    void addTrendSums(int32_t &firstMonth, TrendSums &income, TrendSums &expenses, std::unordered_map<uint32_t, TrendSums> &categories) const
+    {
+        income.add(incomeTrend);
+        expenses.add(expensesTrend);
+        for (const auto &category : categoryTrends)
+        {
+            categories[category.first].add(category.second);
+        }
+        if (!sealedYears.empty())
+        {
+            const auto &first = *sealedYears.begin();
+            int month = 0;
+            while (month < 11 && first.second.segment.months[month].count == 0)
+            {
+                ++month;
+            }
+            firstMonth = std::min(firstMonth, first.first * 12 + month);
+        }
+    }
+
+    template <typename Visitor>
+    void forEachEntry(int32_t firstDay, int32_t lastDay, Visitor visit) const // Call visit for every archived entry dated in [firstDay, lastDay]
+    {
+        for (const auto &year : sealedYears)
+        {
+            if (year.second.segment.lastDay() >= firstDay && year.second.segment.firstDay() <= lastDay)
+            {
+                visitDetail(year.second, firstDay, lastDay, visit);
+            }
+        }
+    }
+
+    // Adds the archived amounts dated in [firstDay, lastDay] to the income or expenses of their interval, numbered from
+    // firstBucket as in TransactionColumns::accumulateByInterval. Monthly and yearly intervals use the footer totals of
+    // the months they cover whole.
+    void accumulateByInterval(int32_t firstDay, int32_t lastDay, TimeInterval interval, int64_t firstBucket,
+                              std::vector<int64_t> &incomeBuckets, std::vector<int64_t> &expenseBuckets) const
+    {
+        auto addEntry = [&](const MonthlyRollups::Entry &entry)
+        {
+            size_t bucket = static_cast<size_t>(intervalBucket(entry.date, interval) - firstBucket);
+            (entry.type == INCOME_TRANSACTION ? incomeBuckets : expenseBuckets)[bucket] += entry.amount;
+        };
+        forEachMonth(firstDay, lastDay, [&](const Sealed &sealed, int month, int32_t monthFirst)
+                     {
+                         if (interval == MONTHLY || interval == YEARLY)
+                         {
+                             size_t bucket = static_cast<size_t>(intervalBucket(monthFirst, interval) - firstBucket);
+                             incomeBuckets[bucket] += sealed.segment.months[month].income;
+                             expenseBuckets[bucket] += sealed.segment.months[month].expenses;
+                         }
+                         else
+                         {
+                             int32_t monthLast = Date::daysFromCivil(sealed.segment.year, month + 1, Date::daysInMonth(month + 1, sealed.segment.year));
+                             visitDetail(sealed, monthFirst, monthLast, addEntry);
+                         } },
+                     [&](const Sealed &sealed, int32_t partFirst, int32_t partLast)
+                     { visitDetail(sealed, partFirst, partLast, addEntry); });
+    }
+};
+
+std::set<std::string> users;         // Set of usernames, used to check if a username is already taken
+class User;                          // Forward declaration of User class
+void saveUserData(const User &user); // Forward declaration of saveUserData function
+void appendJournal(const User &user, const std::string &entries); // Forward declaration of appendJournal function
+
+// This class maps the id of every transaction of a user to its slot. The ids are spread over shards by their low
+// bits, which new ids fill in turn. Like the chunks of a ChunkedVector, the shards are shared by the copies of the
+// map, and a copy clones a shard when it first changes it. Shards are split once they hold SHARD_SIZE ids on average.
+class SlotMap
+{
+private:
+    typedef std::unordered_map<uint64_t, size_t> Shard;
+    static const size_t SHARD_SIZE = 4096;
+
+    CopyOnWrite<std::vector<std::shared_ptr<Shard>>> shards;
+    size_t count;
+
+    const Shard &shardOf(uint64_t transactionId) const
+    {
+        return *(*shards)[transactionId % shards->size()];
+    }
+
+    Shard &writableShard(uint64_t transactionId) // The shard of an id, to change
+    {
+        std::shared_ptr<Shard> &held = shards.write()[transactionId % shards->size()];
+        if (isShared(held))
+        {
+            held = std::make_shared<Shard>(*held);
+        }
+        return *held;
+    }
+
+    void split() // Double the number of shards, moving every id to its new shard
+    {
+        std::vector<std::shared_ptr<Shard>> split(shards->size() * 2);
+        for (auto &shard : split)
+        {
+            shard = std::make_shared<Shard>();
+        }
+        for (const auto &shard : *shards)
+        {
+            for (const auto &slot : *shard)
+            {
+                (*split[slot.first % split.size()])[slot.first] = slot.second;
+            }
+        }
+        shards.write().swap(split);
+    }
+
+public:
+    SlotMap() : count(0)
+    {
+        shards.write().push_back(std::make_shared<Shard>());
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool find(uint64_t transactionId, size_t &slot) const
+    {
+        const Shard &shard = shardOf(transactionId);
+        auto it = shard.find(transactionId);
+        if (it == shard.end())
+        {
+            return false;
+        }
+        slot = it->second;
+        return true;
+    }
+
+    bool contains(uint64_t transactionId) const
+    {
+        return shardOf(transactionId).count(transactionId) != 0;
+    }
+
+    void set(uint64_t transactionId, size_t slot) // Add an id, or move it to another slot
+    {
+        Shard &shard = writableShard(transactionId);
+        size_t before = shard.size();
+        shard[transactionId] = slot;
+        count += shard.size() - before;
+        if (count > shards->size() * SHARD_SIZE)
+        {
+            split();
+        }
+    }
+
+    void erase(uint64_t transactionId)
+    {
+        if (contains(transactionId))
+        {
+            writableShard(transactionId).erase(transactionId);
+            --count;
+        }
+    }
+
+    void clear()
+    {
+        std::vector<std::shared_ptr<Shard>> &all = shards.write();
+        all.assign(1, std::make_shared<Shard>());
+        count = 0;
+    }
+};
+
+const size_t MIN_COMPACTION_SLOTS = 64; // Removed slots are only compacted away once there are more than this
+const size_t MIN_JOURNAL_ENTRIES = 1024; // The journal is folded into the user file once it has more entries than this and the user has transactions
+
+// This code creates a User class, which contains a string that stores the username and a string that stores the password.
+// It also contains a Money amount that stores the balance, and a vector of Transaction pointers that stores the transactions.
+
+class User
+{
+private:
+    std::string id;
+    std::string username;
+    std::string password;
+    Money balance;
+    // Copies of a user share the storage below (see the copy-on-write storage above), so that a snapshot costs a few
+    // reference counts. Transactions are never changed once stored: an edit stores a changed copy in their slot.
+    ChunkedVector<std::shared_ptr<const Transaction>> transactions; // Transactions in the order they were added
+    TransactionColumns columns;                                     // Amounts, dates, types and categories of transactions as arrays, used by the aggregations
+    CopyOnWrite<MonthlyRollups> rollups;                            // Totals per month and category, used by the reports
+    CopyOnWrite<std::vector<RecurringRule>> recurringRules;         // Repeated transactions; their occurrences up to today count without being stored
+    CopyOnWrite<std::vector<std::shared_ptr<const Transaction>>> occurrences; // Occurrences of the rules up to occurrencesDay, in date order; never saved
+    CopyOnWrite<std::vector<Budget>> budgets;                       // Spending limits, each tracking what it has spent per period
+    CopyOnWrite<ArchiveTier> archives;                              // Sealed years of old transactions, which only count in the totals and reports
+    // The indexes below are only used by lookups that a snapshot cannot make, so copies do not share them; each
+    // builds its own on first use.
+    CategoryIndex categoryIndex;   // Expenses by category, built by the first query by category
+    bool categoryIndexBuilt;       // Set once categoryIndex holds all transactions and is kept up to date
+    SearchIndex searchIndex;       // Words of descriptions and categories, built by the first search
+    bool searchIndexBuilt;         // Set once searchIndex holds all transactions and is kept up to date
+    FingerprintIndex fingerprints; // Fingerprints of transactions, built by the first duplicate check
+    bool fingerprintsBuilt;        // Set once fingerprints holds all transactions and is kept up to date
+    std::vector<std::string> budgetAlerts; // Alerts raised by changes since takeBudgetAlerts was last called
+    // Removed transactions leave an empty slot (nullptr) behind, so that removing one does not shift the others.
+    // The empty slots are compacted away once they make up half of the vector.
+    SlotMap slots;              // Slot in transactions of every transaction, by transaction id
+    size_t removedSlots;        // Number of empty slots in transactions
+    uint64_t nextTransactionId; // Id given to the next new transaction
+    uint64_t nextRuleId;        // Id given to the next new recurring rule
+    uint64_t nextBudgetId;      // Id given to the next new budget
+    size_t journalEntries;      // Changes appended to the journal since the user file was written
+    bool idsAssigned;           // Set when loading gave ids to transactions that had none
+    int32_t occurrencesDay;     // Day occurrences were generated on, INT32_MIN if they were not or the rules changed since
+    // Reports can run on a snapshot of the user on another thread while the user keeps changing. Every change holds
+    // stateMutex and counts itself in version; snapshot copies the user under the same mutex, and only when it has
+    // changed since the last copy. Loading happens before the user is shared, so it takes no lock.
+    mutable std::mutex stateMutex;
+    uint64_t version;                                // Number of changes made to the user
+    mutable std::weak_ptr<const User> lastSnapshot;  // The latest snapshot, reused while anyone still holds it
+    mutable uint64_t lastSnapshotVersion;            // The version lastSnapshot was copied at
+
+    // This class is held by every change to the user, so that a snapshot is never copied from a half-made change.
+    class ChangeGuard
+    {
+    private:
+        std::lock_guard<std::mutex> lock;
+
+    public:
+        explicit ChangeGuard(User &user) : lock(user.stateMutex)
+        {
+            ++user.version;
+        }
+    };
+
+public:
+    User(const std::string &username, const std::string &password) // Constructor that takes a username and a password
+        : username(username), password(password), balance(), categoryIndexBuilt(false), searchIndexBuilt(false), fingerprintsBuilt(false), removedSlots(0),
+          nextTransactionId(1), nextRuleId(1), nextBudgetId(1), journalEntries(0), idsAssigned(false), occurrencesDay(INT32_MIN), version(0), lastSnapshotVersion(0)
+    {
+        id = generateRandomString(username.length()); // Generate a random string of the same length as the username, used as a key to encrypt the password
+    }
+
+    void share(const User &user) // Share the storage of user, used in copy constructor and assignment operator
+    {
+        id = user.id;
+        username = user.username;
+        password = user.password;
+        balance = user.balance;
+        transactions = user.transactions;
+        columns = user.columns;
+        rollups = user.rollups;
+        recurringRules = user.recurringRules;
+        occurrences = user.occurrences;
+        budgets = user.budgets;
+        archives = user.archives;
+        categoryIndex.clear();
+        categoryIndexBuilt = false;
+        searchIndex.clear();
+        searchIndexBuilt = false;
+        fingerprints.clear();
+        fingerprintsBuilt = false;
+        slots = user.slots;
+        removedSlots = user.removedSlots;
+        nextTransactionId = user.nextTransactionId;
+        nextRuleId = user.nextRuleId;
+        nextBudgetId = user.nextBudgetId;
+        journalEntries = user.journalEntries;
+        idsAssigned = user.idsAssigned;
+        occurrencesDay = user.occurrencesDay;
+        reportCache.adopt(user.reportCache, user.version, version);
+    }
+
+    User(const User &user) : version(0), lastSnapshotVersion(0) // Copy constructor
+    {
+        share(user);
+    }
+
+    User &operator=(const User &user) // Assignment operator
+    {
+        if (this != &user)
+        {
+            ChangeGuard change(*this);
+            share(user);
+        }
+        return *this; // Return a reference to the current object, so that the assignment operator can be chained
+    }
+
+    // Returns a read-only copy of the user as it is now, which reports and exports can read on any thread, without
+    // locks, while this user keeps adding, editing and removing transactions. A new copy is only made when the user
+    // has changed since the last one; each copy is freed when its last reader lets go of it. The copy shares the
+    // storage of the user, so making it only takes references under stateMutex; the user clones the chunks and
+    // months it changes while a copy still holds them.
+    std::shared_ptr<const User> snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        std::shared_ptr<const User> current = lastSnapshot.lock();
+        if (!current || lastSnapshotVersion != version)
+        {
+            current = std::make_shared<const User>(*this);
+            lastSnapshot = current;
+            lastSnapshotVersion = version;
+        }
+        return current;
+    }
+
+    const std::string &getId() const // Getter for id
+    {
+        return id;
+    }
+
+    const std::string &getUsername() const // Getter for username
+    {
+        return username;
+    }
+
+    const std::string &getPassword() const // Getter for password, typically not used
+    {
+        return password;
+    }
+
+    template <typename Visitor>
+    void forEachTransaction(Visitor visit) const // Call visit for every transaction, in the order they were added, leaving out removed slots
+    {
+        for (const auto &transaction : transactions)
+        {
+            if (transaction)
+            {
+                visit(transaction.get());
+            }
+        }
+    }
+
+    size_t getTransactionCount() const // Number of transactions, not counting removed slots or archived transactions
+    {
+        return slots.size();
+    }
+
+    size_t getArchivedTransactionCount() const // Number of transactions in archive segments
+    {
+        return archives->size();
+    }
+
+    // Look up a transaction by id, nullptr if there is none. Archived transactions are only found once their
+    // segment was decompressed, as it is by a search.
+    const Transaction *findTransaction(uint64_t transactionId) const
+    {
+        size_t slot;
+        if (slots.find(transactionId, slot))
+        {
+            return transactions[slot].get();
+        }
+        MonthlyRollups::Entry entry;
+        return archives->findEntry(transactionId, entry) ? entry.transaction : nullptr;
+    }
+
+    bool isUnarchived(uint64_t transactionId) const // Whether the user has the transaction and it was not archived
+    {
+        return slots.contains(transactionId);
+    }
+
+    std::vector<std::string> getCategoryNames() const // Names of the categories used by expenses and recurring expenses
+    {
+        std::vector<std::string> names = columns.getCategoryNames();
+        for (const auto &rule : *recurringRules)
+        {
+            if (rule.getType() == EXPENSE_TRANSACTION && std::find(names.begin(), names.end(), rule.getCategoryName()) == names.end())
+            {
+                names.push_back(rule.getCategoryName());
+            }
+        }
+        return names;
+    }
+
+    bool validatePassword(const std::string &inputPassword) const // Validate password
+    {
+        return password == inputPassword;
+    }
+
+    void changePassword(const std::string &newPassword) // Change password
+    {
+        ChangeGuard change(*this);
+        password = newPassword;                             // Change password
+        std::remove(("data/" + username + ".txt").c_str()); // Delete user file and save updated user data
+        saveUserData(*this);                                // Save updated user data
+        journalEntries = 0;
+    }
+
+    Money getBalance() const // Getter for balance, including archived transactions and the recurring transactions up to today
+    {
+        return balance + Money::fromMinorUnits(archives->net() + recurringTotal(INCOME_TRANSACTION, nullptr, INT32_MIN, INT32_MAX) -
+                                               recurringTotal(EXPENSE_TRANSACTION, nullptr, INT32_MIN, INT32_MAX));
+    }
+
+    Money getStoredBalance() const // Getter for the balance saved in the user file: archived transactions included, recurring transactions left out
+    {
+        return balance + Money::fromMinorUnits(archives->net());
+    }
+
+    bool recomputeRollups() // Recompute the monthly totals from the transactions. Returns false if the loaded totals were wrong
+    {
+        return rollups.write().verifyTotals();
+    }
+
+    std::vector<ArchiveSegment> getArchiveSegments() const // Getter for the archive segments in use, in year order
+    {
+        return archives->segments();
+    }
+
+    void setBalance(const Money &newBalance) // Setter for balance
+    {
+        ChangeGuard change(*this);
+        balance = newBalance;
+    }
+
+    void loadTransaction(Transaction *transaction) // Add a transaction read from the user file, without saving
+    {
+        appendTransaction(transaction);
+        MonthlyRollups::Entry entry = columns.entryAt(columns.size() - 1, transaction); // The amount in the home currency
+        if (entry.type == INCOME_TRANSACTION)
+        {
+            balance += Money::fromMinorUnits(entry.amount); // Add amount to balance
+        }
+        else if (entry.type == EXPENSE_TRANSACTION)
+        {
+            balance -= Money::fromMinorUnits(entry.amount); // Subtract amount from balance
+        }
+    }
+
+    // Add a block of transactions parsed from the user file, together with their columns and the change in balance
+    // they cause. Used by the parallel loader to merge the per-chunk results in file order.
+    // Transactions without an id (from files written before ids existed) or with an id that is already taken
+    // get a new one; call reserveTransactionIds with the largest id in the file first.
+    void loadTransactions(const std::vector<Transaction *> &chunkTransactions, const TransactionColumns &chunkColumns, const Money &chunkBalance)
+    {
+        size_t first = transactions.size();
+        columns.appendColumns(chunkColumns);
+        MonthlyRollups &monthly = rollups.write();
+        for (size_t i = first; i < first + chunkTransactions.size(); ++i)
+        {
+            Transaction *transaction = chunkTransactions[i - first];
+            if (transaction->getId() == 0 || slots.contains(transaction->getId()))
+            {
+                transaction->setId(nextTransactionId++);
+                idsAssigned = true;
+            }
+            slots.set(transaction->getId(), i);
+            transactions.push_back(std::shared_ptr<const Transaction>(transaction));
+            monthly.add(columns.entryAt(i, transaction), false); // Totals are set by finishLoading
+            if (categoryIndexBuilt)
+            {
+                categoryIndex.add(columns.entryAt(i, transaction), transaction->getId());
+            }
+            for (auto &budget : budgets.write())
+            {
+                budget.track(columns.entryAt(i, transaction), 1);
+            }
+            if (searchIndexBuilt)
+            {
+                searchIndex.add(transaction);
+            }
+            if (fingerprintsBuilt)
+            {
+                fingerprints.add(transaction);
+            }
+        }
+        balance += chunkBalance;
+    }
+
+    void reserveTransactionIds(uint64_t largestId) // Make sure new ids are larger than largestId
+    {
+        nextTransactionId = std::max(nextTransactionId, largestId + 1);
+    }
+
+    // Make sure new transactions, recurring rules and budgets get ids no smaller than those saved in the user file,
+    // so that the ids of removed ones, which the journal and exports may still name, are not given out again.
+    void reserveIds(uint64_t transactionId, uint64_t ruleId, uint64_t budgetId)
+    {
+        nextTransactionId = std::max(nextTransactionId, transactionId);
+        nextRuleId = std::max(nextRuleId, ruleId);
+        nextBudgetId = std::max(nextBudgetId, budgetId);
+    }
+
+    void writeNextIds(std::ostream &file) const // Write the ids the next transaction, recurring rule and budget get
+    {
+        file << "NextIds " << nextTransactionId << " " << nextRuleId << " " << nextBudgetId << "\n";
+    }
+
+    bool needsIdsSaved() const // True if loading gave ids to transactions, which the user file does not have yet
+    {
+        return idsAssigned;
+    }
+
+    // Called once all transactions are loaded. Takes over the monthly totals saved in the user file,
+    // or recomputes them if the file has none, they do not match the transactions or they depend on exchange rates.
+    // Returns false if the file has totals that do not match its transactions.
+    bool finishLoading(const std::vector<std::string> &savedRollups)
+    {
+        if (columns.hasConvertedAmounts()) // The exchange rates may have changed since the totals were saved
+        {
+            rollups.write().recomputeTotals();
+            return true;
+        }
+        bool adopted = rollups.write().adoptSaved(savedRollups, [this](const std::string &name)
+                                                  { return columns.internCategory(name); });
+        return adopted || savedRollups.empty(); // Files written before the totals were saved have none
+    }
+
+    void loadArchive(const ArchiveSegment &segment) // Add an archive segment named in the user file, without saving
+    {
+        archives.write().attach(segment, [this](const std::string &name)
+                                { return columns.internCategory(name); });
+        reserveTransactionIds(segment.largestId); // Ids of archived transactions are not given out again
+    }
+
+    void writeArchives(std::ostream &file) const // Write the archive segments in use to the user file
+    {
+        archives->write(file);
+    }
+
+    // This function seals the transactions dated in years before the year of horizon into archive segments, one per
+    // year, and rewrites the user file without them. A year that already has a segment gets a new generation of it
+    // holding both; the old generation is removed once the user file names the new one. Archived transactions can
+    // no longer be edited or removed, and budgets no longer count them. Returns the number of transactions archived.
+    size_t archiveBefore(const Date &horizon)
+    {
+        STAT_TIMER("archiveTransactions");
+        ChangeGuard change(*this);
+        std::map<int32_t, std::vector<const Transaction *>> byYear;
+        for (const auto &transaction : transactions)
+        {
+            if (transaction && transaction->getDate().getYear() < horizon.getYear())
+            {
+                byYear[transaction->getDate().getYear()].push_back(transaction.get());
+            }
+        }
+        if (byYear.empty())
+        {
+            return 0;
+        }
+        std::vector<ArchiveSegment> written;
+        std::vector<std::string> replaced;
+        size_t archived = 0;
+        try
+        {
+            for (const auto &year : byYear)
+            {
+                std::vector<const Transaction *> sealed = year.second;
+                uint64_t generation = 1;
+                std::shared_ptr<const ArchiveTier::Detail> previous; // Keeps the archived transactions alive while they are rewritten
+                if (const ArchiveSegment *segment = archives->find(year.first))
+                {
+                    generation = segment->generation + 1;
+                    replaced.push_back(segment->path);
+                    previous = archives->readDetail(year.first);
+                    for (const auto &transaction : previous->transactions)
+                    {
+                        sealed.push_back(transaction.get());
+                    }
+                }
+                written.push_back(ArchiveSegment::write(username, year.first, generation, sealed));
+                archived += year.second.size();
+            }
+        }
+        catch (...)
+        {
+            for (const auto &segment : written) // Nothing names them yet
+            {
+                std::remove(segment.path.c_str());
+            }
+            throw;
+        }
+        for (const auto &year : byYear)
+        {
+            for (const Transaction *transaction : year.second)
+            {
+                detachTransaction(transaction->getId());
+            }
+        }
+        for (const auto &segment : written)
+        {
+            loadArchive(segment);
+        }
+        searchIndex.clear(); // Rebuilt by the next search, with the archived transactions
+        searchIndexBuilt = false;
+        compactIfNeeded();
+        saveUserData(*this);
+        journalEntries = 0;
+        for (const auto &path : replaced)
+        {
+            std::remove(path.c_str());
+        }
+        return archived;
+    }
+
+    const std::vector<RecurringRule> &getRecurringRules() const // Getter for recurring rules
+    {
+        return *recurringRules;
+    }
+
+    void loadRecurringRule(const RecurringRule &rule) // Add a recurring rule read from the user file, without saving
+    {
+        recurringRules.write().push_back(rule);
+        nextRuleId = std::max(nextRuleId, rule.getId() + 1);
+        occurrencesDay = INT32_MIN;
+    }
+
+    uint64_t addRecurringRule(RecurringRule rule) // Add a recurring rule and save it. Returns the id of the rule
+    {
+        ChangeGuard change(*this);
+        uint64_t ruleId = nextRuleId++;
+        rule.setId(ruleId);
+        recurringRules.write().push_back(rule);
+        occurrencesDay = INT32_MIN;
+        saveUserData(*this); // Rules change rarely, so they are not journaled
+        journalEntries = 0;
+        return ruleId;
+    }
+
+    bool removeRecurringRule(uint64_t ruleId) // Remove a recurring rule and save. Returns false if there is none with this id
+    {
+        ChangeGuard change(*this);
+        std::vector<RecurringRule> &rules = recurringRules.write();
+        for (auto it = rules.begin(); it != rules.end(); ++it)
+        {
+            if (it->getId() == ruleId)
+            {
+                rules.erase(it);
+                occurrencesDay = INT32_MIN;
+                saveUserData(*this);
+                journalEntries = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Generates the occurrences of the recurring rules up to today in one batch, as read-only transactions without
+    // an id, so that listing, search, queries and duplicate checks see them like stored transactions. They are never
+    // saved, and cannot be edited or removed one by one. Called at login and before anything that reads them; does
+    // nothing if they were already generated today and the rules did not change since.
+    void generateOccurrences()
+    {
+        STAT_TIMER("generateOccurrences");
+        int32_t today = Date::today().toOrdinal();
+        if (occurrencesDay == today)
+        {
+            return;
+        }
+        std::vector<std::shared_ptr<const Transaction>> generated;
+        for (const auto &rule : *recurringRules)
+        {
+            rule.forEachOccurrence(INT32_MIN, today, [&](int32_t day)
+                                   { generated.push_back(std::shared_ptr<const Transaction>(rule.makeOccurrence(day))); });
+        }
+        std::stable_sort(generated.begin(), generated.end(), [](const std::shared_ptr<const Transaction> &a, const std::shared_ptr<const Transaction> &b)
+                         { return a->getDate() < b->getDate(); });
+        std::lock_guard<std::mutex> lock(stateMutex); // Not a change of the user: the totals count the occurrences already
+        occurrences.write().swap(generated);
+        occurrencesDay = today;
+    }
+
+    template <typename Visitor>
+    void forEachRecurringOccurrence(Visitor visit) const // Call visit for every generated occurrence of the recurring rules, in date order
+    {
+        forEachOccurrenceBetween(INT32_MIN, INT32_MAX, visit);
+    }
+
+    const std::vector<Budget> &getBudgets() const // Getter for budgets
+    {
+        return *budgets;
+    }
+
+    void loadBudget(Budget budget) // Add a budget read from the user file, without saving, and count what it has spent
+    {
+        budget.setCategoryId(budget.getCategoryName().empty() ? 0 : columns.internCategory(budget.getCategoryName()));
+        for (size_t slot = 0; slot < transactions.size(); ++slot)
+        {
+            if (transactions[slot])
+            {
+                budget.track(columns.entryAt(slot, transactions[slot].get()), 1);
+            }
+        }
+        budgets.write().push_back(budget);
+        nextBudgetId = std::max(nextBudgetId, budget.getId() + 1);
+    }
+
+    uint64_t addBudget(const Budget &budget) // Add a budget and save it. Returns the id of the budget
+    {
+        ChangeGuard change(*this);
+        uint64_t budgetId = nextBudgetId++;
+        loadBudget(budget);
+        budgets.write().back().setId(budgetId);
+        saveUserData(*this); // Budgets change rarely, so they are not journaled
+        journalEntries = 0;
+        return budgetId;
+    }
+
+    bool removeBudget(uint64_t budgetId) // Remove a budget and save. Returns false if there is none with this id
+    {
+        ChangeGuard change(*this);
+        std::vector<Budget> &all = budgets.write();
+        for (auto it = all.begin(); it != all.end(); ++it)
+        {
+            if (it->getId() == budgetId)
+            {
+                all.erase(it);
+                saveUserData(*this);
+                journalEntries = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int64_t budgetSpent(const Budget &budget, int64_t bucket) const // Expenses a budget counts in a period, including recurring ones up to today
+    {
+        int64_t total = budget.spentIn(bucket);
+        int32_t firstDay = intervalStart(bucket, budget.getPeriod()).toOrdinal();
+        int32_t lastDay = std::min(intervalStart(bucket + 1, budget.getPeriod()).toOrdinal() - 1, Date::today().toOrdinal());
+        for (const auto &rule : *recurringRules)
+        {
+            if (rule.getType() == EXPENSE_TRANSACTION && (budget.getCategoryName().empty() || rule.getCategoryName() == budget.getCategoryName()))
+            {
+                total += rule.totalBetween(firstDay, lastDay);
+            }
+        }
+        return total;
+    }
+
+    std::vector<std::string> takeBudgetAlerts() // Return the budget alerts raised since the last call and forget them
+    {
+        std::vector<std::string> alerts;
+        alerts.swap(budgetAlerts);
+        return alerts;
+    }
+
+    void writeRollups(std::ostream &file) const // Write the monthly totals to the user file
+    {
+        rollups->write(file, columns.allCategoryNames());
+    }
+
+    void addTransaction(Transaction *transaction) // Add new transaction to transactions vector
+    {
+        STAT_TIMER("addTransaction");
+        ChangeGuard change(*this);
+        std::vector<int> levels = budgetLevels(transaction->getDate());
+        loadTransaction(transaction);
+        raiseBudgetAlerts(transaction->getDate(), levels);
+        std::ostringstream entry;
+        writeTransactionRecord(entry, transaction);
+        journal(entry.str(), 1); // Save updated user data
+    }
+
+    // Add several new transactions, with a single write to the journal. Used by imports.
+    void addTransactions(const std::vector<Transaction *> &newTransactions)
+    {
+        STAT_TIMER("addTransactions");
+        ChangeGuard change(*this);
+        std::string entries;
+        for (Transaction *transaction : newTransactions)
+        {
+            std::vector<int> levels = budgetLevels(transaction->getDate());
+            loadTransaction(transaction);
+            raiseBudgetAlerts(transaction->getDate(), levels);
+            std::ostringstream entry;
+            writeTransactionRecord(entry, transaction);
+            entries += entry.str();
+        }
+        if (!newTransactions.empty())
+        {
+            journal(entries, newTransactions.size());
+        }
+    }
+
+    // Find the transactions that are duplicates of transaction (see fingerprintTransaction), leaving out transaction
+    // itself, in the order they were added; archived transactions and occurrences of recurring transactions of its
+    // date come first. transaction does not have to belong to the user. The fingerprint index is built on the first
+    // call and kept up to date afterwards.
+    std::vector<const Transaction *> findDuplicates(const Transaction *transaction)
+    {
+        STAT_TIMER("findDuplicates");
+        if (!fingerprintsBuilt)
+        {
+            for (const auto &existing : transactions)
+            {
+                if (existing)
+                {
+                    fingerprints.add(existing.get());
+                }
+            }
+            fingerprintsBuilt = true;
+        }
+        std::vector<const Transaction *> found;
+        int32_t date = transaction->getDate().toOrdinal();
+        archives->forEachEntry(date, date, [&](const MonthlyRollups::Entry &entry) // Only decompresses the segment of that year
+                               {
+                                   if (sameTransaction(entry.transaction, transaction))
+                                   {
+                                       found.push_back(entry.transaction);
+                                   }
+                               });
+        generateOccurrences();
+        forEachOccurrenceBetween(date, date, [&](const Transaction *occurrence)
+                                 {
+                                     if (occurrence != transaction && sameTransaction(occurrence, transaction))
+                                     {
+                                         found.push_back(occurrence);
+                                     }
+                                 });
+        std::vector<uint64_t> ids = fingerprints.find(transaction);
+        std::sort(ids.begin(), ids.end());
+        for (uint64_t transactionId : ids)
+        {
+            size_t slot;
+            if (!slots.find(transactionId, slot))
+            {
+                continue;
+            }
+            const Transaction *existing = transactions[slot].get();
+            if (existing != transaction && sameTransaction(existing, transaction))
+            {
+                found.push_back(existing);
+            }
+        }
+        return found;
+    }
+
+    // Find every group of transactions that are duplicates of each other, in a single pass over all transactions,
+    // the archived ones and the occurrences of recurring transactions up to today included. Each group lists the
+    // transaction that is kept by removeDuplicates first: an archived one or an occurrence if there is one, otherwise
+    // the one added first.
+    std::vector<std::vector<const Transaction *>> findDuplicateGroups()
+    {
+        STAT_TIMER("findDuplicateGroups");
+        std::vector<std::vector<const Transaction *>> groups;
+        std::unordered_map<uint64_t, std::vector<size_t>> groupsByFingerprint; // Groups of each fingerprint, by position in groups
+        auto visit = [&](const Transaction *transaction)
+        {
+            std::vector<size_t> &candidates = groupsByFingerprint[fingerprintTransaction(transaction)];
+            for (size_t group : candidates)
+            {
+                if (sameTransaction(groups[group].front(), transaction))
+                {
+                    groups[group].push_back(transaction);
+                    return;
+                }
+            }
+            candidates.push_back(groups.size());
+            groups.push_back(std::vector<const Transaction *>(1, transaction));
+        };
+        archives->forEachEntry(INT32_MIN, INT32_MAX, [&](const MonthlyRollups::Entry &entry)
+                               { visit(entry.transaction); });
+        generateOccurrences();
+        forEachRecurringOccurrence(visit);
+        STAT_ADD(STAT_TRANSACTIONS_SCANNED, transactions.size());
+        std::vector<const Transaction *> ordered; // Hot transactions in the order they were added
+        for (const auto &transaction : transactions)
+        {
+            if (transaction)
+            {
+                ordered.push_back(transaction.get());
+            }
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const Transaction *a, const Transaction *b)
+                  { return a->getId() < b->getId(); });
+        for (const Transaction *transaction : ordered)
+        {
+            visit(transaction);
+        }
+        groups.erase(std::remove_if(groups.begin(), groups.end(), [](const std::vector<const Transaction *> &group)
+                                    { return group.size() < 2; }),
+                     groups.end());
+        return groups;
+    }
+
+    // Remove all but the first transaction of every group found by findDuplicateGroups, with a single write to the
+    // journal. Archived transactions and occurrences of recurring transactions are never removed. Returns the number of transactions removed.
+    size_t removeDuplicates()
+    {
+        std::vector<uint64_t> duplicateIds;
+        for (const auto &group : findDuplicateGroups())
+        {
+            for (size_t i = 1; i < group.size(); ++i)
+            {
+                if (isUnarchived(group[i]->getId()))
+                {
+                    duplicateIds.push_back(group[i]->getId());
+                }
+            }
+        }
+        return removeTransactions(duplicateIds);
+    }
+
+    bool removeTransaction(uint64_t transactionId) // Remove the transaction with the given id. Returns false if there is none
+    {
+        return removeTransactions(std::vector<uint64_t>(1, transactionId)) == 1;
+    }
+
+    // Remove the transactions with the given ids, with a single write to the journal. Ids that do not exist are
+    // ignored. Returns the number of transactions removed.
+    size_t removeTransactions(const std::vector<uint64_t> &transactionIds)
+    {
+        STAT_TIMER("removeTransactions");
+        ChangeGuard change(*this);
+        std::string entries;
+        size_t removed = 0;
+        for (uint64_t transactionId : transactionIds)
+        {
+            if (detachTransaction(transactionId))
+            {
+                entries += "Remove " + std::to_string(transactionId) + "\n";
+                ++removed;
+            }
+        }
+        if (removed > 0)
+        {
+            compactIfNeeded();
+            journal(entries, removed); // Save updated user data
+        }
+        return removed;
+    }
+
+    // Apply a change read back from the journal. Adding a transaction whose id is already present or removing one
+    // that is already gone does nothing, so a journal that was already folded into the user file can be replayed.
+    void replayAdd(Transaction *transaction)
+    {
+        if (transaction->getId() == 0 || slots.contains(transaction->getId()))
+        {
+            delete transaction;
+            return;
+        }
+        loadTransaction(transaction);
+        ++journalEntries;
+    }
+
+    void replayRemove(uint64_t transactionId)
+    {
+        detachTransaction(transactionId);
+        compactIfNeeded();
+        ++journalEntries;
+    }
+
+    // Edit the transaction with the given id in place. The balance, the columns and the monthly totals are adjusted
+    // by the difference, and only the edited record is appended to the journal. categoryName is ignored for income.
+    // Returns false if there is no transaction with this id.
+    bool editTransaction(uint64_t transactionId, const Money &amount, const std::string &description, const Date &date, const std::string &categoryName)
+    {
+        STAT_TIMER("editTransaction");
+        ChangeGuard change(*this);
+        std::vector<int> levels = budgetLevels(date);
+        const Transaction *transaction = updateTransaction(transactionId, amount, description, date, categoryName);
+        if (!transaction)
+        {
+            return false;
+        }
+        raiseBudgetAlerts(date, levels);
+        std::ostringstream entry;
+        entry << "Edit " << transactionId << "\n";
+        writeTransactionRecord(entry, transaction);
+        journal(entry.str(), 1); // Save the edit
+        return true;
+    }
+
+    void replayEdit(const Transaction *edited) // Apply an edit read back from the journal; edited carries the new values
+    {
+        const Expense *expenseTransaction = dynamic_cast<const Expense *>(edited);
+        updateTransaction(edited->getId(), edited->getAmount(), edited->getDescription(), edited->getDate(),
+                          expenseTransaction ? expenseTransaction->getCategory().getName() : std::string());
+        ++journalEntries;
+    }
+
+    // Find the transactions whose description or category has a word starting with each word of the query,
+    // in the order they were added, then the occurrences of recurring transactions up to today that match, in date
+    // order. The index is built on the first search and kept up to date afterwards.
+    std::vector<const Transaction *> searchTransactions(const std::string &query)
+    {
+        STAT_TIMER("searchTransactions");
+        std::vector<const Transaction *> found;
+        for (uint64_t transactionId : searchIds(query))
+        {
+            found.push_back(findTransaction(transactionId));
+        }
+        generateOccurrences();
+        forEachRecurringOccurrence([&](const Transaction *occurrence)
+                                   {
+                                       if (SearchIndex::matches(occurrence, query))
+                                       {
+                                           found.push_back(occurrence);
+                                       }
+                                   });
+        return found;
+    }
+
+private:
+    std::vector<uint64_t> searchIds(const std::string &query) // Sorted ids of the stored and archived transactions a search finds
+    {
+        if (!searchIndexBuilt)
+        {
+            for (const auto &transaction : transactions)
+            {
+                if (transaction)
+                {
+                    searchIndex.add(transaction.get());
+                }
+            }
+            archives->forEachEntry(INT32_MIN, INT32_MAX, [this](const MonthlyRollups::Entry &entry)
+                                   { searchIndex.add(entry.transaction); });
+            searchIndexBuilt = true;
+        }
+        return searchIndex.search(query);
+    }
+
+public:
+
+    // This function answers a query. The candidates come from whichever index yields the fewest of them: the
+    // months of the date range, the expenses of the categories, or the matches of the search words. Only if no
+    // condition narrows the query down are all transactions scanned. Every candidate is then checked against
+    // all conditions, as is every occurrence of a recurring transaction up to today, so that the totals agree with
+    // those of the reports.
+    QueryResult query(const TransactionQuery &query)
+    {
+        STAT_TIMER("query");
+        QueryResult result;
+        int32_t firstDay = query.hasDateRange ? query.startDate.toOrdinal() : INT32_MIN;
+        int32_t lastDay = query.hasDateRange ? query.endDate.toOrdinal() : INT32_MAX;
+        std::vector<uint32_t> categoryIds;
+        for (const auto &name : query.categories)
+        {
+            uint32_t categoryId;
+            if (columns.findCategory(name, categoryId))
+            {
+                categoryIds.push_back(categoryId);
+            }
+        }
+        std::sort(categoryIds.begin(), categoryIds.end());
+        categoryIds.erase(std::unique(categoryIds.begin(), categoryIds.end()), categoryIds.end());
+        std::vector<uint64_t> textIds;
+        if (!query.text.empty())
+        {
+            textIds = searchIds(query.text);
+        }
+        if ((!query.income && !query.expenses) || lastDay < firstDay || (query.hasAmountRange && query.maxAmount < query.minAmount))
+        {
+            return result; // Nothing can match
+        }
+
+        // The occurrences of recurring transactions up to today are checked one by one; they are in no index
+        std::vector<const Transaction *> occurrenceMatches;
+        generateOccurrences();
+        forEachOccurrenceBetween(firstDay, lastDay, [&](const Transaction *occurrence)
+                                 {
+                                     const Expense *expenseOccurrence = dynamic_cast<const Expense *>(occurrence);
+                                     if (!(expenseOccurrence ? query.expenses : query.income) ||
+                                         (!query.categories.empty() && (!expenseOccurrence ||
+                                                                         std::find(query.categories.begin(), query.categories.end(), expenseOccurrence->getCategory().getName()) == query.categories.end())) ||
+                                         (query.hasAmountRange && (occurrence->getAmount() < query.minAmount || occurrence->getAmount() > query.maxAmount)) ||
+                                         (!query.text.empty() && !SearchIndex::matches(occurrence, query.text)))
+                                     {
+                                         return;
+                                     }
+                                     ++result.count;
+                                     (expenseOccurrence ? result.expenses : result.income) += occurrence->getAmount();
+                                     if (query.listTransactions)
+                                     {
+                                         occurrenceMatches.push_back(occurrence);
+                                     }
+                                 });
+        if ((!query.categories.empty() && categoryIds.empty()) || (!query.text.empty() && textIds.empty()))
+        {
+            result.transactions = occurrenceMatches;
+            return result; // No stored transaction can match
+        }
+
+        auto visit = [&](const MonthlyRollups::Entry &entry)
+        {
+            if (!(entry.type == INCOME_TRANSACTION ? query.income : entry.type == EXPENSE_TRANSACTION && query.expenses) ||
+                entry.date < firstDay || entry.date > lastDay ||
+                (!categoryIds.empty() && (entry.type != EXPENSE_TRANSACTION || !std::binary_search(categoryIds.begin(), categoryIds.end(), entry.category))) ||
+                (query.hasAmountRange && (entry.amount < query.minAmount.getMinorUnits() || entry.amount > query.maxAmount.getMinorUnits())) ||
+                (!query.text.empty() && !std::binary_search(textIds.begin(), textIds.end(), entry.transaction->getId())))
+            {
+                return;
+            }
+            ++result.count;
+            if (entry.type == INCOME_TRANSACTION)
+                result.income += Money::fromMinorUnits(entry.amount);
+            else
+                result.expenses += Money::fromMinorUnits(entry.amount);
+            if (query.listTransactions)
+            {
+                result.transactions.push_back(entry.transaction);
+            }
+        };
+        auto visitIds = [&](const std::vector<uint64_t> &ids)
+        {
+            STAT_ADD(STAT_TRANSACTIONS_SCANNED, ids.size());
+            for (uint64_t transactionId : ids)
+            {
+                size_t slot;
+                MonthlyRollups::Entry entry;
+                if (slots.find(transactionId, slot))
+                {
+                    visit(columns.entryAt(slot, transactions[slot].get()));
+                }
+                else if (archives->findEntry(transactionId, entry)) // Search words also match archived transactions
+                {
+                    visit(entry);
+                }
+            }
+        };
+
+        if (!categoryIds.empty() && !categoryIndexBuilt)
+        {
+            for (size_t slot = 0; slot < transactions.size(); ++slot)
+            {
+                if (transactions[slot])
+                {
+                    categoryIndex.add(columns.entryAt(slot, transactions[slot].get()), transactions[slot]->getId());
+                }
+            }
+            categoryIndexBuilt = true;
+        }
+
+        // Pick the smallest set of candidates
+        size_t categoryCandidates = 0;
+        for (uint32_t categoryId : categoryIds)
+        {
+            categoryCandidates += categoryIndex.find(categoryId).size();
+        }
+        size_t dateCandidates = query.hasDateRange ? rollups->countEntries(firstDay, lastDay) : slots.size();
+        size_t textCandidates = query.text.empty() ? slots.size() : textIds.size();
+        bool archivedVisited = false;
+        if (!categoryIds.empty() && categoryCandidates <= dateCandidates && categoryCandidates <= textCandidates)
+        {
+            for (uint32_t categoryId : categoryIds)
+            {
+                visitIds(categoryIndex.find(categoryId));
+            }
+        }
+        else if (!query.text.empty() && textCandidates <= dateCandidates)
+        {
+            visitIds(textIds); // The ids of the search words include archived transactions
+            archivedVisited = true;
+        }
+        else if (query.hasDateRange)
+        {
+            rollups->forEachEntry(firstDay, lastDay, visit);
+        }
+        else
+        {
+            STAT_ADD(STAT_TRANSACTIONS_SCANNED, transactions.size());
+            for (size_t slot = 0; slot < transactions.size(); ++slot)
+            {
+                if (transactions[slot])
+                {
+                    visit(columns.entryAt(slot, transactions[slot].get()));
+                }
+            }
+        }
+        if (!archivedVisited) // The indexes only cover the transactions that are not archived
+        {
+            archives->forEachEntry(firstDay, lastDay, visit);
+        }
+
+        std::sort(result.transactions.begin(), result.transactions.end(), [](const Transaction *a, const Transaction *b)
+                  { return a->getId() < b->getId(); });
+        result.transactions.insert(result.transactions.end(), occurrenceMatches.begin(), occurrenceMatches.end());
+        return result;
+    }
+
+    Money calculateOverallBalance() const // Calculate overall balance
+    {
+        return getBalance();
+    }
+
+    Money calculateIncomeForPeriod(const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const // Calculate income for a period
+    {
+        STAT_TIMER("calculateIncomeForPeriod");
+        if (currency != BASE_CURRENCY)
+        {
+            int64_t income, expenses;
+            convertedTotals(currency, startDate.toOrdinal(), endDate.toOrdinal(), nullptr, income, expenses);
+            return Money::fromMinorUnits(income);
+        }
+        return Money::fromMinorUnits(rollups->sumForPeriod(INCOME_TRANSACTION, startDate, endDate) +
+                                     archives->sum(INCOME_TRANSACTION, true, 0, startDate.toOrdinal(), endDate.toOrdinal()) +
+                                     recurringTotal(INCOME_TRANSACTION, nullptr, startDate.toOrdinal(), endDate.toOrdinal()));
+    }
+
+    Money calculateExpensesForPeriod(const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const // Calculate expenses for a period
+    {
+        STAT_TIMER("calculateExpensesForPeriod");
+        if (currency != BASE_CURRENCY)
+        {
+            int64_t income, expenses;
+            convertedTotals(currency, startDate.toOrdinal(), endDate.toOrdinal(), nullptr, income, expenses);
+            return Money::fromMinorUnits(expenses);
+        }
+        return Money::fromMinorUnits(rollups->sumForPeriod(EXPENSE_TRANSACTION, startDate, endDate) +
+                                     archives->sum(EXPENSE_TRANSACTION, true, 0, startDate.toOrdinal(), endDate.toOrdinal()) +
+                                     recurringTotal(EXPENSE_TRANSACTION, nullptr, startDate.toOrdinal(), endDate.toOrdinal()));
+    }
+
+    Money calculateNetSavingsForPeriod(const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const // Calculate net savings for a period
+    {
+        Money income, expenses;
+        calculateTotalsForPeriod(startDate, endDate, currency, income, expenses);
+        return income - expenses;
+    }
+
+    // Calculate income and expenses for a period together; in another currency than the home currency this
+    // takes a single pass over the period instead of one per total.
+    void calculateTotalsForPeriod(const Date &startDate, const Date &endDate, const Currency &currency, Money &income, Money &expenses) const
+    {
+        STAT_TIMER("calculateTotalsForPeriod");
+        if (currency == BASE_CURRENCY)
+        {
+            income = calculateIncomeForPeriod(startDate, endDate);
+            expenses = calculateExpensesForPeriod(startDate, endDate);
+            return;
+        }
+        int64_t incomeUnits, expenseUnits;
+        convertedTotals(currency, startDate.toOrdinal(), endDate.toOrdinal(), nullptr, incomeUnits, expenseUnits);
+        income = Money::fromMinorUnits(incomeUnits);
+        expenses = Money::fromMinorUnits(expenseUnits);
+    }
+
+    Money calculateExpensesByCategory(const std::string &categoryName, const Currency &currency = BASE_CURRENCY) const // Calculate expenses by category
+    {
+        STAT_TIMER("calculateExpensesByCategory");
+        if (currency != BASE_CURRENCY)
+        {
+            int64_t income, expenses;
+            convertedTotals(currency, INT32_MIN, INT32_MAX, &categoryName, income, expenses);
+            return Money::fromMinorUnits(expenses);
+        }
+        int64_t total = recurringTotal(EXPENSE_TRANSACTION, &categoryName, INT32_MIN, INT32_MAX);
+        uint32_t categoryId;
+        if (columns.findCategory(categoryName, categoryId)) // Otherwise no expense was ever recorded in this category
+        {
+            total += rollups->sumForCategory(categoryId) + archives->sumForCategory(categoryId);
+        }
+        return Money::fromMinorUnits(total);
+    }
+
+    Money calculateExpensesByCategoryForPeriod(const std::string &categoryName, const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const // Calculate expenses by category for a period
+    {
+        STAT_TIMER("calculateExpensesByCategoryForPeriod");
+        if (currency != BASE_CURRENCY)
+        {
+            int64_t income, expenses;
+            convertedTotals(currency, startDate.toOrdinal(), endDate.toOrdinal(), &categoryName, income, expenses);
+            return Money::fromMinorUnits(expenses);
+        }
+        int64_t total = recurringTotal(EXPENSE_TRANSACTION, &categoryName, startDate.toOrdinal(), endDate.toOrdinal());
+        uint32_t categoryId;
+        if (columns.findCategory(categoryName, categoryId))
+        {
+            total += rollups->sumForCategoryPeriod(categoryId, startDate, endDate) +
+                     archives->sum(EXPENSE_TRANSACTION, false, categoryId, startDate.toOrdinal(), endDate.toOrdinal());
+        }
+        return Money::fromMinorUnits(total);
+    }
+
+    // This struct is one interval of a time series report.
+    struct TimeSeriesPoint
+    {
+        Date periodStart;
+        Money income;
+        Money expenses;
+        Money net;
+        Money balance;         // Balance at the end of the interval
+        Money averageIncome;   // Rolling average over the last window intervals
+        Money averageExpenses; // Rolling average over the last window intervals
+    };
+
+    // This struct is one line of a forecast report: income, or the expenses of a category.
+    struct ForecastLine
+    {
+        std::string name;
+        Money average;   // Average month of the history
+        Money trend;     // Change of the trend line from one month to the next
+        Money projected; // Expected along the trend line until the end of the forecast
+        Money recurring; // Occurrences of recurring transactions until the end of the forecast
+    };
+
+    // This struct is a transaction, or an occurrence of a recurring transaction, as a LedgerCursor returns it.
+    struct LedgerEntry
+    {
+        int32_t date;
+        uint8_t type;
+        int64_t amount;                  // In the currency of the cursor
+        const std::string *categoryName; // nullptr for income
+    };
+
+    // This class walks the transactions of a user dated in a period in date order, archived ones and occurrences of
+    // recurring transactions up to today included, with every amount in one currency. It loads one month at a time,
+    // so that it holds at most a month of entries; the reports of a group walk their members with it one at a time.
+    // The user must not change while a cursor is open.
+    class LedgerCursor
+    {
+    private:
+        const User *user;
+        Currency currency;
+        int32_t nextDay; // First day not loaded yet
+        int32_t lastDay;
+        std::vector<LedgerEntry> entries; // The month loaded, in date order
+        size_t position;
+
+        void loadMonth() // Load the next month that has entries, if there is one
+        {
+            entries.clear();
+            position = 0;
+            int32_t today = Date::today().toOrdinal();
+            const std::vector<std::string> &categoryNames = user->columns.allCategoryNames();
+            auto addEntry = [&](const MonthlyRollups::Entry &entry)
+            {
+                LedgerEntry ledgerEntry;
+                ledgerEntry.date = entry.date;
+                ledgerEntry.type = entry.type;
+                ledgerEntry.amount = currency == BASE_CURRENCY ? entry.amount
+                                                               : exchangeRates.convert(entry.transaction->getAmount().getMinorUnits(), entry.transaction->getCurrency(), currency, entry.date);
+                ledgerEntry.categoryName = entry.type == EXPENSE_TRANSACTION ? &categoryNames[entry.category] : nullptr;
+                entries.push_back(ledgerEntry);
+            };
+            while (entries.empty() && nextDay <= lastDay)
+            {
+                int32_t monthEnd = std::min(lastDay, Date::daysFromCivil(Date::yearFromDays(nextDay), Date::monthFromDays(nextDay),
+                                                                         Date::daysInMonth(Date::monthFromDays(nextDay), Date::yearFromDays(nextDay))));
+                user->rollups->forEachEntry(nextDay, monthEnd, addEntry);
+                user->archives->forEachEntry(nextDay, monthEnd, addEntry);
+                for (const auto &rule : *user->recurringRules)
+                {
+                    rule.forEachOccurrence(nextDay, std::min(monthEnd, today), [&](int32_t day)
+                                           {
+                                               LedgerEntry ledgerEntry;
+                                               ledgerEntry.date = day;
+                                               ledgerEntry.type = rule.getType();
+                                               ledgerEntry.amount = exchangeRates.convert(rule.getAmount().getMinorUnits(), BASE_CURRENCY, currency, day);
+                                               ledgerEntry.categoryName = rule.getType() == EXPENSE_TRANSACTION ? &rule.getCategoryName() : nullptr;
+                                               entries.push_back(ledgerEntry);
+                                           });
+                }
+                nextDay = monthEnd + 1;
+            }
+            std::stable_sort(entries.begin(), entries.end(), [](const LedgerEntry &a, const LedgerEntry &b)
+                             { return a.date < b.date; });
+        }
+
+    public:
+        LedgerCursor(const User &user, const Date &startDate, const Date &endDate, const Currency &currency)
+            : user(&user), currency(currency), nextDay(startDate.toOrdinal()), lastDay(endDate.toOrdinal()), position(0)
+        {
+            // Skip the months before the first and after the last entry of the user
+            int32_t firstDataDay = INT32_MAX, lastDataDay = INT32_MIN, first, last;
+            if (user.rollups->span(first, last))
+            {
+                firstDataDay = std::min(firstDataDay, first);
+                lastDataDay = std::max(lastDataDay, last);
+            }
+            if (user.archives->span(first, last))
+            {
+                firstDataDay = std::min(firstDataDay, first);
+                lastDataDay = std::max(lastDataDay, last);
+            }
+            for (const auto &rule : *user.recurringRules)
+            {
+                firstDataDay = std::min(firstDataDay, rule.getStartDate().toOrdinal());
+                lastDataDay = std::max(lastDataDay, Date::today().toOrdinal());
+            }
+            nextDay = std::max(nextDay, std::max(firstDataDay, Date(1, 1, 0).toOrdinal()));
+            lastDay = std::min(lastDay, std::min(lastDataDay, Date(31, 12, 9999).toOrdinal()));
+            loadMonth();
+        }
+
+        bool done() const // Whether every entry was returned
+        {
+            return position == entries.size();
+        }
+
+        const LedgerEntry &entry() const // The next entry
+        {
+            return entries[position];
+        }
+
+        void next() // Move on to the entry after the next one
+        {
+            if (++position == entries.size())
+            {
+                loadMonth();
+            }
+        }
+    };
+
+private:
+    // This class keeps the results of the reports, by report and parameters, so that showing a report, saving it
+    // and exporting it compute it only once. Results hold for one version of the user and one day, since recurring
+    // transactions count up to today; the first lookup after either changed drops them all. Reports may run on a
+    // snapshot on another thread, so lookups take a mutex.
+    class ReportCache
+    {
+    private:
+        mutable std::mutex mutex;
+        uint64_t version;                                          // Version of the user the results hold for
+        int32_t day;                                               // Day the results hold for
+        std::map<std::string, std::pair<Money, Money>> totals;     // Income and expenses, by report and parameters
+        std::map<std::string, std::vector<TimeSeriesPoint>> series; // Time series, by parameters
+
+        void expire(uint64_t currentVersion) // Drop the results if the user or the day changed; call with mutex held
+        {
+            int32_t today = Date::today().toOrdinal();
+            if (version != currentVersion || day != today)
+            {
+                totals.clear();
+                series.clear();
+                version = currentVersion;
+                day = today;
+            }
+        }
+
+    public:
+        ReportCache() : version(0), day(0) {}
+
+        // Take over the results of other that hold for otherVersion, as holding for currentVersion. Used by copies
+        // of a user, so that a snapshot reuses what was computed on the user it was copied from.
+        void adopt(const ReportCache &other, uint64_t otherVersion, uint64_t currentVersion)
+        {
+            std::lock(mutex, other.mutex);
+            std::lock_guard<std::mutex> lock(mutex, std::adopt_lock);
+            std::lock_guard<std::mutex> otherLock(other.mutex, std::adopt_lock);
+            totals.clear();
+            series.clear();
+            if (other.version == otherVersion && other.day == Date::today().toOrdinal())
+            {
+                totals = other.totals;
+                series = other.series;
+            }
+            version = currentVersion;
+            day = other.day;
+        }
+
+        bool findTotals(uint64_t currentVersion, const std::string &key, Money &income, Money &expenses)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expire(currentVersion);
+            auto it = totals.find(key);
+            if (it == totals.end())
+            {
+                STAT_ADD(STAT_REPORT_CACHE_MISSES, 1);
+                return false;
+            }
+            STAT_ADD(STAT_REPORT_CACHE_HITS, 1);
+            income = it->second.first;
+            expenses = it->second.second;
+            return true;
+        }
+
+        void storeTotals(uint64_t currentVersion, const std::string &key, const Money &income, const Money &expenses)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expire(currentVersion);
+            totals[key] = std::make_pair(income, expenses);
+        }
+
+        bool findSeries(uint64_t currentVersion, const std::string &key, std::vector<TimeSeriesPoint> &points)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expire(currentVersion);
+            auto it = series.find(key);
+            if (it == series.end())
+            {
+                STAT_ADD(STAT_REPORT_CACHE_MISSES, 1);
+                return false;
+            }
+            STAT_ADD(STAT_REPORT_CACHE_HITS, 1);
+            points = it->second;
+            return true;
+        }
+
+        void storeSeries(uint64_t currentVersion, const std::string &key, const std::vector<TimeSeriesPoint> &points)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expire(currentVersion);
+            series[key] = points;
+        }
+
+        void clear() // Drop all results
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            totals.clear();
+            series.clear();
+        }
+    };
+
+    mutable ReportCache reportCache; // Results of the reports at the current version
+
+    static std::string reportPeriodKey(const Date &startDate, const Date &endDate, const Currency &currency) // The parameters most reports share, as part of a cache key
+    {
+        return std::to_string(startDate.toOrdinal()) + " " + std::to_string(endDate.toOrdinal()) + " " + currency.toString();
+    }
+
+public:
+    void clearReportCache() const // Drop the cached report results, so that the next reports are computed again
+    {
+        reportCache.clear();
+    }
+
+    // Report results. These compute what a report shows, or take it from the report cache if the same report was
+    // computed at the current version of the user; the functions that print and save the reports use them.
+
+    void summaryReportTotals(const Date &startDate, const Date &endDate, const Currency &currency, Money &income, Money &expenses) const
+    {
+        std::string key = "summary " + reportPeriodKey(startDate, endDate, currency);
+        if (!reportCache.findTotals(version, key, income, expenses))
+        {
+            calculateTotalsForPeriod(startDate, endDate, currency, income, expenses);
+            reportCache.storeTotals(version, key, income, expenses);
+        }
+    }
+
+    Money categoryReportTotal(const std::string &categoryName, const Currency &currency) const // Expenses of the all-time category report
+    {
+        std::string key = "category " + currency.toString() + " " + categoryName;
+        Money income, expenses;
+        if (!reportCache.findTotals(version, key, income, expenses))
+        {
+            expenses = calculateExpensesByCategory(categoryName, currency);
+            reportCache.storeTotals(version, key, income, expenses);
+        }
+        return expenses;
+    }
+
+    Money categoryReportTotal(const std::string &categoryName, const Date &startDate, const Date &endDate, const Currency &currency) const // Expenses of the category report for a period
+    {
+        std::string key = "categoryPeriod " + reportPeriodKey(startDate, endDate, currency) + " " + categoryName;
+        Money income, expenses;
+        if (!reportCache.findTotals(version, key, income, expenses))
+        {
+            expenses = calculateExpensesByCategoryForPeriod(categoryName, startDate, endDate, currency);
+            reportCache.storeTotals(version, key, income, expenses);
+        }
+        return expenses;
+    }
+
+    std::vector<TimeSeriesPoint> timeSeriesReport(const Date &startDate, const Date &endDate, TimeInterval interval, size_t window, const Currency &currency) const
+    {
+        std::string key = reportPeriodKey(startDate, endDate, currency) + " " + std::to_string(interval) + " " + std::to_string(window);
+        std::vector<TimeSeriesPoint> series;
+        if (!reportCache.findSeries(version, key, series))
+        {
+            series = calculateTimeSeries(startDate, endDate, interval, window, currency);
+            reportCache.storeSeries(version, key, series);
+        }
+        return series;
+    }
+
+    // This function returns the balance from everything dated before date, in currency; in another currency than
+    // the home currency every transaction is converted at the rate of its date.
+    Money balanceBefore(const Date &date, const Currency &currency = BASE_CURRENCY) const
+    {
+        if (currency != BASE_CURRENCY)
+        {
+            int64_t incomeBefore, expensesBefore;
+            convertedTotals(currency, INT32_MIN, date.toOrdinal() - 1, nullptr, incomeBefore, expensesBefore);
+            return Money::fromMinorUnits(incomeBefore - expensesBefore);
+        }
+        return Money::fromMinorUnits(columns.sumForDays(INCOME_TRANSACTION, INT32_MIN, date.toOrdinal() - 1) -
+                                     columns.sumForDays(EXPENSE_TRANSACTION, INT32_MIN, date.toOrdinal() - 1) +
+                                     archives->sum(INCOME_TRANSACTION, true, 0, INT32_MIN, date.toOrdinal() - 1) -
+                                     archives->sum(EXPENSE_TRANSACTION, true, 0, INT32_MIN, date.toOrdinal() - 1) +
+                                     recurringTotal(INCOME_TRANSACTION, nullptr, INT32_MIN, date.toOrdinal() - 1) -
+                                     recurringTotal(EXPENSE_TRANSACTION, nullptr, INT32_MIN, date.toOrdinal() - 1));
+    }
+
+    // This function groups the transactions between startDate and endDate by interval in a single pass and
+    // returns one point per interval, including intervals without any transaction.
+    std::vector<TimeSeriesPoint> calculateTimeSeries(const Date &startDate, const Date &endDate, TimeInterval interval, size_t window,
+                                                     const Currency &currency = BASE_CURRENCY) const
+    {
+        STAT_TIMER("calculateTimeSeries");
+        if (endDate < startDate || window == 0)
+        {
+            throw InvalidPeriodException();
+        }
+        int64_t firstBucket = intervalBucket(startDate.toOrdinal(), interval);
+        size_t bucketCount = static_cast<size_t>(intervalBucket(endDate.toOrdinal(), interval) - firstBucket + 1);
+        std::vector<int64_t> income(bucketCount, 0), expenses(bucketCount, 0);
+        int32_t today = Date::today().toOrdinal();
+        Money runningBalance = balanceBefore(startDate, currency); // Balance before the first interval
+        if (currency == BASE_CURRENCY)
+        {
+            columns.accumulateByInterval(startDate.toOrdinal(), endDate.toOrdinal(), interval, firstBucket, income, expenses);
+            archives->accumulateByInterval(startDate.toOrdinal(), endDate.toOrdinal(), interval, firstBucket, income, expenses);
+        }
+        else // Convert every transaction at the rate of its date
+        {
+            auto addEntry = [&](const MonthlyRollups::Entry &entry)
+            {
+                std::vector<int64_t> &buckets = entry.type == INCOME_TRANSACTION ? income : expenses;
+                buckets[static_cast<size_t>(intervalBucket(entry.date, interval) - firstBucket)] +=
+                    exchangeRates.convert(entry.transaction->getAmount().getMinorUnits(), entry.transaction->getCurrency(), currency, entry.date);
+            };
+            rollups->forEachEntry(startDate.toOrdinal(), endDate.toOrdinal(), addEntry);
+            archives->forEachEntry(startDate.toOrdinal(), endDate.toOrdinal(), addEntry);
+        }
+        for (const auto &rule : *recurringRules) // Recurring transactions that have occurred by today
+        {
+            std::vector<int64_t> &buckets = rule.getType() == INCOME_TRANSACTION ? income : expenses;
+            rule.forEachOccurrence(startDate.toOrdinal(), std::min(endDate.toOrdinal(), today), [&](int32_t day)
+                                   { buckets[static_cast<size_t>(intervalBucket(day, interval) - firstBucket)] +=
+                                         exchangeRates.convert(rule.getAmount().getMinorUnits(), BASE_CURRENCY, currency, day); });
+        }
+
+        Money windowIncome, windowExpenses;
+        std::vector<TimeSeriesPoint> series(bucketCount);
+        for (size_t i = 0; i < bucketCount; ++i)
+        {
+            TimeSeriesPoint &point = series[i];
+            point.periodStart = i == 0 ? startDate : intervalStart(firstBucket + static_cast<int64_t>(i), interval);
+            point.income = Money::fromMinorUnits(income[i]);
+            point.expenses = Money::fromMinorUnits(expenses[i]);
+            point.net = point.income - point.expenses;
+            runningBalance += point.net;
+            point.balance = runningBalance;
+            windowIncome += point.income;
+            windowExpenses += point.expenses;
+            if (i >= window) // Slide the window
+            {
+                windowIncome -= series[i - window].income;
+                windowExpenses -= series[i - window].expenses;
+            }
+            int64_t windowSize = static_cast<int64_t>(std::min(i + 1, window));
+            point.averageIncome = windowIncome.dividedBy(windowSize);
+            point.averageExpenses = windowExpenses.dividedBy(windowSize);
+        }
+        return series;
+    }
+
+    // This function forecasts income and the expenses of every category from tomorrow to endDate. Each is projected
+    // along the trend line of its totals over the whole months before the current one, fitted from the trend sums
+    // kept with the monthly totals and the archive, so a forecast costs one fit per category however long the history
+    // is. The occurrences of recurring transactions are known, and are added as they are. The first line is income;
+    // historyMonths is set to the number of months the trend lines were fitted to. Amounts are converted to currency
+    // at the rates of today.
+    std::vector<ForecastLine> calculateForecast(const Date &endDate, const Currency &currency, int32_t &historyMonths) const
+    {
+        STAT_TIMER("calculateForecast");
+        int32_t today = Date::today().toOrdinal();
+        if (endDate.toOrdinal() <= today)
+        {
+            throw InvalidPeriodException();
+        }
+        int32_t currentMonth = Date::yearFromDays(today) * 12 + Date::monthFromDays(today) - 1;
+        int32_t firstMonth = currentMonth;
+        TrendSums incomeSums, expensesSums;
+        std::unordered_map<uint32_t, TrendSums> categorySums;
+        rollups->addTrendSums(currentMonth, firstMonth, incomeSums, expensesSums, categorySums);
+        archives->addTrendSums(firstMonth, incomeSums, expensesSums, categorySums);
+        historyMonths = currentMonth - firstMonth;
+
+        std::vector<std::pair<int32_t, double>> shares; // The months of the forecast, with the part of each it covers
+        for (int32_t day = today + 1; day <= endDate.toOrdinal();)
+        {
+            int32_t month = Date::yearFromDays(day) * 12 + Date::monthFromDays(day) - 1;
+            int32_t monthLength = Date::daysInMonth(month % 12 + 1, month / 12);
+            int32_t lastDay = std::min(Date::daysFromCivil(month / 12, month % 12 + 1, monthLength), endDate.toOrdinal());
+            shares.push_back(std::make_pair(month, (lastDay - day + 1.0) / monthLength));
+            day = lastDay + 1;
+        }
+        auto toCurrency = [&](double minorUnits)
+        {
+            return Money::fromMinorUnits(exchangeRates.convert(std::llround(minorUnits), BASE_CURRENCY, currency, today));
+        };
+        auto fit = [&](const std::string &name, const TrendSums &sums)
+        {
+            ForecastLine line;
+            line.name = name;
+            if (historyMonths > 0)
+            {
+                Trend trend(sums, firstMonth, currentMonth - 1);
+                double projected = 0;
+                for (const auto &share : shares)
+                {
+                    projected += share.second * trend.at(share.first);
+                }
+                line.average = toCurrency(trend.average);
+                line.trend = toCurrency(trend.slope);
+                line.projected = toCurrency(projected);
+            }
+            return line;
+        };
+
+        int64_t recurringIncome = 0;
+        std::map<std::string, int64_t> recurringExpenses; // By category name
+        for (const auto &rule : *recurringRules)
+        {
+            int64_t &total = rule.getType() == INCOME_TRANSACTION ? recurringIncome : recurringExpenses[rule.getCategoryName()];
+            rule.forEachOccurrence(today + 1, endDate.toOrdinal(), [&](int32_t)
+                                   { total += rule.getAmount().getMinorUnits(); });
+        }
+        std::vector<ForecastLine> forecast(1, fit("Income", incomeSums));
+        forecast[0].recurring = toCurrency(static_cast<double>(recurringIncome));
+        std::map<std::string, ForecastLine> categories;
+        for (const auto &category : categorySums)
+        {
+            if (category.second.total != 0 || category.second.weighted != 0)
+            {
+                const std::string &name = columns.categoryName(category.first);
+                categories[name] = fit(name, category.second);
+            }
+        }
+        for (const auto &expense : recurringExpenses)
+        {
+            ForecastLine &line = categories[expense.first];
+            line.name = expense.first;
+            line.recurring = toCurrency(static_cast<double>(expense.second));
+        }
+        for (const auto &category : categories)
+        {
+            forecast.push_back(category.second);
+        }
+        return forecast;
+    }
+
+    // Generate reports
+
+    // This function generates a summary report for a period specified by startDate and endDate.
+    void generateSummaryReport(const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const
+    {
+        writeSummaryReport(std::cout, startDate, endDate, currency);
+    }
+
+    // This function generates a category report for a category specified by categoryName.
+    void generateCategoryReport(const std::string &categoryName, const Currency &currency = BASE_CURRENCY) const
+    {
+        STAT_TIMER("categoryReport");
+        std::cout << "Category Report: " << categoryName << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << "Total Expenses in Category: " << categoryReportTotal(categoryName, currency) << " " << currency.toString() << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+    }
+
+    // This function generates a summary report for a period specified by startDate and endDate and saves it to a file.
+    // The confirmation message is left out when announce is false, as in batch runs.
+    void createSummaryReportFile(const Date &startDate, const Date &endDate, bool announce = true, const Currency &currency = BASE_CURRENCY) const
+    {
+        std::string fileName = username + "_" + "summary_report_" + std::to_string(startDate.getDay()) + "_" + std::to_string(startDate.getMonth()) + "_" + std::to_string(startDate.getYear()) + "_" + std::to_string(endDate.getDay()) + "_" + std::to_string(endDate.getMonth()) + "_" + std::to_string(endDate.getYear()) + ".txt";
+        std::ofstream file("reports/" + fileName); // Open file
+        if (!file)
+        {
+            throw FinancialException("Error creating summary report file."); // Throw exception if file cannot be opened
+        }
+
+        writeSummaryReport(file, startDate, endDate, currency); // Write report to file
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+
+        file.close();
+        if (announce)
+        {
+            std::cout << "Summary report file created successfully." << std::endl;
+        }
+    }
+
+    // This function generates a category report for a category specified by categoryName, over the period
+    // specified by startDate and endDate.
+    void generateCategoryReport(const std::string &categoryName, const Date &startDate, const Date &endDate, const Currency &currency = BASE_CURRENCY) const
+    {
+        STAT_TIMER("categoryReport");
+        std::cout << "Category Report: " << categoryName << " from " << startDate
+                  << " to " << endDate << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << "Total Expenses in Category: " << categoryReportTotal(categoryName, startDate, endDate, currency) << " " << currency.toString() << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+    }
+
+    // This function generates a category report for a category specified by categoryName, over the period
+    // specified by startDate and endDate, and saves it to a file.
+    void createCategoryReportFile(const std::string &categoryName, const Date &startDate, const Date &endDate, bool announce = true,
+                                  const Currency &currency = BASE_CURRENCY) const
+    {
+        STAT_TIMER("categoryReport");
+        std::string fileName = username + "_" + categoryName + "_report_" + std::to_string(startDate.getDay()) + "_" + std::to_string(startDate.getMonth()) + "_" + std::to_string(startDate.getYear()) + "_" + std::to_string(endDate.getDay()) + "_" + std::to_string(endDate.getMonth()) + "_" + std::to_string(endDate.getYear()) + ".txt";
+        std::ofstream file("reports/" + fileName); // Open file
+        if (!file)
+        {
+            throw FinancialException("Error creating category report file."); // Throw exception if file cannot be opened
+        }
+
+        // Write report to file
+        file << "Category Report: " << categoryName << " from " << startDate
+             << " to " << endDate << std::endl;
+        file << "--------------------------------------" << std::endl;
+        file << "Total Expenses in Category: " << categoryReportTotal(categoryName, startDate, endDate, currency) << " " << currency.toString() << std::endl;
+        file << "--------------------------------------" << std::endl;
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+
+        file.close();
+        if (announce)
+        {
+            std::cout << "Category report file created successfully." << std::endl;
+        }
+    }
+
+    // This function generates a category report for a category specified by categoryName and saves it to a file.
+    void createCategoryReportFile(const std::string &categoryName, bool announce = true, const Currency &currency = BASE_CURRENCY) const
+    {
+        STAT_TIMER("categoryReport");
+        std::string fileName = username + "_" + categoryName + "_report.txt";
+        std::ofstream file("reports/" + fileName); // Open file
+        if (!file)
+        {
+            throw FinancialException("Error creating category report file."); // Throw exception if file cannot be opened
+        }
+
+        // Write report to file
+        file << "Category Report: " << categoryName << std::endl;
+        file << "--------------------------------------" << std::endl;
+        file << "Total Expenses in Category: " << categoryReportTotal(categoryName, currency) << " " << currency.toString() << std::endl;
+        file << "--------------------------------------" << std::endl;
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+
+        file.close();
+        if (announce)
+        {
+            std::cout << "Category report file created successfully." << std::endl;
+        }
+    }
+
+    // This function generates a time series report for a period specified by startDate and endDate.
+    void generateTimeSeriesReport(const Date &startDate, const Date &endDate, TimeInterval interval, size_t window, const Currency &currency = BASE_CURRENCY) const
+    {
+        writeTimeSeriesReport(std::cout, startDate, endDate, interval, window, currency);
+    }
+
+    // This function generates a time series report for a period specified by startDate and endDate and saves it to a file.
+    void createTimeSeriesReportFile(const Date &startDate, const Date &endDate, TimeInterval interval, size_t window, bool announce = true,
+                                    const Currency &currency = BASE_CURRENCY) const
+    {
+        const char *intervalNames[] = {"daily", "weekly", "monthly", "yearly"};
+        std::string fileName = username + "_" + intervalNames[interval] + "_report_" + std::to_string(startDate.getDay()) + "_" + std::to_string(startDate.getMonth()) + "_" + std::to_string(startDate.getYear()) + "_" + std::to_string(endDate.getDay()) + "_" + std::to_string(endDate.getMonth()) + "_" + std::to_string(endDate.getYear()) + ".txt";
+        std::ofstream file("reports/" + fileName); // Open file
+        if (!file)
+        {
+            throw FinancialException("Error creating time series report file."); // Throw exception if file cannot be opened
+        }
+        writeTimeSeriesReport(file, startDate, endDate, interval, window, currency);
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+        file.close();
+        if (announce)
+        {
+            std::cout << "Time series report file created successfully." << std::endl;
+        }
+    }
+
+    // This function generates a forecast report from today to endDate.
+    void generateForecastReport(const Date &endDate, const Currency &currency = BASE_CURRENCY) const
+    {
+        writeForecastReport(std::cout, endDate, currency);
+    }
+
+    // This function generates a forecast report from today to endDate and saves it to a file.
+    void createForecastReportFile(const Date &endDate, bool announce = true, const Currency &currency = BASE_CURRENCY) const
+    {
+        std::string fileName = username + "_forecast_report_" + std::to_string(endDate.getDay()) + "_" + std::to_string(endDate.getMonth()) + "_" + std::to_string(endDate.getYear()) + ".txt";
+        std::ofstream file("reports/" + fileName); // Open file
+        if (!file)
+        {
+            throw FinancialException("Error creating forecast report file."); // Throw exception if file cannot be opened
+        }
+        writeForecastReport(file, endDate, currency);
+        STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+        file.close();
+        if (announce)
+        {
+            std::cout << "Forecast report file created successfully." << std::endl;
+        }
+    }
+
+private:
+    void appendTransaction(Transaction *transaction) // Store a transaction and its column entries, without touching the balance
+    {
+        if (transaction->getId() == 0) // New transaction
+        {
+            transaction->setId(nextTransactionId++);
+        }
+        nextTransactionId = std::max(nextTransactionId, transaction->getId() + 1);
+        slots.set(transaction->getId(), transactions.size());
+        transactions.push_back(std::shared_ptr<const Transaction>(transaction));
+        columns.append(transaction);
+        rollups.write().add(columns.entryAt(columns.size() - 1, transaction));
+        if (categoryIndexBuilt)
+        {
+            categoryIndex.add(columns.entryAt(columns.size() - 1, transaction), transaction->getId());
+        }
+        for (auto &budget : budgets.write())
+        {
+            budget.track(columns.entryAt(columns.size() - 1, transaction), 1);
+        }
+        if (searchIndexBuilt)
+        {
+            searchIndex.add(transaction);
+        }
+        if (fingerprintsBuilt)
+        {
+            fingerprints.add(transaction);
+        }
+    }
+
+    bool detachTransaction(uint64_t transactionId) // Remove a transaction from memory, leaving an empty slot
+    {
+        size_t slot;
+        if (!slots.find(transactionId, slot))
+        {
+            return false;
+        }
+        const Transaction *transaction = transactions[slot].get();
+        MonthlyRollups::Entry entry = columns.entryAt(slot, transaction); // The amount in the home currency
+        if (entry.type == INCOME_TRANSACTION)
+        {
+            balance -= Money::fromMinorUnits(entry.amount); // Subtract amount from balance
+        }
+        else if (entry.type == EXPENSE_TRANSACTION)
+        {
+            balance += Money::fromMinorUnits(entry.amount); // Add amount to balance
+        }
+        rollups.write().remove(transaction, transaction->getDate().toOrdinal());
+        if (categoryIndexBuilt)
+        {
+            categoryIndex.remove(columns.entryAt(slot, transaction), transactionId);
+        }
+        for (auto &budget : budgets.write())
+        {
+            budget.track(columns.entryAt(slot, transaction), -1);
+        }
+        if (searchIndexBuilt)
+        {
+            searchIndex.remove(transaction);
+        }
+        if (fingerprintsBuilt)
+        {
+            fingerprints.remove(transaction);
+        }
+        columns.markRemoved(slot); // The slot no longer matches any aggregation
+        slots.erase(transactionId);
+        transactions.set(slot, nullptr); // Frees the transaction, unless a snapshot still holds it
+        ++removedSlots;
+        return true;
+    }
+
+    std::vector<int> budgetLevels(const Date &date) const // Level of every budget in the period containing date
+    {
+        std::vector<int> levels;
+        for (const auto &budget : *budgets)
+        {
+            levels.push_back(budget.level(budgetSpent(budget, intervalBucket(date.toOrdinal(), budget.getPeriod()))));
+        }
+        return levels;
+    }
+
+    void raiseBudgetAlerts(const Date &date, const std::vector<int> &previousLevels) // Alert for every budget that rose to a higher level
+    {
+        const char *periodNames[] = {"daily", "weekly", "monthly", "yearly"};
+        std::vector<int> levels = budgetLevels(date);
+        for (size_t i = 0; i < budgets->size(); ++i)
+        {
+            if (levels[i] > previousLevels[i])
+            {
+                const Budget &budget = (*budgets)[i];
+                Money spentAmount = Money::fromMinorUnits(budgetSpent(budget, intervalBucket(date.toOrdinal(), budget.getPeriod())));
+                std::string scope = budget.getCategoryName().empty() ? "all expenses" : budget.getCategoryName();
+                std::ostringstream alert;
+                alert << (levels[i] == 2 ? "Budget exceeded: " : "Budget warning: ") << spentAmount << " of " << budget.getLimit()
+                      << " " << BASE_CURRENCY.toString() << " spent on " << scope << " (" << periodNames[budget.getPeriod()] << " budget)";
+                budgetAlerts.push_back(alert.str());
+            }
+        }
+    }
+
+    // This function adds up the income and expenses dated in [firstDay, lastDay] in currency, in a single pass over
+    // the transactions of the months in the range. Each transaction is converted from its own currency at the rate
+    // of its date; recurring transactions up to today are converted the same way. If categoryName is given, only
+    // expenses in that category count.
+    void convertedTotals(const Currency &currency, int32_t firstDay, int32_t lastDay, const std::string *categoryName, int64_t &income, int64_t &expenses) const
+    {
+        income = expenses = 0;
+        firstDay = std::max(firstDay, Date(1, 1, 0).toOrdinal());
+        lastDay = std::min(lastDay, Date(31, 12, 9999).toOrdinal());
+        uint32_t categoryId = 0;
+        if (!categoryName || columns.findCategory(*categoryName, categoryId)) // Otherwise no expense was ever recorded in the category
+        {
+            auto addEntry = [&](const MonthlyRollups::Entry &entry)
+            {
+                if (categoryName && (entry.type != EXPENSE_TRANSACTION || entry.category != categoryId))
+                {
+                    return;
+                }
+                (entry.type == INCOME_TRANSACTION ? income : expenses) +=
+                    exchangeRates.convert(entry.transaction->getAmount().getMinorUnits(), entry.transaction->getCurrency(), currency, entry.date);
+            };
+            rollups->forEachEntry(firstDay, lastDay, addEntry);
+            archives->forEachEntry(firstDay, lastDay, addEntry);
+        }
+        lastDay = std::min(lastDay, Date::today().toOrdinal());
+        for (const auto &rule : *recurringRules)
+        {
+            if (categoryName && (rule.getType() != EXPENSE_TRANSACTION || rule.getCategoryName() != *categoryName))
+            {
+                continue;
+            }
+            int64_t &total = rule.getType() == INCOME_TRANSACTION ? income : expenses;
+            rule.forEachOccurrence(firstDay, lastDay, [&](int32_t day)
+                                   { total += exchangeRates.convert(rule.getAmount().getMinorUnits(), BASE_CURRENCY, currency, day); });
+        }
+    }
+
+    // Call visit for every generated occurrence of the recurring rules dated in [firstDay, lastDay], in date order
+    // (see generateOccurrences).
+    template <typename Visitor>
+    void forEachOccurrenceBetween(int32_t firstDay, int32_t lastDay, Visitor visit) const
+    {
+        auto it = std::lower_bound(occurrences->begin(), occurrences->end(), firstDay, [](const std::shared_ptr<const Transaction> &occurrence, int32_t day)
+                                   { return occurrence->getDate().toOrdinal() < day; });
+        for (; it != occurrences->end() && (*it)->getDate().toOrdinal() <= lastDay; ++it)
+        {
+            visit(it->get());
+        }
+    }
+
+    // Sum of the occurrences of recurring rules of one type dated in [firstDay, lastDay] and not after today,
+    // in minor units. If categoryName is given, only expense rules in that category count.
+    int64_t recurringTotal(uint8_t type, const std::string *categoryName, int32_t firstDay, int32_t lastDay) const
+    {
+        if (recurringRules->empty())
+        {
+            return 0;
+        }
+        lastDay = std::min(lastDay, Date::today().toOrdinal());
+        int64_t total = 0;
+        for (const auto &rule : *recurringRules)
+        {
+            if (rule.getType() == type && (!categoryName || rule.getCategoryName() == *categoryName))
+            {
+                total += rule.totalBetween(firstDay, lastDay);
+            }
+        }
+        return total;
+    }
+
+    const Transaction *updateTransaction(uint64_t transactionId, const Money &amount, const std::string &description, const Date &date, const std::string &categoryName)
+    {
+        size_t slot;
+        if (!slots.find(transactionId, slot))
+        {
+            return nullptr;
+        }
+        const Transaction *previous = transactions[slot].get();
+        rollups.write().remove(previous, previous->getDate().toOrdinal()); // Take the old values out of the monthly totals
+        if (categoryIndexBuilt)
+        {
+            categoryIndex.remove(columns.entryAt(slot, previous), transactionId);
+        }
+        for (auto &budget : budgets.write())
+        {
+            budget.track(columns.entryAt(slot, previous), -1);
+        }
+        if (searchIndexBuilt)
+        {
+            searchIndex.remove(previous);
+        }
+        if (fingerprintsBuilt)
+        {
+            fingerprints.remove(previous);
+        }
+        Money oldAmount = Money::fromMinorUnits(columns.entryAt(slot, previous).amount); // In the home currency
+        // A snapshot may still read the transaction, so the edit is made to a copy, which takes its slot
+        const Expense *previousExpense = dynamic_cast<const Expense *>(previous);
+        Expense *expenseTransaction = previousExpense ? new Expense(*previousExpense) : nullptr;
+        Transaction *transaction = expenseTransaction ? static_cast<Transaction *>(expenseTransaction) : new Income(*static_cast<const Income *>(previous));
+        if (expenseTransaction)
+        {
+            expenseTransaction->setCategory(Category(categoryName));
+        }
+        transaction->setAmount(amount);
+        transaction->setDescription(description);
+        transaction->setDate(date);
+        transactions.set(slot, std::shared_ptr<const Transaction>(transaction));
+        columns.update(slot, transaction);
+        Money newAmount = Money::fromMinorUnits(columns.entryAt(slot, transaction).amount);
+        if (expenseTransaction)
+        {
+            balance -= newAmount - oldAmount; // Adjust balance by the difference
+        }
+        else
+        {
+            balance += newAmount - oldAmount;
+        }
+        rollups.write().add(columns.entryAt(slot, transaction));
+        if (categoryIndexBuilt)
+        {
+            categoryIndex.add(columns.entryAt(slot, transaction), transactionId);
+        }
+        for (auto &budget : budgets.write())
+        {
+            budget.track(columns.entryAt(slot, transaction), 1);
+        }
+        if (searchIndexBuilt)
+        {
+            searchIndex.add(transaction);
+        }
+        if (fingerprintsBuilt)
+        {
+            fingerprints.add(transaction);
+        }
+        return transaction;
+    }
+
+    void compactIfNeeded() // Drop the empty slots once they make up half of the transactions vector
+    {
+        if (removedSlots <= MIN_COMPACTION_SLOTS || removedSlots * 2 < transactions.size())
+        {
+            return;
+        }
+        columns.removeMarked();
+        ChunkedVector<std::shared_ptr<const Transaction>> kept;
+        for (const auto &transaction : transactions)
+        {
+            if (transaction)
+            {
+                slots.set(transaction->getId(), kept.size());
+                kept.push_back(transaction);
+            }
+        }
+        transactions = kept;
+        removedSlots = 0;
+    }
+
+    // Append entries describing changeCount changes to the journal. Once the journal holds more changes than
+    // the user has transactions, the whole user file is rewritten instead and the journal starts over. The changes
+    // are only counted once they are in the journal.
+    void journal(const std::string &entries, size_t changeCount)
+    {
+        if (journalEntries + changeCount > std::max(MIN_JOURNAL_ENTRIES, slots.size()))
+        {
+            saveUserData(*this);
+            journalEntries = 0;
+            return;
+        }
+        appendJournal(*this, entries);
+        journalEntries += changeCount;
+    }
+
+    // This function writes the summary report to out, with the totals in currency.
+    void writeSummaryReport(std::ostream &out, const Date &startDate, const Date &endDate, const Currency &currency) const
+    {
+        STAT_TIMER("summaryReport");
+        Money income, expenses;
+        summaryReportTotals(startDate, endDate, currency, income, expenses);
+        out << "Summary Report from " << startDate
+            << " to " << endDate << std::endl;
+        out << "--------------------------------------" << std::endl;
+        out << "Total Income: " << income << " " << currency.toString() << std::endl;
+        out << "Total Expenses: " << expenses << " " << currency.toString() << std::endl;
+        out << "Net Savings: " << income - expenses << " " << currency.toString() << std::endl;
+        out << "--------------------------------------" << std::endl;
+    }
+
+    // This function writes the time series report to out, one line per interval.
+    void writeTimeSeriesReport(std::ostream &out, const Date &startDate, const Date &endDate, TimeInterval interval, size_t window, const Currency &currency) const
+    {
+        STAT_TIMER("timeSeriesReport");
+        std::vector<TimeSeriesPoint> series = timeSeriesReport(startDate, endDate, interval, window, currency);
+        writeTimeSeriesHeader(out, "", startDate, endDate, interval, window, currency);
+        for (const auto &point : series)
+        {
+            writeTimeSeriesPoint(out, point, interval);
+        }
+        out << "------------------------------------------------------------------------------------------------" << std::endl;
+    }
+
+    // This function writes the forecast report to out: one line for income and one per category, then the balance
+    // today and the one expected on endDate.
+    void writeForecastReport(std::ostream &out, const Date &endDate, const Currency &currency) const
+    {
+        STAT_TIMER("forecastReport");
+        int32_t historyMonths;
+        std::vector<ForecastLine> forecast = calculateForecast(endDate, currency, historyMonths);
+        Money balanceToday = Money::fromMinorUnits(exchangeRates.convert(getBalance().getMinorUnits(), BASE_CURRENCY, currency, Date::today().toOrdinal()));
+        Money income, expenses;
+        out << "Forecast to " << endDate << " (" << currency.toString()
+            << ", trends over " << historyMonths << " months)\n";
+        out << "------------------------------------------------------------------------------------------------\n";
+        if (historyMonths == 0)
+        {
+            out << "There is no whole month of history yet, so only recurring transactions are projected.\n";
+        }
+        out << std::left << std::setw(26) << "Category" << std::right << std::setw(14) << "Avg/Month" << std::setw(14) << "Trend/Month"
+            << std::setw(14) << "Projected" << std::setw(14) << "Recurring" << std::setw(14) << "Total" << "\n";
+        for (size_t i = 0; i < forecast.size(); ++i)
+        {
+            const ForecastLine &line = forecast[i];
+            Money total = line.projected + line.recurring;
+            (i == 0 ? income : expenses) += total;
+            out << std::left << std::setw(26) << line.name << std::right << std::setw(14) << line.average << std::setw(14) << line.trend
+                << std::setw(14) << line.projected << std::setw(14) << line.recurring << std::setw(14) << total << "\n";
+        }
+        out << "------------------------------------------------------------------------------------------------\n";
+        out << "Balance Today: " << balanceToday << " " << currency.toString() << "\n";
+        out << "Projected Income: " << income << " " << currency.toString() << "\n";
+        out << "Projected Expenses: " << expenses << " " << currency.toString() << "\n";
+        out << "Projected Balance on " << endDate << ": "
+            << balanceToday + income - expenses << " " << currency.toString() << "\n";
+        out << "------------------------------------------------------------------------------------------------" << std::endl;
+    }
+
+public:
+    // This function writes the title and column headings of a time series report; title goes before "Daily Report".
+    static void writeTimeSeriesHeader(std::ostream &out, const std::string &title, const Date &startDate, const Date &endDate, TimeInterval interval,
+                                      size_t window, const Currency &currency)
+    {
+        const char *intervalTitles[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+        out << title << intervalTitles[interval] << " Report from " << startDate
+            << " to " << endDate << " (" << currency.toString() << ", rolling average over " << window << ")\n";
+        out << "------------------------------------------------------------------------------------------------\n";
+        out << std::left << std::setw(12) << "Period" << std::right << std::setw(14) << "Income" << std::setw(14) << "Expenses"
+            << std::setw(14) << "Net" << std::setw(14) << "Balance" << std::setw(14) << "Avg Income" << std::setw(14) << "Avg Expenses" << "\n";
+    }
+
+    // This function writes the line of one interval of a time series report.
+    static void writeTimeSeriesPoint(std::ostream &out, const TimeSeriesPoint &point, TimeInterval interval)
+    {
+        char period[FORMAT_BUFFER_SIZE];
+        const char *begin = period;
+        char *end;
+        if (interval == YEARLY)
+        {
+            end = formatInteger(period, point.periodStart.getYear());
+        }
+        else
+        {
+            end = point.periodStart.format(period);
+            if (interval == MONTHLY)
+            {
+                begin += 3; // mm/yyyy, the date without the day
+            }
+        }
+        out << std::left << std::setw(12);
+        writeFormatted(out, begin, static_cast<size_t>(end - begin));
+        out << std::right << std::setw(14) << point.income << std::setw(14) << point.expenses
+            << std::setw(14) << point.net << std::setw(14) << point.balance << std::setw(14) << point.averageIncome
+            << std::setw(14) << point.averageExpenses << "\n";
+    }
+};
+
+// This function writes the part of the user file that follows the key and password: the username, the balance
+// without the occurrences of recurring transactions (which are counted from their rules), the transactions, recurring rules and budgets, the archive segments in use, and the monthly totals.
+void writeUserRecords(std::ostream &file, const User &user)
+{
+    file << user.getUsername() << std::endl;
+    file << user.getStoredBalance() << std::endl;
+    {
+        RecordWriter records(file); // Passes the records on at the end of this block, before the lines that follow
+        user.forEachTransaction([&records](const Transaction *transaction)
+                                { writeTransactionRecord(records, transaction); });
+    }
+    for (const auto &rule : user.getRecurringRules())
+    {
+        rule.write(file);
+    }
+    for (const auto &budget : user.getBudgets())
+    {
+        budget.write(file);
+    }
+    user.writeArchives(file);
+    user.writeRollups(file); // Save the monthly totals, so that logging in does not recompute them
+    user.writeNextIds(file);
+}
+
+const uint64_t CHECKSUM_SEED = 14695981039346656037ULL; // Checksum of no bytes
+
+uint64_t updateChecksum(uint64_t checksum, const char *data, size_t size) // FNV-1a hash, continued over data
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        checksum = (checksum ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+    }
+    return checksum;
+}
+
+// This stream buffer passes everything written to it on to another stream buffer and keeps the checksum of it.
+class ChecksumBuffer : public std::streambuf
+{
+private:
+    std::streambuf *target;
+    uint64_t checksum; // Of everything passed on so far
+    char buffer[4096];
+
+    bool passOn() // Pass on the buffered output
+    {
+        std::streamsize size = pptr() - pbase();
+        checksum = updateChecksum(checksum, pbase(), static_cast<size_t>(size));
+        setp(buffer, buffer + sizeof(buffer));
+        return target->sputn(buffer, size) == size;
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!passOn())
+        {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        return passOn() && target->pubsync() == 0 ? 0 : -1;
+    }
+
+public:
+    explicit ChecksumBuffer(std::streambuf *target) : target(target), checksum(CHECKSUM_SEED)
+    {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    uint64_t getChecksum() const // Getter for checksum; output is only counted once it was flushed
+    {
+        return checksum;
+    }
+};
+
+// This function writes a whole user file: the key, the encrypted password, the records (see writeUserRecords) and a
+// last "Checksum <16 hex digits>" line with the checksum of everything before it, which fsck verifies. The loader
+// skips that line, as it does other lines that do not start a record. The checksum covers the bytes handed to file, so
+// file must be opened in binary mode; in text mode Windows would write "\r\n" for every "\n" that was checksummed.
+void writeUserFile(std::ostream &file, const std::string &key, const std::string &encryptedPassword, const User &user)
+{
+    ChecksumBuffer checksummed(file.rdbuf());
+    std::ostream out(&checksummed);
+    out << key << "\n";
+    out << encryptedPassword << "\n";
+    writeUserRecords(out, user);
+    out.flush();
+    file << "Checksum " << std::hex << std::setw(16) << std::setfill('0') << checksummed.getChecksum() << std::dec << std::setfill(' ') << "\n";
+}
+
+// This function saves the user data to a file. The data is written to a temporary file that then replaces the
+// user file, so that another process loading the user at the same time (a batch report run, say) reads either
+// the old file or the new one, never half of one.
+void saveUserData(const User &user)
+{
+    STAT_TIMER("saveUserData");
+    std::string path = "data/" + user.getUsername() + ".txt";
+    std::string temporaryPath = path + ".tmp";
+    std::string key = lineSafeKey(user.getId(), user.getPassword()); // Get key
+    std::ofstream file(temporaryPath, std::ios::binary);               // Open the file that replaces the one associated with user
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: User file Cannot be opened."); // Throw exception if file cannot be opened
+    }
+
+    // Write user data to file
+    writeUserFile(file, key, encryptPassword(user.getPassword(), key), user);
+    STAT_ADD(STAT_BYTES_WRITTEN, std::max<std::streamoff>(file.tellp(), 0));
+
+    file.close();
+    if (!file)
+    {
+        std::remove(temporaryPath.c_str());
+        throw FinancialException("Error saving user data: User file Cannot be written.");
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(path.c_str()); // Windows does not rename over an existing file
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+        {
+            throw FinancialException("Error saving user data: User file Cannot be replaced.");
+        }
+    }
+    std::remove(("data/" + user.getUsername() + ".journal").c_str()); // Everything in the journal is in the user file now
+}
+
+// This function appends entries to the journal of a user. The journal records the changes made since the
+// user file was last written, so that a single change does not have to rewrite the whole file.
+// Entries are transaction records as in the user file (adding a transaction), "Remove <id>" lines, or
+// "Edit <id>" lines followed by the edited record.
+void appendJournal(const User &user, const std::string &entries)
+{
+    std::ofstream file("data/" + user.getUsername() + ".journal", std::ios::app | std::ios::binary); // Open journal associated with user
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: Journal file Cannot be opened."); // Throw exception if file cannot be opened
+    }
+    file << entries;
+    file.flush();
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: Journal file Cannot be written."); // The changes are not in the journal
+    }
+    STAT_ADD(STAT_BYTES_WRITTEN, entries.size());
+}
+
+// Loading user files
+// A user file is read into memory in large blocks and then parsed in three steps:
+//   1. the text is split into lines, each thread finding the line breaks in its own part of the buffer,
+//   2. a quick walk over the first line of each record finds where the records start
+//      (an Income record has 4 lines, an Expense record 5),
+//   3. the records are split into one range per thread and parsed in parallel into per-thread buffers.
+// The per-thread results, with their partial balances and columns, are merged into the user in file order.
+
+const size_t LOAD_BLOCK_SIZE = 1 << 22;         // Bytes read from the file at a time
+const size_t PARALLEL_LOAD_THRESHOLD = 1 << 20; // Files smaller than this are parsed on the calling thread
+
+// This function reads a whole file into contents. Returns false if the file cannot be opened.
+bool readFileBlocks(const std::string &path, std::string &contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    contents.clear();
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (size > 0)
+    {
+        contents.reserve(static_cast<size_t>(size));
+    }
+    std::vector<char> block(LOAD_BLOCK_SIZE);
+    while (file.read(block.data(), block.size()) || file.gcount() > 0)
+    {
+        contents.append(block.data(), static_cast<size_t>(file.gcount()));
+    }
+    STAT_ADD(STAT_BYTES_READ, contents.size());
+    return true;
+}
+
+// This struct is a line of a file held in memory, without the line break.
+struct TextLine
+{
+    const char *begin;
+    const char *end;
+
+    bool equals(const char *text) const
+    {
+        size_t length = std::strlen(text);
+        return static_cast<size_t>(end - begin) == length && std::equal(begin, end, text);
+    }
+
+    bool startsWith(const char *text) const
+    {
+        size_t length = std::strlen(text);
+        return static_cast<size_t>(end - begin) >= length && std::equal(text, text + length, begin);
+    }
+
+    std::string toString() const
+    {
+        return std::string(begin, end);
+    }
+};
+
+// This function reads the next line starting at position exactly as std::getline does on a stream, keeping a
+// '\r' before the line break. The key and the encrypted password are read this way: they are bytes of any value
+// and can end in '\r' themselves.
+bool nextRawLine(const char *&position, const char *end, TextLine &line)
+{
+    if (position >= end)
+    {
+        return false;
+    }
+    const char *lineEnd = static_cast<const char *>(std::memchr(position, '\n', end - position));
+    line.begin = position;
+    line.end = lineEnd ? lineEnd : end;
+    position = lineEnd ? lineEnd + 1 : end;
+    return true;
+}
+
+// This function reads the next line starting at position, without the '\r' of files written on Windows.
+bool nextLine(const char *&position, const char *end, TextLine &line)
+{
+    if (!nextRawLine(position, end, line))
+    {
+        return false;
+    }
+    if (line.end > line.begin && line.end[-1] == '\r') // Files written on Windows
+    {
+        --line.end;
+    }
+    return true;
+}
+
+// This function runs work(0) ... work(count - 1), each on its own thread except the last,
+// which runs on the calling thread.
+void runInParallel(size_t count, const std::function<void(size_t)> &work)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i + 1 < count; ++i)
+    {
+        threads.push_back(std::thread(work, i));
+    }
+    if (count > 0)
+    {
+        work(count - 1);
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// This struct holds the transactions parsed by one thread, in file order.
+struct LoadedChunk
+{
+    std::vector<Transaction *> transactions;
+    TransactionColumns columns;
+    Money balance;     // Income minus expenses of the chunk, in the home currency
+    uint64_t largestId; // Largest transaction id in the chunk
+    std::string error; // Set if the chunk contains a corrupt record
+
+    LoadedChunk() : largestId(0) {}
+};
+
+// This function reads a number that follows prefix on a line, such as the id in "Income 42".
+// Returns false if the line does not start with prefix or the rest of the line is not a number.
+bool parseLineNumber(const TextLine &line, const char *prefix, uint64_t &number)
+{
+    if (!line.startsWith(prefix))
+    {
+        return false;
+    }
+    const char *p = line.begin + std::strlen(prefix);
+    if (p == line.end)
+    {
+        return false;
+    }
+    number = 0;
+    for (; p != line.end; ++p)
+    {
+        if (*p < '0' || *p > '9')
+        {
+            return false;
+        }
+        number = number * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    return true;
+}
+
+// This function checks whether a line starts a record: "Income" or "Expense", followed by the id of the
+// transaction in files written since transactions have ids. Returns the number of lines in the record
+// and sets id (0 if the line has none), or returns 0 if the line does not start a record.
+size_t recordLength(const TextLine &line, uint64_t &id)
+{
+    id = 0;
+    if (line.equals("Income") || parseLineNumber(line, "Income ", id))
+    {
+        return 4;
+    }
+    if (line.equals("Expense") || parseLineNumber(line, "Expense ", id))
+    {
+        return 5;
+    }
+    return 0;
+}
+
+// This function parses the record whose first line is lines[i]. Returns nullptr and sets error if it is corrupt.
+Transaction *parseRecord(const std::vector<TextLine> &lines, size_t i, std::string &error)
+{
+    uint64_t id;
+    bool isExpense = recordLength(lines[i], id) == 5;
+    Money amount;
+    Currency currency;
+    const char *amountEnd = lines[i + 1].end;
+    while (amountEnd != lines[i + 1].begin && (amountEnd[-1] == ' ' || amountEnd[-1] == '\r'))
+        --amountEnd;
+    if (amountEnd - lines[i + 1].begin > 4 && amountEnd[-4] == ' ' && Currency::parse(amountEnd - 3, amountEnd, currency)) // "12.50 USD"
+    {
+        amountEnd -= 4;
+    }
+    if (!Money::parse(lines[i + 1].begin, amountEnd, amount))
+    {
+        error = "Error loading user data: Invalid amount in user file.";
+        return nullptr;
+    }
+    if (!exchangeRates.has(currency))
+    {
+        error = "Error loading user data: No exchange rate for " + currency.toString() + " in data/rates.txt.";
+        return nullptr;
+    }
+    Date date;
+    if (!Date::parse(lines[i + 3].begin, lines[i + 3].end, date) || !date.checkValidity())
+    {
+        error = "Error loading user data: Invalid date in user file.";
+        return nullptr;
+    }
+    Transaction *transaction;
+    if (isExpense)
+    {
+        transaction = new Expense(amount, lines[i + 2].toString(), date, Category(lines[i + 4].toString())); // Add expense transaction
+    }
+    else
+    {
+        transaction = new Income(amount, lines[i + 2].toString(), date); // Add income transaction
+    }
+    transaction->setId(id);
+    transaction->setCurrency(currency);
+    return transaction;
+}
+
+// This function parses the records whose first lines are lines[recordStarts[first]] ... lines[recordStarts[last - 1]].
+void parseRecords(const std::vector<TextLine> &lines, const std::vector<size_t> &recordStarts, size_t first, size_t last, LoadedChunk &chunk)
+{
+    chunk.transactions.reserve(last - first);
+    for (size_t r = first; r < last; ++r)
+    {
+        Transaction *transaction = parseRecord(lines, recordStarts[r], chunk.error);
+        if (!transaction)
+        {
+            return;
+        }
+        chunk.largestId = std::max(chunk.largestId, transaction->getId());
+        chunk.transactions.push_back(transaction);
+        chunk.columns.append(transaction);
+        Money amount = Money::fromMinorUnits(chunk.columns.entryAt(chunk.columns.size() - 1, transaction).amount); // In the home currency
+        if (dynamic_cast<Expense *>(transaction))
+        {
+            chunk.balance -= amount;
+        }
+        else
+        {
+            chunk.balance += amount;
+        }
+    }
+}
+
+// This function splits [begin, end) into lines on the calling thread.
+std::vector<TextLine> splitLines(const char *begin, const char *end)
+{
+    std::vector<TextLine> lines;
+    TextLine line;
+    while (nextLine(begin, end, line))
+    {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// This function replays the journal of a user on top of the transactions loaded from the user file.
+void loadJournal(const std::string &username, User *user)
+{
+    std::string contents;
+    if (!readFileBlocks("data/" + username + ".journal", contents))
+    {
+        return; // No changes since the user file was written
+    }
+    contents.erase(contents.rfind('\n') + 1); // Leave out a line that another process is still appending
+    std::vector<TextLine> lines = splitLines(contents.data(), contents.data() + contents.size());
+    for (size_t i = 0; i < lines.size();)
+    {
+        uint64_t id;
+        size_t length = recordLength(lines[i], id);
+        if (length > 0 && i + length <= lines.size())
+        {
+            std::string error;
+            Transaction *transaction = parseRecord(lines, i, error);
+            if (!transaction)
+            {
+                throw FinancialException(error);
+            }
+            user->replayAdd(transaction);
+            i += length;
+            continue;
+        }
+        if (parseLineNumber(lines[i], "Remove ", id))
+        {
+            user->replayRemove(id);
+        }
+        else if (parseLineNumber(lines[i], "Edit ", id) && i + 1 < lines.size())
+        {
+            uint64_t recordId;
+            size_t editLength = recordLength(lines[i + 1], recordId);
+            if (editLength > 0 && i + 1 + editLength <= lines.size())
+            {
+                std::string error;
+                Transaction *edited = parseRecord(lines, i + 1, error);
+                if (!edited)
+                {
+                    throw FinancialException(error);
+                }
+                edited->setId(id);
+                user->replayEdit(edited);
+                delete edited;
+                i += 1 + editLength;
+                continue;
+            }
+        }
+        ++i; // A record cut short by a crash while it was written is skipped
+    }
+}
+
+// This function adds the transactions of an import file to user and returns how many were added. The file holds
+// records as they are written to user files ("Income" or "Expense", amount, description, date and, for expenses,
+// category, one per line); any other line is skipped and ids in the file are ignored. A record is a duplicate when
+// the user already has as many identical transactions as the file had before it, so importing the same file twice
+// adds nothing the second time. Duplicates are counted in duplicates and left out unless keepDuplicates is set.
+size_t importTransactions(User &user, const std::string &path, bool keepDuplicates, size_t &duplicates)
+{
+    STAT_TIMER("importTransactions");
+    std::string contents;
+    if (!readFileBlocks(path, contents))
+    {
+        throw FinancialException("Cannot read " + path + ".");
+    }
+    std::vector<TextLine> lines = splitLines(contents.data(), contents.data() + contents.size());
+    std::vector<Transaction *> records;  // Every record of the file, in file order
+    std::vector<bool> isDuplicate;       // Whether each record is a duplicate
+    FingerprintIndex earlierRecords;     // Records of the file so far; their ids are their positions in records
+    try
+    {
+        for (size_t i = 0; i < lines.size();)
+        {
+            uint64_t id;
+            size_t length = recordLength(lines[i], id);
+            if (length == 0 || i + length > lines.size())
+            {
+                ++i;
+                continue;
+            }
+            std::string error;
+            Transaction *transaction = parseRecord(lines, i, error);
+            if (!transaction)
+            {
+                throw FinancialException("Cannot import the record at line " + std::to_string(i + 1) + " of " + path + ". " + error);
+            }
+            i += length;
+            size_t earlier = 0; // Identical records before this one in the file
+            for (uint64_t position : earlierRecords.find(transaction))
+            {
+                if (sameTransaction(records[position], transaction))
+                {
+                    ++earlier;
+                }
+            }
+            transaction->setId(records.size());
+            earlierRecords.add(transaction);
+            records.push_back(transaction);
+            isDuplicate.push_back(earlier < user.findDuplicates(transaction).size());
+        }
+    }
+    catch (...)
+    {
+        for (Transaction *transaction : records)
+        {
+            delete transaction;
+        }
+        throw;
+    }
+    std::vector<Transaction *> added;
+    duplicates = 0;
+    for (size_t r = 0; r < records.size(); ++r)
+    {
+        duplicates += isDuplicate[r];
+        if (isDuplicate[r] && !keepDuplicates)
+        {
+            delete records[r];
+            continue;
+        }
+        records[r]->setId(0); // The user gives it a new id
+        added.push_back(records[r]);
+    }
+    user.addTransactions(added);
+    return added.size();
+}
+
+// This function reads the transaction records in [begin, end), the part of a user file after the header,
+// using up to threadCount threads. Returns false if the monthly totals saved in the file do not match the
+// transactions; they are recomputed then.
+bool loadTransactions(const char *begin, const char *end, User *user, size_t threadCount)
+{
+    size_t size = static_cast<size_t>(end - begin);
+    if (size < PARALLEL_LOAD_THRESHOLD)
+    {
+        threadCount = 1;
+    }
+    threadCount = std::max<size_t>(threadCount, 1);
+
+    // 1. Split into lines. Each thread owns the lines that start inside its part of the buffer.
+    std::vector<std::vector<TextLine>> chunkLines(threadCount);
+    runInParallel(threadCount, [&](size_t t)
+                  {
+                      const char *partBegin = begin + size * t / threadCount;
+                      const char *partEnd = begin + size * (t + 1) / threadCount;
+                      const char *position = partBegin;
+                      if (t > 0) // Skip to the first line that starts inside this part
+                      {
+                          const char *lineBreak = static_cast<const char *>(std::memchr(partBegin - 1, '\n', end - (partBegin - 1)));
+                          position = lineBreak ? lineBreak + 1 : end;
+                      }
+                      TextLine line;
+                      while (position < partEnd && nextLine(position, end, line))
+                      {
+                          chunkLines[t].push_back(line);
+                      } });
+    std::vector<TextLine> lines;
+    size_t lineCount = 0;
+    for (const auto &part : chunkLines)
+    {
+        lineCount += part.size();
+    }
+    lines.reserve(lineCount);
+    for (auto &part : chunkLines)
+    {
+        lines.insert(lines.end(), part.begin(), part.end());
+        std::vector<TextLine>().swap(part);
+    }
+
+    // 2. Find the first line of every record. Monthly totals, recurring rules, budgets and archive segments are
+    //    collected separately; other lines that do not start a record are skipped. Of an archive segment only
+    //    the header and the footer are read.
+    std::vector<size_t> recordStarts;
+    std::vector<std::string> savedRollups;
+    std::vector<RecurringRule> rules;
+    std::vector<Budget> budgets;
+    std::vector<ArchiveSegment> segments;
+    for (size_t i = 0; i < lines.size();)
+    {
+        uint64_t id;
+        size_t length = recordLength(lines[i], id);
+        if (length == 0)
+        {
+            if (lines[i].startsWith("Rollup ") || lines[i].startsWith("CategoryRollup "))
+            {
+                savedRollups.push_back(lines[i].toString());
+            }
+            else if (lines[i].startsWith("Budget "))
+            {
+                Budget budget("", MONTHLY, Money(), 0);
+                if (!Budget::parse(lines[i].toString(), budget))
+                {
+                    throw FinancialException("Error loading user data: Invalid budget in user file.");
+                }
+                budgets.push_back(budget);
+            }
+            else if (lines[i].startsWith("Archive "))
+            {
+                int32_t year;
+                uint64_t generation;
+                if (!ArchiveSegment::parseReference(lines[i].toString(), year, generation))
+                {
+                    throw FinancialException("Error loading user data: Invalid archive in user file.");
+                }
+                segments.push_back(ArchiveSegment::read(user->getUsername(), year, generation));
+            }
+            else if (lines[i].startsWith("NextIds "))
+            {
+                std::istringstream fields(lines[i].toString().substr(std::strlen("NextIds ")));
+                uint64_t transactionId, ruleId, budgetId;
+                if (!(fields >> transactionId >> ruleId >> budgetId))
+                {
+                    throw FinancialException("Error loading user data: Invalid ids in user file.");
+                }
+                user->reserveIds(transactionId, ruleId, budgetId);
+            }
+            else if (lines[i].startsWith("Recurring "))
+            {
+                std::vector<std::string> ruleLines(1, lines[i].toString());
+                size_t ruleLength = RecurringRule::recordLength(ruleLines[0]);
+                for (size_t j = 1; j < ruleLength && i + j < lines.size(); ++j)
+                {
+                    ruleLines.push_back(lines[i + j].toString());
+                }
+                RecurringRule rule(INCOME_TRANSACTION, Money(), "", "", MONTHLY, Date(), false, Date());
+                if (!RecurringRule::parse(ruleLines, rule))
+                {
+                    throw FinancialException("Error loading user data: Invalid recurring rule in user file.");
+                }
+                rules.push_back(rule);
+                i += ruleLength;
+                continue;
+            }
+            ++i;
+            continue;
+        }
+        if (i + length > lines.size())
+        {
+            throw FinancialException("Error loading user data: Truncated record in user file.");
+        }
+        recordStarts.push_back(i);
+        i += length;
+    }
+
+    // 3. Parse the records, one contiguous range per thread
+    threadCount = std::min(threadCount, std::max<size_t>(recordStarts.size(), 1));
+    std::vector<LoadedChunk> chunks(threadCount);
+    runInParallel(threadCount, [&](size_t t)
+                  { parseRecords(lines, recordStarts, recordStarts.size() * t / threadCount,
+                                 recordStarts.size() * (t + 1) / threadCount, chunks[t]); });
+
+    for (const auto &chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            std::string error = chunk.error;
+            for (auto &other : chunks) // Free everything that was parsed
+            {
+                for (auto transaction : other.transactions)
+                {
+                    delete transaction;
+                }
+            }
+            throw FinancialException(error);
+        }
+    }
+    for (const auto &segment : segments)
+    {
+        user->loadArchive(segment);
+    }
+    for (const auto &chunk : chunks)
+    {
+        user->reserveTransactionIds(chunk.largestId);
+    }
+    for (const auto &chunk : chunks) // Merge in file order
+    {
+        user->loadTransactions(chunk.transactions, chunk.columns, chunk.balance);
+    }
+    for (const auto &rule : rules)
+    {
+        user->loadRecurringRule(rule);
+    }
+    for (const auto &budget : budgets)
+    {
+        user->loadBudget(budget);
+    }
+    return user->finishLoading(savedRollups);
+}
+
+// This function reads a user file into contents and splits off its header.
+// Returns false if the file cannot be opened.
+bool readUserFile(const std::string &username, std::string &contents, std::string &key, std::string &encryptedPassword,
+                  std::string &loadedUsername, const char *&records)
+{
+    if (!readFileBlocks("data/" + username + ".txt", contents))
+    {
+        return false;
+    }
+    const char *position = contents.data();
+    const char *end = contents.data() + contents.size();
+    TextLine line;
+    key = nextRawLine(position, end, line) ? line.toString() : std::string();
+    encryptedPassword = nextRawLine(position, end, line) ? line.toString() : std::string();
+    loadedUsername = nextLine(position, end, line) ? line.toString() : std::string();
+    nextLine(position, end, line); // Stored balance; the balance is recomputed from the transactions
+    records = position;
+    return true;
+}
+
+size_t defaultLoadThreads()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// This function loads the user data from a file.
+int loadUserData(const std::string &username, const std::string &password, User *&user, size_t threadCount = defaultLoadThreads())
+{
+    STAT_TIMER("loadUserData");
+    std::string contents, key, loadedPassword, loadedUsername;
+    const char *records;
+    if (!readUserFile(username, contents, key, loadedPassword, loadedUsername, records)) // Open file associated with user
+    {
+        throw FinancialException("User data not found."); // Throw exception if file cannot be opened
+    }
+    if (loadedUsername != username) // Check if username matches
+    {
+        return -1;
+    }
+
+    loadedPassword = decryptPassword(loadedPassword, key); // Decrypt password
+    if (loadedPassword != password)                        // Check if password matches
+    {
+        return -2;
+    }
+
+    User *loadedUser = new User(username, password); // Create new user object
+    try
+    {
+        loadTransactions(records, contents.data() + contents.size(), loadedUser, threadCount); // Load user data
+        loadJournal(username, loadedUser);                                                     // Apply the changes made since
+    }
+    catch (...)
+    {
+        delete loadedUser; // Do not leave a half loaded user behind
+        throw;
+    }
+    user = loadedUser;
+    if (user->needsIdsSaved()) // Give transactions from older files ids that stay the same across sessions
+    {
+        saveUserData(*user);
+    }
+    return 0;
+}
+
+// This function loads the user data from a file without checking the password.
+// It is used by the batch tools, which run without anyone logged in.
+User *loadUserDataUnchecked(const std::string &username, size_t threadCount = defaultLoadThreads())
+{
+    STAT_TIMER("loadUserData");
+    std::string contents, key, loadedPassword, loadedUsername;
+    const char *records;
+    if (!readUserFile(username, contents, key, loadedPassword, loadedUsername, records))
+    {
+        throw FinancialException("User data not found for " + username + "."); // Throw exception if file cannot be opened
+    }
+    if (loadedUsername != username)
+    {
+        throw FinancialException("User file of " + username + " belongs to another user.");
+    }
+
+    User *user = new User(username, decryptPassword(loadedPassword, key));
+    try
+    {
+        loadTransactions(records, contents.data() + contents.size(), user, threadCount);
+        loadJournal(username, user);
+    }
+    catch (...)
+    {
+        delete user;
+        throw;
+    }
+    return user;
+}
+
+// This function registers a new user.
+User *registerUser(const std::string &username, const std::string &password)
+{
+    // Check if user already exists
+    if (users.count(username))
+    {
+        throw FinancialException("User already exists.");
+    }
+    // Add user to the set of users
+    users.insert(username);
+    std::ofstream file("data/users.txt", std::ios::app);
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: User file Cannot be opened.");
+    }
+    file << username << std::endl;
+    // Create a new user
+    User user(username, password);
+    // Save user data
+    saveUserData(user);
+    std::cout << "User " << username << " registered successfully." << std::endl;
+    return new User(user);
+}
+
+// This function removes the archive segments named in the user file of username.
+void removeArchives(const std::string &username)
+{
+    std::string contents;
+    if (!readFileBlocks("data/" + username + ".txt", contents))
+    {
+        return;
+    }
+    for (const auto &line : splitLines(contents.data(), contents.data() + contents.size()))
+    {
+        int32_t year;
+        uint64_t generation;
+        if (line.startsWith("Archive ") && ArchiveSegment::parseReference(line.toString(), year, generation))
+        {
+            std::remove(ArchiveSegment::pathFor(username, year, generation).c_str());
+        }
+    }
+}
+
+// Groups
+// A group, such as a household, combines the accounts of several registered users in its reports (see
+// writeGroupSummaryReport). Groups are kept in data/groups.txt, each as a "Group <name> <member count>" line followed
+// by a line per member.
+
+std::map<std::string, std::vector<std::string>> groups; // Members of every group, by group name
+
+// This function reads the groups from groups.txt into groups.
+void loadGroups()
+{
+    groups.clear();
+    std::ifstream file("data/groups.txt");
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream header(line);
+        std::string tag, name;
+        size_t memberCount;
+        if (!(header >> tag >> name >> memberCount) || tag != "Group")
+        {
+            throw FinancialException("Invalid group in data/groups.txt: " + line);
+        }
+        std::vector<std::string> &members = groups[name];
+        members.clear();
+        for (size_t i = 0; i < memberCount && std::getline(file, line); ++i)
+        {
+            members.push_back(line);
+        }
+    }
+}
+
+// This function writes groups to groups.txt, replacing the file only once it is complete.
+void saveGroups()
+{
+    std::ofstream file("data/groups.txt.tmp");
+    for (const auto &group : groups)
+    {
+        file << "Group " << group.first << " " << group.second.size() << "\n";
+        for (const auto &member : group.second)
+        {
+            file << member << "\n";
+        }
+    }
+    file.close();
+    if (!file)
+    {
+        std::remove("data/groups.txt.tmp");
+        throw FinancialException("Error saving groups: data/groups.txt cannot be written.");
+    }
+    if (std::rename("data/groups.txt.tmp", "data/groups.txt") != 0)
+    {
+        std::remove("data/groups.txt"); // Windows does not rename over an existing file
+        if (std::rename("data/groups.txt.tmp", "data/groups.txt") != 0)
+        {
+            throw FinancialException("Error saving groups: data/groups.txt cannot be replaced.");
+        }
+    }
+}
+
+// This function takes a deleted user out of every group; groups left without members are deleted.
+void removeFromGroups(const std::string &username)
+{
+    loadGroups();
+    bool changed = false;
+    for (auto it = groups.begin(); it != groups.end();)
+    {
+        std::vector<std::string> &members = it->second;
+        auto member = std::find(members.begin(), members.end(), username);
+        if (member != members.end())
+        {
+            members.erase(member);
+            changed = true;
+        }
+        it = members.empty() ? groups.erase(it) : std::next(it);
+    }
+    if (changed)
+    {
+        saveGroups();
+    }
+}
+
+// This function deletes a user.
+User *deleteUser(const std::string &username, const std::string &password)
+{
+    // Check if user exists
+    auto it = users.find(username);
+    if (it == users.end())
+    {
+        throw FinancialException("User does not exist.");
+    }
+    // Remove user from the set of users
+    users.erase(it);
+    // Delete archive segments, user file and journal
+    removeArchives(username);
+    std::remove(("data/" + username + ".txt").c_str());
+    std::remove(("data/" + username + ".journal").c_str());
+    // remove user from users.txt
+    std::ifstream file("data/users.txt");             // Open users.txt
+    std::ofstream temp("data/temp.txt");              // Create temp.txt
+    for (std::string line; std::getline(file, line);) // Read users.txt line by line and write to temp.txt, except for the line containing the username
+    {
+        if (line != username)
+        {
+            temp << line << std::endl;
+        }
+    }
+    file.close();
+    temp.close();
+    std::remove("data/users.txt");                  // Delete users.txt
+    std::rename("data/temp.txt", "data/users.txt"); // Rename temp.txt to users.txt, effectively removing the user from users.txt
+    removeFromGroups(username);
+    return nullptr;
+}
+
+void login(const std::string &username, const std::string &password, User *&user)
+{
+    // Check if user exists
+    auto it = users.find(username);
+    if (it == users.end())
+    {
+        throw FinancialException("User does not exist."); // Throw exception if user does not exist
+    }
+    // Load user data, if password is wrong add option to change password,try again or exit
+    int status = loadUserData(username, password, user);
+    if (status == -1)
+    {
+        throw FinancialException("Invalid username."); // Throw exception if username is wrong
+    }
+    else if (status == -2)
+    {
+        throw FinancialException("Invalid password."); // Throw exception if password is wrong
+    }
+    user->generateOccurrences(); // The recurring transactions up to today, listed with the others
+    std::cout << "User " << username << " logged in successfully." << std::endl;
+}
+
+// Batch reporting
+// The batch tools run without anyone logged in. They are started from the command line, e.g.
+//     myFinanceManager batch-reports 01/01/2024 31/01/2024 --threads 8 --max-users 16
+
+// This class is a thread pool in which every worker owns a queue of tasks. A worker takes tasks from
+// the back of its own queue and, when that is empty, steals from the front of the other queues, so
+// that a few large accounts do not leave the other cores idle at the end of a run.
+
+class WorkStealingPool
+{
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;  // Tasks waiting in the queues
+    std::atomic<size_t> pending; // Tasks submitted and not yet finished
+    std::atomic<size_t> nextQueue;
+    bool stopping;
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    bool popTask(size_t self, std::function<void()> &task) // Take a task from the own queue, or steal one
+    {
+        {
+            WorkerQueue &own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); ++offset)
+        {
+            WorkerQueue &victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self)
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            if (popTask(self, task))
+            {
+                --queued;
+                task();
+                if (--pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(stateMutex);
+                    allDone.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(stateMutex);
+            workAvailable.wait(lock, [this]()
+                               { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t threadCount) : queued(0), pending(0), nextQueue(0), stopping(false)
+    {
+        threadCount = std::max<size_t>(threadCount, 1);
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        }
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            workers.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    void submit(std::function<void()> task) // Queue a task; tasks are spread over the workers round robin
+    {
+        ++pending;
+        WorkerQueue &queue = *queues[nextQueue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        ++queued;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex); // Pairs with the wait in workerLoop so the wake up is not lost
+        }
+        workAvailable.notify_one();
+    }
+
+    bool waitFor(std::chrono::milliseconds timeout) // Wait until all tasks are finished, or the timeout expires
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        return allDone.wait_for(lock, timeout, [this]()
+                                { return pending == 0; });
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+};
+
+// This class limits how many users are held in memory at the same time during a batch run.
+
+class ResidentUserLimit
+{
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    size_t available;
+
+public:
+    explicit ResidentUserLimit(size_t limit) : available(std::max<size_t>(limit, 1)) {}
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [this]()
+                      { return available > 0; });
+        --available;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++available;
+        }
+        released.notify_one();
+    }
+};
+
+// This function reads the list of registered users from users.txt into the set of users.
+void loadRegisteredUsers()
+{
+    users.clear();                                    // Clear set of users
+    std::ifstream file("data/users.txt");             // Open users.txt
+    for (std::string line; std::getline(file, line);) // Read users.txt line by line and add each line to the set of users
+    {
+        users.insert(line);
+    }
+    file.close();
+}
+
+// This function writes the summary report and a category report for every category, both for [startDate, endDate],
+// of every registered user into the reports folder. Users are loaded and reported on a work stealing pool,
+// with at most maxResidentUsers of them in memory at once. Progress is printed while the run goes on.
+// Returns the number of users whose reports could not be written.
+size_t runBatchReports(const Date &startDate, const Date &endDate, size_t threadCount, size_t maxResidentUsers, const Currency &currency)
+{
+    std::vector<std::string> usernames(users.begin(), users.end());
+    std::atomic<size_t> usersDone(0);
+    std::atomic<size_t> reportsWritten(0);
+    std::atomic<size_t> transactionsProcessed(0);
+    std::mutex failuresMutex;
+    std::vector<std::string> failures;
+    ResidentUserLimit residentUsers(maxResidentUsers);
+
+    auto started = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(threadCount);
+        std::cout << "Generating reports for " << usernames.size() << " users on " << pool.size() << " threads..." << std::endl;
+        for (const auto &name : usernames)
+        {
+            pool.submit([&, name]()
+                        {
+                            residentUsers.acquire();
+                            User *user = nullptr;
+                            try
+                            {
+                                user = loadUserDataUnchecked(name, 1); // The pool already keeps every core busy
+                                user->createSummaryReportFile(startDate, endDate, false, currency);
+                                size_t written = 1;
+                                for (const auto &categoryName : user->getCategoryNames())
+                                {
+                                    user->createCategoryReportFile(categoryName, startDate, endDate, false, currency);
+                                    ++written;
+                                }
+                                reportsWritten += written;
+                                transactionsProcessed += user->getTransactionCount();
+                            }
+                            catch (const std::exception &e)
+                            {
+                                std::lock_guard<std::mutex> lock(failuresMutex);
+                                failures.push_back(name + ": " + e.what());
+                            }
+                            delete user;
+                            residentUsers.release();
+                            ++usersDone; });
+        }
+
+        // Report progress until the pool has finished every user
+        while (!pool.waitFor(std::chrono::milliseconds(500)))
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            size_t done = usersDone;
+            std::cout << "\rProcessed " << done << "/" << usernames.size() << " users ("
+                      << std::fixed << std::setprecision(1) << (usernames.empty() ? 100.0 : 100.0 * done / usernames.size()) << "%), "
+                      << std::setprecision(0) << done / seconds << " users/s" << std::flush;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    seconds = std::max(seconds, 1e-9);
+
+    std::cout << "\rProcessed " << usersDone << "/" << usernames.size() << " users (100.0%)            " << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Elapsed: " << seconds << " s" << std::endl;
+    std::cout << "Reports written: " << reportsWritten << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Throughput: " << usersDone / seconds << " users/s, "
+              << transactionsProcessed / seconds << " transactions/s, "
+              << reportsWritten / seconds << " reports/s" << std::endl;
+    std::cout << "Failed users: " << failures.size() << std::endl;
+    for (const auto &failure : failures)
+    {
+        std::cout << "  " << failure << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    return failures.size();
+}
+
+// This function handles "batch-reports <start date> <end date> [--threads N] [--max-users N] [--currency CODE]".
+int batchReportsCommand(const std::vector<std::string> &args)
+{
+    Date startDate, endDate;
+    bool valid = args.size() >= 2 && Date::parse(args[0], startDate) && startDate.checkValidity() &&
+                 Date::parse(args[1], endDate) && endDate.checkValidity();
+    size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t maxResidentUsers = 0;
+    Currency currency;
+    for (size_t i = 2; valid && i < args.size(); i += 2)
+    {
+        if (i + 1 == args.size()) // Every option takes a value
+        {
+            valid = false;
+        }
+        else if (args[i] == "--threads")
+        {
+            threadCount = std::stoul(args[i + 1]);
+        }
+        else if (args[i] == "--max-users")
+        {
+            maxResidentUsers = std::stoul(args[i + 1]);
+        }
+        else if (args[i] == "--currency")
+        {
+            const std::string &code = args[i + 1];
+            if (!Currency::parse(code, currency) || !exchangeRates.has(currency))
+            {
+                throw FinancialException("Unknown currency: " + code);
+            }
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if (!valid)
+    {
+        std::cout << "Usage: batch-reports dd/mm/yyyy dd/mm/yyyy [--threads N] [--max-users N] [--currency CODE]" << std::endl;
+        return 1;
+    }
+    if (maxResidentUsers == 0)
+    {
+        maxResidentUsers = 2 * threadCount; // Enough to keep every thread busy
+    }
+    loadRegisteredUsers();
+    return runBatchReports(startDate, endDate, threadCount, maxResidentUsers, currency) == 0 ? 0 : 1;
+}
+
+// Benchmarks
+// "generate-data" writes synthetic users and "bench" times the hot paths of the application on them, printing a line
+// per benchmark and writing the results as JSON, e.g.
+//     myFinanceManager generate-data --users 100 --transactions 10000 --categories 12
+//     myFinanceManager bench --users 20 --transactions 20000 --iterations 5 --output bench.json
+// Both work in a folder of their own, "bench" unless --folder names another, with its own data and reports folders,
+// so that accounts with a known password are not added to the real data folder. Users that were not generated are
+// never overwritten. "make bench" builds an optimized binary and runs it.
+
+const char *const SYNTHETIC_USER_PREFIX = "bench";      // Synthetic users are named bench0, bench1, ...
+const char *const SYNTHETIC_PASSWORD = "benchmark";     // Password of every synthetic user
+const char *const SYNTHETIC_KEY = "2718281828";         // Digits, so that the encrypted password stays printable
+const char *const REGISTRY_USER_PREFIX = "benchregister"; // Users registered and deleted by the registry benchmarks
+
+// This struct holds the sizes of the synthetic data and how the benchmarks are run.
+struct BenchmarkOptions
+{
+    size_t users;               // Number of synthetic users
+    size_t transactionsPerUser; // Transactions in the file of every synthetic user
+    size_t categories;          // Number of expense categories
+    uint32_t seed;              // The same seed always gives the same data
+    size_t iterations;          // Times every benchmark is repeated
+    std::string output;         // File the JSON results are written to, in folder
+    std::string folder;         // Folder the synthetic users are written to and the benchmarks run in
+
+    BenchmarkOptions() : users(20), transactionsPerUser(10000), categories(12), seed(1), iterations(5), output("bench.json"), folder("bench") {}
+};
+
+// This function reads the "--name value" options of generate-data and bench into options.
+// Returns false if an option is unknown or has no value.
+bool parseBenchmarkOptions(const std::vector<std::string> &args, BenchmarkOptions &options)
+{
+    for (size_t i = 0; i < args.size(); i += 2)
+    {
+        if (i + 1 >= args.size())
+        {
+            return false;
+        }
+        const std::string &value = args[i + 1];
+        if (args[i] == "--users")
+        {
+            options.users = std::stoul(value);
+        }
+        else if (args[i] == "--transactions")
+        {
+            options.transactionsPerUser = std::stoul(value);
+        }
+        else if (args[i] == "--categories")
+        {
+            options.categories = std::max<size_t>(std::stoul(value), 1);
+        }
+        else if (args[i] == "--seed")
+        {
+            options.seed = static_cast<uint32_t>(std::stoul(value));
+        }
+        else if (args[i] == "--iterations")
+        {
+            options.iterations = std::max<size_t>(std::stoul(value), 1);
+        }
+        else if (args[i] == "--output")
+        {
+            options.output = value;
+        }
+        else if (args[i] == "--folder")
+        {
+            options.folder = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// This function creates folder with its data and reports folders, unless they exist, and makes it the working folder.
+void enterBenchmarkFolder(const std::string &folder)
+{
+    for (const std::string &path : {folder, folder + "/data", folder + "/reports"})
+    {
+#ifdef _WIN32
+        int made = _mkdir(path.c_str());
+#else
+        int made = mkdir(path.c_str(), 0755);
+#endif
+        if (made != 0 && errno != EEXIST)
+        {
+            throw FinancialException("Cannot create the folder " + path + ".");
+        }
+    }
+#ifdef _WIN32
+    int entered = _chdir(folder.c_str());
+#else
+    int entered = chdir(folder.c_str());
+#endif
+    if (entered != 0)
+    {
+        throw FinancialException("Cannot enter the folder " + folder + ".");
+    }
+}
+
+std::string syntheticUsername(size_t index)
+{
+    return SYNTHETIC_USER_PREFIX + std::to_string(index);
+}
+
+// This function returns the names of the expense categories of the synthetic data.
+std::vector<std::string> syntheticCategories(size_t count)
+{
+    const char *names[] = {"food", "rent", "transport", "utilities", "shopping", "health",
+                           "fun", "education", "travel", "insurance", "gifts", "subscriptions"};
+    const size_t nameCount = sizeof(names) / sizeof(names[0]);
+    std::vector<std::string> categories;
+    for (size_t i = 0; i < count; ++i)
+    {
+        categories.push_back(i < nameCount ? std::string(names[i]) : "category" + std::to_string(i + 1));
+    }
+    return categories;
+}
+
+// This function writes the file of the synthetic user with the given index, in the same format as saveUserData.
+// About one transaction in ten is income. Expenses fall into few categories far more often than into the others
+// and their amounts are log-normal, like real spending. Transactions are spread over 2021 to 2024 in date order.
+void writeSyntheticUser(const BenchmarkOptions &options, size_t index)
+{
+    const char *merchants[] = {"Agora", "Shwapno", "Daraz", "Pathao", "Foodpanda", "Aarong", "Unimart", "Bata", "Apex", "Star Kabab"};
+    const char *items[] = {"groceries", "lunch", "dinner", "ride", "bill", "order", "refill", "ticket", "repair", "gift"};
+    const char *incomeDescriptions[] = {"salary", "freelance invoice", "bonus", "interest", "refund"};
+
+    std::string username = syntheticUsername(index);
+    std::ifstream existing("data/" + username + ".txt", std::ios::binary);
+    std::string existingKey;
+    if (existing && std::getline(existing, existingKey) && existingKey != SYNTHETIC_KEY)
+    {
+        throw FinancialException("The user " + username + " exists and was not generated; it is not overwritten.");
+    }
+    existing.close();
+    std::mt19937 gen(options.seed * 7919u + static_cast<uint32_t>(index));
+    std::vector<std::string> categories = syntheticCategories(options.categories);
+    std::vector<double> weights;
+    for (size_t i = 0; i < categories.size(); ++i)
+    {
+        weights.push_back(1.0 / (i + 1));
+    }
+    std::discrete_distribution<size_t> pickCategory(weights.begin(), weights.end());
+    std::lognormal_distribution<double> expenseAmount(5.5, 1.1); // A few hundred BDT, with a long tail
+    std::lognormal_distribution<double> incomeAmount(8.3, 0.6); // Slightly more than is spent, on average
+    std::uniform_int_distribution<int32_t> pickDay(Date(1, 1, 2021).toOrdinal(), Date(31, 12, 2024).toOrdinal());
+    std::uniform_int_distribution<size_t> pickWord(0, 9);
+
+    std::vector<int32_t> days(options.transactionsPerUser);
+    for (auto &day : days)
+    {
+        day = pickDay(gen);
+    }
+    std::sort(days.begin(), days.end());
+
+    User user(username, SYNTHETIC_PASSWORD);
+    for (int32_t day : days)
+    {
+        Date date = Date::fromOrdinal(day);
+        if (pickWord(gen) == 0)
+        {
+            Money amount = Money::fromMinorUnits(std::llround(incomeAmount(gen)) * 100);
+            user.loadTransaction(new Income(amount, incomeDescriptions[pickWord(gen) % 5], date));
+        }
+        else
+        {
+            Money amount = Money::fromMinorUnits(std::max<int64_t>(std::llround(expenseAmount(gen) * 100), 1));
+            std::string description = std::string(merchants[pickWord(gen)]) + " " + items[pickWord(gen)];
+            user.loadTransaction(new Expense(amount, description, date, Category(categories[pickCategory(gen)])));
+        }
+    }
+
+    std::ofstream file("data/" + username + ".txt", std::ios::binary);
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: User file Cannot be opened.");
+    }
+    writeUserFile(file, SYNTHETIC_KEY, encryptPassword(SYNTHETIC_PASSWORD, SYNTHETIC_KEY), user);
+    std::remove(("data/" + username + ".journal").c_str());
+}
+
+// This function writes the files of all synthetic users, in parallel, and registers the ones not registered yet.
+void generateSyntheticData(const BenchmarkOptions &options)
+{
+    loadRegisteredUsers();
+    std::mutex failureMutex;
+    std::string failure;
+    runInParallel(options.users, [&](size_t index)
+                  {
+                      try
+                      {
+                          writeSyntheticUser(options, index);
+                      }
+                      catch (const std::exception &e)
+                      {
+                          std::lock_guard<std::mutex> lock(failureMutex);
+                          failure = e.what();
+                      } });
+    if (!failure.empty())
+    {
+        throw FinancialException(failure);
+    }
+    std::ofstream file("data/users.txt", std::ios::app);
+    if (!file)
+    {
+        throw FinancialException("Error saving user data: User file Cannot be opened.");
+    }
+    for (size_t i = 0; i < options.users; ++i)
+    {
+        if (users.insert(syntheticUsername(i)).second)
+        {
+            file << syntheticUsername(i) << std::endl;
+        }
+    }
+}
+
+// This struct holds the timings of one benchmark.
+struct BenchmarkResult
+{
+    std::string name;
+    size_t operations;           // Operations done by every iteration
+    std::vector<double> seconds; // Time taken by every iteration, sorted
+
+    double median() const
+    {
+        size_t middle = seconds.size() / 2;
+        return seconds.size() % 2 ? seconds[middle] : (seconds[middle - 1] + seconds[middle]) / 2;
+    }
+
+    double mean() const
+    {
+        double total = 0;
+        for (double s : seconds)
+        {
+            total += s;
+        }
+        return total / seconds.size();
+    }
+};
+
+// This function runs body the given number of times and times every run. setup is run before every run and is not
+// timed. Prints a line with the median time.
+template <typename Setup, typename Body>
+BenchmarkResult runBenchmark(const std::string &name, size_t operations, size_t iterations, Setup setup, Body body)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.operations = operations;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        setup();
+        auto started = std::chrono::steady_clock::now();
+        body();
+        result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+    }
+    std::sort(result.seconds.begin(), result.seconds.end());
+    double median = std::max(result.median(), 1e-9);
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << operations << " ops"
+              << std::fixed << std::setprecision(3) << std::setw(14) << median * 1000 << " ms"
+              << std::setprecision(1) << std::setw(16) << operations / median << " ops/s" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    return result;
+}
+
+// This class discards everything written to std::cout while it exists, used to keep the messages of
+// registerUser out of the benchmark output.
+class SilenceOutput
+{
+private:
+    std::streambuf *saved;
+
+public:
+    SilenceOutput() : saved(std::cout.rdbuf(nullptr)) {}
+
+    ~SilenceOutput()
+    {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+};
+
+// This function writes the benchmark results as JSON.
+void writeBenchmarkJson(std::ostream &out, const BenchmarkOptions &options, const std::vector<BenchmarkResult> &results)
+{
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"config\": {\"users\": " << options.users << ", \"transactions_per_user\": " << options.transactionsPerUser
+        << ", \"categories\": " << options.categories << ", \"seed\": " << options.seed
+        << ", \"iterations\": " << options.iterations << ", \"threads\": " << defaultLoadThreads() << "},\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult &result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"operations\": " << result.operations
+            << ", \"iterations\": " << result.seconds.size()
+            << ", \"min_ms\": " << result.seconds.front() * 1000 << ", \"median_ms\": " << result.median() * 1000
+            << ", \"mean_ms\": " << result.mean() * 1000 << ", \"max_ms\": " << result.seconds.back() * 1000
+            << ", \"ops_per_second\": " << result.operations / std::max(result.median(), 1e-9) << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// This function generates the synthetic data and runs every benchmark on it:
+//   generate          writing the files of all synthetic users
+//   load              logging in every synthetic user (reading and parsing the user file and journal)
+//   add, remove       adding transactions to one user and removing them again, one journal write each
+//   summary-report    a summary report file for one year, for every user, with the report cache cleared first
+//   category-report   a category report file for every category of every user, with the report cache cleared first
+//   summary-report-cached, category-report-cached
+//                     the same reports again, with their results taken from the report cache
+//   save              rewriting the file of every user
+//   register, registry-load, delete
+//                     registering users, reading users.txt and deleting the users again
+std::vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions &options)
+{
+    const size_t changesPerIteration = 1000;
+    const size_t registryUsers = 100;
+    std::vector<BenchmarkResult> results;
+    std::vector<User *> loaded;
+    auto unloadUsers = [&]()
+    {
+        for (User *user : loaded)
+        {
+            delete user;
+        }
+        loaded.clear();
+    };
+    auto noSetup = []() {};
+    auto clearReportCaches = [&]()
+    {
+        for (User *user : loaded)
+        {
+            user->clearReportCache();
+        }
+    };
+
+    results.push_back(runBenchmark("generate", options.users * options.transactionsPerUser, 1, noSetup, [&]()
+                                   { generateSyntheticData(options); }));
+    results.push_back(runBenchmark("load", options.users, options.iterations, unloadUsers, [&]()
+                                   {
+                                       for (size_t i = 0; i < options.users; ++i)
+                                       {
+                                           User *user = nullptr;
+                                           if (loadUserData(syntheticUsername(i), SYNTHETIC_PASSWORD, user) != 0)
+                                           {
+                                               throw FinancialException("Cannot log in " + syntheticUsername(i) + ".");
+                                           }
+                                           loaded.push_back(user);
+                                       } }));
+    if (loaded.empty())
+    {
+        return results;
+    }
+
+    std::vector<std::string> categories = syntheticCategories(options.categories);
+    std::vector<std::vector<uint64_t>> added;
+    results.push_back(runBenchmark("add", changesPerIteration, options.iterations, noSetup, [&]()
+                                   {
+                                       added.push_back(std::vector<uint64_t>());
+                                       for (size_t i = 0; i < changesPerIteration; ++i)
+                                       {
+                                           Expense *expense = new Expense(Money::fromMinorUnits(1000 + static_cast<int64_t>(i)), "benchmark",
+                                                                          Date(15, 6, 2024), Category(categories[i % categories.size()]));
+                                           loaded[0]->addTransaction(expense);
+                                           added.back().push_back(expense->getId());
+                                       }
+                                       loaded[0]->takeBudgetAlerts(); }));
+    results.push_back(runBenchmark("remove", changesPerIteration, options.iterations, noSetup, [&]()
+                                   {
+                                       for (uint64_t id : added.back())
+                                       {
+                                           loaded[0]->removeTransaction(id);
+                                       }
+                                       added.pop_back(); }));
+    auto summaryReports = [&]()
+    {
+        for (User *user : loaded)
+        {
+            user->createSummaryReportFile(Date(1, 1, 2023), Date(31, 12, 2023), false);
+        }
+    };
+    results.push_back(runBenchmark("summary-report", options.users, options.iterations, clearReportCaches, summaryReports));
+    results.push_back(runBenchmark("summary-report-cached", options.users, options.iterations, noSetup, summaryReports));
+    size_t categoryReports = 0;
+    for (User *user : loaded)
+    {
+        categoryReports += user->getCategoryNames().size();
+    }
+    auto categoryReportFiles = [&]()
+    {
+        for (User *user : loaded)
+        {
+            for (const auto &categoryName : user->getCategoryNames())
+            {
+                user->createCategoryReportFile(categoryName, false);
+            }
+        }
+    };
+    results.push_back(runBenchmark("category-report", categoryReports, options.iterations, clearReportCaches, categoryReportFiles));
+    results.push_back(runBenchmark("category-report-cached", categoryReports, options.iterations, noSetup, categoryReportFiles));
+    results.push_back(runBenchmark("save", options.users, options.iterations, noSetup, [&]()
+                                   {
+                                       for (User *user : loaded)
+                                       {
+                                           saveUserData(*user);
+                                       } }));
+    unloadUsers();
+
+    auto registryUsername = [](size_t i)
+    { return REGISTRY_USER_PREFIX + std::to_string(i); };
+    auto deleteRegistryUsers = [&]()
+    {
+        for (size_t i = 0; i < registryUsers; ++i)
+        {
+            if (users.count(registryUsername(i)))
+            {
+                deleteUser(registryUsername(i), SYNTHETIC_PASSWORD);
+            }
+        }
+    };
+    auto registerRegistryUsers = [&]()
+    {
+        SilenceOutput silence;
+        for (size_t i = 0; i < registryUsers; ++i)
+        {
+            delete registerUser(registryUsername(i), SYNTHETIC_PASSWORD);
+        }
+    };
+    results.push_back(runBenchmark("register", registryUsers, options.iterations, deleteRegistryUsers, registerRegistryUsers));
+    results.push_back(runBenchmark("registry-load", users.size(), options.iterations, noSetup, []()
+                                   { loadRegisteredUsers(); }));
+    results.push_back(runBenchmark("delete", registryUsers, options.iterations, [&]()
+                                   {
+                                       deleteRegistryUsers();
+                                       registerRegistryUsers(); },
+                                   deleteRegistryUsers));
+    return results;
+}
+
+// This function handles "generate-data [--users N] [--transactions N] [--categories N] [--seed N] [--folder DIR]".
+int generateDataCommand(const std::vector<std::string> &args)
+{
+    BenchmarkOptions options;
+    if (!parseBenchmarkOptions(args, options))
+    {
+        std::cout << "Usage: generate-data [--users N] [--transactions N] [--categories N] [--seed N] [--folder DIR]" << std::endl;
+        return 1;
+    }
+    enterBenchmarkFolder(options.folder);
+    generateSyntheticData(options);
+    std::cout << "Generated " << options.users << " users with " << options.transactionsPerUser << " transactions each in "
+              << options.folder << "." << std::endl;
+    return 0;
+}
+
+// This function handles "bench [--users N] [--transactions N] [--categories N] [--seed N] [--iterations N] [--output FILE] [--folder DIR]".
+int benchCommand(const std::vector<std::string> &args)
+{
+    BenchmarkOptions options;
+    if (!parseBenchmarkOptions(args, options))
+    {
+        std::cout << "Usage: bench [--users N] [--transactions N] [--categories N] [--seed N] [--iterations N] [--output FILE] [--folder DIR]" << std::endl;
+        return 1;
+    }
+    enterBenchmarkFolder(options.folder);
+    std::cout << "Benchmarking " << options.users << " users with " << options.transactionsPerUser << " transactions each, "
+              << options.iterations << " iterations..." << std::endl;
+    std::vector<BenchmarkResult> results = runBenchmarks(options);
+    std::ofstream file(options.output);
+    if (!file)
+    {
+        throw FinancialException("Cannot write benchmark results to " + options.output + ".");
+    }
+    writeBenchmarkJson(file, options, results);
+    std::cout << "Results written to " << options.folder << "/" << options.output << std::endl;
+    return 0;
+}
+
+// Archiving
+// "archive" seals the old transactions of every registered user into archive segments (see ArchiveSegment). The
+// horizon is given in months; every year that ended before the first day of the month that long ago is sealed, e.g.
+//     myFinanceManager archive --months 36
+
+// This function handles "archive [--months N]".
+int archiveCommand(const std::vector<std::string> &args)
+{
+    int months = ARCHIVE_HORIZON_MONTHS;
+    if (args.size() == 2 && args[0] == "--months")
+    {
+        months = std::stoi(args[1]);
+    }
+    if ((!args.empty() && args.size() != 2) || (args.size() == 2 && args[0] != "--months") || months < 0)
+    {
+        std::cout << "Usage: archive [--months N]" << std::endl;
+        return 1;
+    }
+    Date today = Date::today();
+    int32_t horizonMonth = today.getYear() * 12 + today.getMonth() - 1 - months;
+    Date horizon(1, horizonMonth % 12 + 1, horizonMonth / 12);
+    loadRegisteredUsers();
+    size_t failures = 0;
+    for (const auto &username : users)
+    {
+        try
+        {
+            std::unique_ptr<User> user(loadUserDataUnchecked(username));
+            size_t archived = user->archiveBefore(horizon);
+            std::cout << username << ": " << archived << " transactions archived, " << user->getArchivedTransactionCount()
+                      << " in the archive, " << user->getTransactionCount() << " not archived." << std::endl;
+        }
+        catch (const FinancialException &e)
+        {
+            std::cout << username << ": " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// Duplicates
+// "import" adds the transactions of a file to a user, leaving out those already recorded (see importTransactions),
+// and "dedupe" removes the extra copies of duplicate transactions from every registered user, e.g.
+//     myFinanceManager import alice statement.txt
+//     myFinanceManager dedupe --dry-run
+
+// This function handles "import <username> <file> [--keep-duplicates]".
+int importCommand(const std::vector<std::string> &args)
+{
+    if ((args.size() != 2 && args.size() != 3) || (args.size() == 3 && args[2] != "--keep-duplicates"))
+    {
+        std::cout << "Usage: import <username> <file> [--keep-duplicates]" << std::endl;
+        return 1;
+    }
+    loadRegisteredUsers();
+    if (!users.count(args[0]))
+    {
+        throw FinancialException("User " + args[0] + " does not exist.");
+    }
+    std::unique_ptr<User> user(loadUserDataUnchecked(args[0]));
+    size_t duplicates;
+    size_t added = importTransactions(*user, args[1], args.size() == 3, duplicates);
+    std::cout << added << " transactions imported, " << duplicates << " duplicates "
+              << (args.size() == 3 ? "kept." : "skipped.") << std::endl;
+    for (const auto &alert : user->takeBudgetAlerts())
+    {
+        std::cout << "!! " << alert << std::endl;
+    }
+    return 0;
+}
+
+// This function handles "dedupe [--dry-run]".
+int dedupeCommand(const std::vector<std::string> &args)
+{
+    if (!args.empty() && (args.size() != 1 || args[0] != "--dry-run"))
+    {
+        std::cout << "Usage: dedupe [--dry-run]" << std::endl;
+        return 1;
+    }
+    bool dryRun = !args.empty();
+    loadRegisteredUsers();
+    size_t failures = 0;
+    for (const auto &username : users)
+    {
+        try
+        {
+            std::unique_ptr<User> user(loadUserDataUnchecked(username));
+            if (dryRun)
+            {
+                size_t extra = 0;
+                std::vector<std::vector<const Transaction *>> groups = user->findDuplicateGroups();
+                for (const auto &group : groups)
+                {
+                    for (size_t i = 1; i < group.size(); ++i)
+                    {
+                        extra += user->isUnarchived(group[i]->getId());
+                    }
+                }
+                std::cout << username << ": " << groups.size() << " groups of duplicates, " << extra << " would be removed." << std::endl;
+            }
+            else
+            {
+                std::cout << username << ": " << user->removeDuplicates() << " duplicates removed." << std::endl;
+            }
+        }
+        catch (const FinancialException &e)
+        {
+            std::cout << username << ": " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// Group reports
+// The reports of a group combine the transactions of its members. The members are loaded one at a time, and each is
+// walked in date order by a LedgerCursor, which holds at most a month of its entries; its totals are added to those
+// of the group and it is freed before the next member is loaded. A report on a large group therefore never holds
+// more than one member and never builds a combined list of transactions. The members are not merged in date order
+// (a k-way merge of their cursors): that would keep every member loaded for the whole report, and every group report
+// only adds amounts up per member and per interval, which does not depend on the order entries come in. Groups are
+// managed and reported on from the command line, e.g.
+//     myFinanceManager group create family alice bob
+//     myFinanceManager group-report family summary 01/01/2024 31/12/2024
+//     myFinanceManager group-report family timeseries 01/01/2024 31/12/2024 monthly 3 --currency USD
+
+// This function returns the members of a group, in the order they were added to it.
+std::vector<std::string> groupMembers(const std::string &groupName)
+{
+    loadGroups();
+    auto it = groups.find(groupName);
+    if (it == groups.end())
+    {
+        throw FinancialException("Group " + groupName + " does not exist.");
+    }
+    return it->second;
+}
+
+// This function calls visit(member, user) for every member of a group, where member is its position in members and
+// user the member, loaded. Only one member is loaded at a time.
+template <typename Visitor>
+void forEachGroupMember(const std::vector<std::string> &members, Visitor visit)
+{
+    for (size_t member = 0; member < members.size(); ++member)
+    {
+        std::unique_ptr<const User> user(loadUserDataUnchecked(members[member]));
+        visit(member, *user);
+    }
+}
+
+// This function calls visit(member, entry) for every transaction of the members dated in [startDate, endDate] (see
+// User::LedgerCursor), member by member and, for each member, in date order.
+template <typename Visitor>
+void forEachGroupEntry(const std::vector<std::string> &members, const Date &startDate, const Date &endDate, const Currency &currency, Visitor visit)
+{
+    STAT_TIMER("forEachGroupEntry");
+    forEachGroupMember(members, [&](size_t member, const User &user)
+                       {
+                           for (User::LedgerCursor cursor(user, startDate, endDate, currency); !cursor.done(); cursor.next())
+                           {
+                               visit(member, cursor.entry());
+                           } });
+}
+
+// This function writes the income, expenses and net savings of every member of a group as a table.
+void writeGroupMembers(std::ostream &out, const std::vector<std::string> &members, const std::vector<int64_t> &income,
+                       const std::vector<int64_t> &expenses)
+{
+    out << std::left << std::setw(20) << "Member" << std::right << std::setw(14) << "Income" << std::setw(14) << "Expenses"
+        << std::setw(14) << "Net" << "\n";
+    for (size_t member = 0; member < members.size(); ++member)
+    {
+        out << std::left << std::setw(20) << members[member] << std::right << std::setw(14) << Money::fromMinorUnits(income[member])
+            << std::setw(14) << Money::fromMinorUnits(expenses[member]) << std::setw(14) << Money::fromMinorUnits(income[member] - expenses[member]) << "\n";
+    }
+    out << "--------------------------------------" << std::endl;
+}
+
+// This function writes the summary report of a group for a period to out: the totals of the group, then of every member.
+void writeGroupSummaryReport(std::ostream &out, const std::string &groupName, const std::vector<std::string> &members,
+                             const Date &startDate, const Date &endDate, const Currency &currency)
+{
+    STAT_TIMER("groupSummaryReport");
+    std::vector<int64_t> income(members.size(), 0), expenses(members.size(), 0);
+    forEachGroupEntry(members, startDate, endDate, currency, [&](size_t member, const User::LedgerEntry &entry)
+                      { (entry.type == INCOME_TRANSACTION ? income : expenses)[member] += entry.amount; });
+    Money totalIncome = Money::fromMinorUnits(std::accumulate(income.begin(), income.end(), int64_t(0)));
+    Money totalExpenses = Money::fromMinorUnits(std::accumulate(expenses.begin(), expenses.end(), int64_t(0)));
+    out << "Group Summary Report: " << groupName << " from " << startDate
+        << " to " << endDate << std::endl;
+    out << "--------------------------------------" << std::endl;
+    out << "Total Income: " << totalIncome << " " << currency.toString() << std::endl;
+    out << "Total Expenses: " << totalExpenses << " " << currency.toString() << std::endl;
+    out << "Net Savings: " << totalIncome - totalExpenses << " " << currency.toString() << std::endl;
+    out << "--------------------------------------" << std::endl;
+    writeGroupMembers(out, members, income, expenses);
+}
+
+// This function writes the category report of a group to out: the expenses of the group in a category, then of
+// every member. hasPeriod is false for the report over all time.
+void writeGroupCategoryReport(std::ostream &out, const std::string &groupName, const std::vector<std::string> &members,
+                              const std::string &categoryName, bool hasPeriod, const Date &startDate, const Date &endDate, const Currency &currency)
+{
+    STAT_TIMER("groupCategoryReport");
+    std::vector<int64_t> expenses(members.size(), 0);
+    forEachGroupEntry(members, hasPeriod ? startDate : Date(1, 1, 0), hasPeriod ? endDate : Date(31, 12, 9999), currency,
+                      [&](size_t member, const User::LedgerEntry &entry)
+                      {
+                          if (entry.categoryName && *entry.categoryName == categoryName)
+                          {
+                              expenses[member] += entry.amount;
+                          }
+                      });
+    out << "Group Category Report: " << groupName << ", " << categoryName;
+    if (hasPeriod)
+    {
+        out << " from " << startDate
+            << " to " << endDate;
+    }
+    out << std::endl;
+    out << "--------------------------------------" << std::endl;
+    out << "Total Expenses in Category: " << Money::fromMinorUnits(std::accumulate(expenses.begin(), expenses.end(), int64_t(0))) << " "
+        << currency.toString() << std::endl;
+    out << "--------------------------------------" << std::endl;
+    out << std::left << std::setw(20) << "Member" << std::right << std::setw(14) << "Expenses" << "\n";
+    for (size_t member = 0; member < members.size(); ++member)
+    {
+        out << std::left << std::setw(20) << members[member] << std::right << std::setw(14) << Money::fromMinorUnits(expenses[member]) << "\n";
+    }
+    out << "--------------------------------------" << std::endl;
+}
+
+// This function writes the time series report of a group to out, then the totals of every member over the period.
+// The income and expenses of every interval are added up member by member; only these totals, not the
+// transactions, are kept until the report is written.
+void writeGroupTimeSeriesReport(std::ostream &out, const std::string &groupName, const std::vector<std::string> &members,
+                                const Date &startDate, const Date &endDate, TimeInterval interval, size_t window, const Currency &currency)
+{
+    STAT_TIMER("groupTimeSeriesReport");
+    if (endDate < startDate || window == 0)
+    {
+        throw InvalidPeriodException();
+    }
+    int64_t firstBucket = intervalBucket(startDate.toOrdinal(), interval);
+    int64_t lastBucket = intervalBucket(endDate.toOrdinal(), interval);
+    std::vector<int64_t> income(members.size(), 0), expenses(members.size(), 0);
+    std::vector<int64_t> bucketIncome(static_cast<size_t>(lastBucket - firstBucket + 1), 0);
+    std::vector<int64_t> bucketExpenses(bucketIncome.size(), 0);
+    Money balance; // Balance of the group at the end of the last interval written
+    forEachGroupMember(members, [&](size_t member, const User &user)
+                       {
+                           balance += user.balanceBefore(startDate, currency);
+                           for (User::LedgerCursor cursor(user, startDate, endDate, currency); !cursor.done(); cursor.next())
+                           {
+                               const User::LedgerEntry &entry = cursor.entry();
+                               size_t bucket = static_cast<size_t>(intervalBucket(entry.date, interval) - firstBucket);
+                               (entry.type == INCOME_TRANSACTION ? bucketIncome : bucketExpenses)[bucket] += entry.amount;
+                               (entry.type == INCOME_TRANSACTION ? income : expenses)[member] += entry.amount;
+                           } });
+    std::deque<User::TimeSeriesPoint> recent; // The last window intervals written
+    Money windowIncome, windowExpenses;
+    User::writeTimeSeriesHeader(out, "Group " + groupName + " ", startDate, endDate, interval, window, currency);
+    for (int64_t bucket = firstBucket; bucket <= lastBucket; ++bucket)
+    {
+        User::TimeSeriesPoint point;
+        point.periodStart = bucket == firstBucket ? startDate : intervalStart(bucket, interval);
+        point.income = Money::fromMinorUnits(bucketIncome[static_cast<size_t>(bucket - firstBucket)]);
+        point.expenses = Money::fromMinorUnits(bucketExpenses[static_cast<size_t>(bucket - firstBucket)]);
+        point.net = point.income - point.expenses;
+        balance += point.net;
+        point.balance = balance;
+        windowIncome += point.income;
+        windowExpenses += point.expenses;
+        recent.push_back(point);
+        if (recent.size() > window) // Slide the window
+        {
+            windowIncome -= recent.front().income;
+            windowExpenses -= recent.front().expenses;
+            recent.pop_front();
+        }
+        point.averageIncome = windowIncome.dividedBy(static_cast<int64_t>(recent.size()));
+        point.averageExpenses = windowExpenses.dividedBy(static_cast<int64_t>(recent.size()));
+        User::writeTimeSeriesPoint(out, point, interval);
+    }
+    out << "------------------------------------------------------------------------------------------------" << std::endl;
+    writeGroupMembers(out, members, income, expenses);
+}
+
+// This function handles "group create <name> <member>...", "group delete <name>" and "group list".
+int groupCommand(const std::vector<std::string> &args)
+{
+    if (args.size() == 1 && args[0] == "list")
+    {
+        loadGroups();
+        for (const auto &group : groups)
+        {
+            std::cout << group.first << ":";
+            for (const auto &member : group.second)
+            {
+                std::cout << " " << member;
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+    if (args.size() >= 3 && args[0] == "create")
+    {
+        const std::string &name = args[1];
+        if (name.find_first_of(" \t\r\n") != std::string::npos)
+        {
+            throw FinancialException("Group names cannot contain spaces.");
+        }
+        loadRegisteredUsers();
+        loadGroups();
+        if (groups.count(name))
+        {
+            throw FinancialException("Group " + name + " already exists.");
+        }
+        std::vector<std::string> members;
+        for (size_t i = 2; i < args.size(); ++i)
+        {
+            if (!users.count(args[i]))
+            {
+                throw FinancialException("User " + args[i] + " does not exist.");
+            }
+            if (std::find(members.begin(), members.end(), args[i]) == members.end())
+            {
+                members.push_back(args[i]);
+            }
+        }
+        groups[name] = members;
+        saveGroups();
+        std::cout << "Group " << name << " created with " << members.size() << " members." << std::endl;
+        return 0;
+    }
+    if (args.size() == 2 && args[0] == "delete")
+    {
+        loadGroups();
+        if (!groups.erase(args[1]))
+        {
+            throw FinancialException("Group " + args[1] + " does not exist.");
+        }
+        saveGroups();
+        std::cout << "Group " << args[1] << " deleted." << std::endl;
+        return 0;
+    }
+    std::cout << "Usage: group create <name> <member>... | group delete <name> | group list" << std::endl;
+    return 1;
+}
+
+// This function handles
+//     group-report <group> summary dd/mm/yyyy dd/mm/yyyy [--currency CODE]
+//     group-report <group> category <category> [dd/mm/yyyy dd/mm/yyyy] [--currency CODE]
+//     group-report <group> timeseries dd/mm/yyyy dd/mm/yyyy daily|weekly|monthly|yearly [window] [--currency CODE]
+int groupReportCommand(const std::vector<std::string> &args)
+{
+    std::vector<std::string> arguments; // Without the options
+    Currency currency;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "--currency" && i + 1 < args.size())
+        {
+            if (!Currency::parse(args[i + 1], currency) || !exchangeRates.has(currency))
+            {
+                throw FinancialException("Unknown currency: " + args[i + 1]);
+            }
+            ++i;
+        }
+        else
+        {
+            arguments.push_back(args[i]);
+        }
+    }
+    auto parseDates = [&](size_t first, Date &startDate, Date &endDate)
+    {
+        return Date::parse(arguments[first], startDate) && startDate.checkValidity() &&
+               Date::parse(arguments[first + 1], endDate) && endDate.checkValidity();
+    };
+    const char *intervalNames[] = {"daily", "weekly", "monthly", "yearly"};
+    Date startDate, endDate;
+    if (arguments.size() == 4 && arguments[1] == "summary" && parseDates(2, startDate, endDate))
+    {
+        writeGroupSummaryReport(std::cout, arguments[0], groupMembers(arguments[0]), startDate, endDate, currency);
+        return 0;
+    }
+    if ((arguments.size() == 3 || (arguments.size() == 5 && parseDates(3, startDate, endDate))) && arguments[1] == "category")
+    {
+        writeGroupCategoryReport(std::cout, arguments[0], groupMembers(arguments[0]), arguments[2], arguments.size() == 5, startDate, endDate, currency);
+        return 0;
+    }
+    if ((arguments.size() == 5 || arguments.size() == 6) && arguments[1] == "timeseries" && parseDates(2, startDate, endDate))
+    {
+        for (int interval = DAILY; interval <= YEARLY; ++interval)
+        {
+            if (arguments[4] == intervalNames[interval])
+            {
+                size_t window = arguments.size() == 6 ? std::stoul(arguments[5]) : 3;
+                writeGroupTimeSeriesReport(std::cout, arguments[0], groupMembers(arguments[0]), startDate, endDate,
+                                           static_cast<TimeInterval>(interval), window, currency);
+                return 0;
+            }
+        }
+    }
+    std::cout << "Usage: group-report <group> summary dd/mm/yyyy dd/mm/yyyy [--currency CODE]" << std::endl;
+    std::cout << "       group-report <group> category <category> [dd/mm/yyyy dd/mm/yyyy] [--currency CODE]" << std::endl;
+    std::cout << "       group-report <group> timeseries dd/mm/yyyy dd/mm/yyyy daily|weekly|monthly|yearly [window] [--currency CODE]" << std::endl;
+    return 1;
+}
+
+// Integrity check
+// "fsck" checks the data folder while no one is logged in: that users.txt lists every user file once, that every
+// user file is whole (its checksum) and well formed, that its stored balance and monthly totals agree with its
+// transactions, that the archive segments agree with their footers and that the journals can be replayed. Users
+// are checked in parallel. With --repair, user files are rewritten from what could be read, users.txt and
+// groups.txt are corrected and files that belong to no user are removed, e.g.
+//     myFinanceManager fsck --threads 16
+//     myFinanceManager fsck --repair
+
+// This function lists the names of the files in a folder.
+std::vector<std::string> listFolder(const std::string &folder)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    struct _finddata_t found;
+    intptr_t handle = _findfirst((folder + "/*").c_str(), &found);
+    if (handle != -1)
+    {
+        do
+        {
+            if (!(found.attrib & _A_SUBDIR))
+            {
+                names.push_back(found.name);
+            }
+        } while (_findnext(handle, &found) == 0);
+        _findclose(handle);
+    }
+#else
+    DIR *directory = opendir(folder.c_str());
+    if (directory)
+    {
+        while (struct dirent *entry = readdir(directory))
+        {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..")
+            {
+                names.push_back(name);
+            }
+        }
+        closedir(directory);
+    }
+#endif
+    return names;
+}
+
+bool endsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// This struct is the outcome of checking the files of one user.
+struct UserCheck
+{
+    std::vector<std::string> problems;
+    bool repairable;                       // Whether rewriting the user file from what was read fixes every problem
+    bool repaired;
+    std::vector<std::string> archivePaths; // Archive segments the user file names
+
+    UserCheck() : repairable(true), repaired(false) {}
+};
+
+// This function finds the key, the encrypted password and the line with the username in the header of a user file.
+// Keys made by older versions could contain line breaks, as can the password they encrypted, which moves the
+// username further down; since the key is as long as the username, the two can still be told apart. Both are taken
+// from the bytes of the file as they are, with any '\r' in them. Returns false if the header is damaged or names
+// another user.
+bool splitUserFileHeader(const std::string &username, const std::string &contents, const std::vector<TextLine> &lines,
+                         std::string &key, std::string &encryptedPassword, size_t &usernameLine)
+{
+    const size_t MAX_HEADER_LINES = 100;
+    for (usernameLine = 2; usernameLine < lines.size() && usernameLine < MAX_HEADER_LINES; ++usernameLine)
+    {
+        if (!lines[usernameLine].equals(username.c_str()))
+        {
+            continue;
+        }
+        if (usernameLine == 2)
+        {
+            key.assign(lines[0].begin, lines[1].begin - 1); // Up to the line break, unlike lines[0]
+            encryptedPassword.assign(lines[1].begin, lines[2].begin - 1);
+            return true;
+        }
+        std::string header(contents.data(), lines[usernameLine].begin - 1); // Key and encrypted password, with the line breaks in them
+        if (header.size() > username.size() && header[username.size()] == '\n')
+        {
+            key = header.substr(0, username.size());
+            encryptedPassword = header.substr(username.size() + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// This function checks the user file, journal and archive segments of a user and, if repair is set and rewriting
+// the user file from what could be read fixes every problem found, rewrites it.
+UserCheck checkUser(const std::string &username, bool repair)
+{
+    UserCheck check;
+    std::string contents;
+    if (!readFileBlocks("data/" + username + ".txt", contents))
+    {
+        check.problems.push_back("The user file cannot be read.");
+        check.repairable = false;
+        return check;
+    }
+    std::vector<TextLine> lines = splitLines(contents.data(), contents.data() + contents.size());
+    for (const auto &line : lines)
+    {
+        int32_t year;
+        uint64_t generation;
+        if (line.startsWith("Archive ") && ArchiveSegment::parseReference(line.toString(), year, generation))
+        {
+            check.archivePaths.push_back(ArchiveSegment::pathFor(username, year, generation));
+        }
+    }
+    std::string key, encryptedPassword;
+    size_t usernameLine;
+    if (!splitUserFileHeader(username, contents, lines, key, encryptedPassword, usernameLine))
+    {
+        check.problems.push_back("The header is damaged or names another user.");
+        check.repairable = false;
+        return check;
+    }
+    if (usernameLine != 2)
+    {
+        check.problems.push_back("The key or the encrypted password contains a line break.");
+    }
+    std::string header = key + "\n" + encryptedPassword + "\n";
+    if (lines[usernameLine].begin != contents.data() + header.size() || contents.compare(0, header.size(), header) != 0)
+    {
+        check.problems.push_back("The key and the encrypted password cannot be read back exactly.");
+        check.repairable = false; // Rewriting would encrypt a password that may be wrong
+    }
+    if (lines.back().startsWith("Checksum "))
+    {
+        uint64_t stored = std::strtoull(lines.back().toString().c_str() + std::strlen("Checksum "), nullptr, 16);
+        if (updateChecksum(CHECKSUM_SEED, contents.data(), static_cast<size_t>(lines.back().begin - contents.data())) != stored)
+        {
+            check.problems.push_back("The checksum does not match: the file was changed outside the application or is damaged.");
+        }
+    }
+    else
+    {
+        check.problems.push_back("The file has no checksum; it was written before checksums were added.");
+    }
+    Money storedBalance;
+    bool hasBalance = usernameLine + 1 < lines.size() && Money::parse(lines[usernameLine + 1].begin, lines[usernameLine + 1].end, storedBalance);
+    if (!hasBalance)
+    {
+        check.problems.push_back("The stored balance is missing or not an amount.");
+    }
+
+    const char *records = usernameLine + 2 < lines.size() ? lines[usernameLine + 2].begin : contents.data() + contents.size();
+    std::unique_ptr<User> user(new User(username, decryptPassword(encryptedPassword, key)));
+    bool totalsMatch;
+    try
+    {
+        totalsMatch = loadTransactions(records, contents.data() + contents.size(), user.get(), 1); // The users are checked in parallel instead
+    }
+    catch (const FinancialException &e)
+    {
+        check.problems.push_back(e.what());
+        check.repairable = false;
+        return check;
+    }
+    if (hasBalance && storedBalance != user->getStoredBalance())
+    {
+        std::ostringstream problem;
+        problem << "The stored balance " << storedBalance << " does not match the transactions.";
+        check.problems.push_back(problem.str());
+    }
+    if (!totalsMatch || !user->recomputeRollups()) // The first fails if the totals were not taken over, the second if they were but are wrong
+    {
+        check.problems.push_back("The stored monthly totals do not match the transactions.");
+    }
+    for (const auto &segment : user->getArchiveSegments())
+    {
+        if (!segment.verify())
+        {
+            check.problems.push_back("The archive " + segment.path + " is damaged or does not match its totals.");
+            check.repairable = false;
+        }
+    }
+    try
+    {
+        loadJournal(username, user.get());
+    }
+    catch (const FinancialException &e)
+    {
+        check.problems.push_back(std::string("The journal is damaged: ") + e.what());
+        check.repairable = false;
+    }
+    if (repair && !check.problems.empty() && check.repairable)
+    {
+        saveUserData(*user); // With a new key, the balance and totals recomputed, the journal applied and a checksum
+        check.repaired = true;
+    }
+    return check;
+}
+
+// This struct is a problem of the data folder as a whole: of users.txt, groups.txt or a file that belongs to no user.
+struct FolderProblem
+{
+    std::string description;
+    std::function<void()> repair; // Empty if it cannot be repaired
+};
+
+// This function handles "fsck [--repair] [--threads N]".
+int fsckCommand(const std::vector<std::string> &args)
+{
+    bool repair = false;
+    size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "--repair")
+        {
+            repair = true;
+        }
+        else if (args[i] == "--threads" && i + 1 < args.size())
+        {
+            threadCount = std::max<size_t>(std::stoul(args[++i]), 1);
+        }
+        else
+        {
+            std::cout << "Usage: fsck [--repair] [--threads N]" << std::endl;
+            return 1;
+        }
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::vector<FolderProblem> folderProblems;
+
+    // 1. The registry and the files in the data folder
+    std::vector<std::string> registry; // users.txt as it should be
+    std::set<std::string> registered;
+    bool registryChanged = false;
+    {
+        std::ifstream file("data/users.txt");
+        for (std::string line; std::getline(file, line);)
+        {
+            if (line.empty() || !registered.insert(line).second)
+            {
+                registryChanged = true;
+                continue;
+            }
+            registry.push_back(line);
+        }
+    }
+    if (registryChanged)
+    {
+        folderProblems.push_back(FolderProblem{"users.txt has empty or repeated lines.", []() {}});
+    }
+    std::set<std::string> userFiles, journals, archives, temporaryFiles;
+    for (const auto &name : listFolder("data"))
+    {
+        if (endsWith(name, ".tmp"))
+            temporaryFiles.insert(name);
+        else if (endsWith(name, ".journal"))
+            journals.insert(name.substr(0, name.size() - std::strlen(".journal")));
+        else if (endsWith(name, ".archive"))
+            archives.insert("data/" + name);
+        else if (endsWith(name, ".txt") && name != "users.txt" && name != "groups.txt" && name != "rates.txt" && name != "temp.txt")
+            userFiles.insert(name.substr(0, name.size() - std::strlen(".txt")));
+    }
+    std::vector<std::string> usernames; // The users to check: the registered ones with a user file, then the others
+    for (const auto &username : registry)
+    {
+        if (userFiles.count(username))
+        {
+            usernames.push_back(username);
+        }
+        else
+        {
+            folderProblems.push_back(FolderProblem{username + " is listed in users.txt but has no user file.", [username]()
+                                                   { removeFromGroups(username); }});
+            registryChanged = true; // users.txt is rewritten without the user
+        }
+    }
+    size_t registeredCount = usernames.size();
+    for (const auto &username : userFiles)
+    {
+        if (!registered.count(username))
+        {
+            usernames.push_back(username);
+        }
+    }
+
+    // 2. The users, in parallel
+    std::vector<UserCheck> checks(usernames.size());
+    std::atomic<size_t> usersDone(0);
+    {
+        WorkStealingPool pool(threadCount);
+        std::cout << "Checking " << usernames.size() << " users on " << pool.size() << " threads..." << std::endl;
+        for (size_t i = 0; i < usernames.size(); ++i)
+        {
+            pool.submit([&, i]()
+                        {
+                            try
+                            {
+                                checks[i] = checkUser(usernames[i], repair && i < registeredCount);
+                            }
+                            catch (const std::exception &e)
+                            {
+                                checks[i].problems.push_back(e.what());
+                                checks[i].repairable = false;
+                            }
+                            ++usersDone; });
+        }
+        while (!pool.waitFor(std::chrono::milliseconds(500)))
+        {
+            std::cout << "\rChecked " << usersDone << "/" << usernames.size() << " users" << std::flush;
+        }
+    }
+    std::cout << "\rChecked " << usersDone << "/" << usernames.size() << " users" << std::endl;
+
+    // 3. Files that belong to no user, and unregistered user files that can be registered
+    std::set<std::string> referencedArchives;
+    for (size_t i = 0; i < usernames.size(); ++i)
+    {
+        referencedArchives.insert(checks[i].archivePaths.begin(), checks[i].archivePaths.end());
+        if (i >= registeredCount)
+        {
+            const std::string &username = usernames[i];
+            bool isUserFile = checks[i].problems.empty() || checks[i].repairable;
+            folderProblems.push_back(FolderProblem{"data/" + username + ".txt is not listed in users.txt.",
+                                                   isUserFile ? std::function<void()>([&registry, &registryChanged, &checks, &usernames, i, repair]()
+                                                                                      {
+                                                                                          checks[i] = checkUser(usernames[i], repair); // Repair it like a registered user
+                                                                                          registry.push_back(usernames[i]);
+                                                                                          registryChanged = true; })
+                                                              : std::function<void()>()});
+        }
+    }
+    for (const auto &username : journals)
+    {
+        if (!userFiles.count(username))
+        {
+            std::string path = "data/" + username + ".journal";
+            folderProblems.push_back(FolderProblem{path + " belongs to no user file.", [path]()
+                                                   { std::remove(path.c_str()); }});
+        }
+    }
+    for (const auto &path : archives)
+    {
+        if (!referencedArchives.count(path))
+        {
+            folderProblems.push_back(FolderProblem{path + " is not named in any user file.", [path]()
+                                                   { std::remove(path.c_str()); }});
+        }
+    }
+    for (const auto &name : temporaryFiles)
+    {
+        std::string path = "data/" + name;
+        folderProblems.push_back(FolderProblem{path + " was left behind by a save that did not finish.", [path]()
+                                               { std::remove(path.c_str()); }});
+    }
+    try
+    {
+        loadGroups();
+        for (const auto &group : groups)
+        {
+            for (const auto &member : group.second)
+            {
+                if (!registered.count(member) || !userFiles.count(member))
+                {
+                    folderProblems.push_back(FolderProblem{"Group " + group.first + " has " + member + ", who is not a user.", [member]()
+                                                           { removeFromGroups(member); }});
+                }
+            }
+        }
+    }
+    catch (const FinancialException &e)
+    {
+        folderProblems.push_back(FolderProblem{e.what(), std::function<void()>()});
+    }
+
+    // 4. Repairs of the folder, then the report
+    size_t folderRepaired = 0;
+    for (auto &problem : folderProblems)
+    {
+        std::cout << problem.description;
+        if (repair && problem.repair)
+        {
+            problem.repair();
+            ++folderRepaired;
+            std::cout << " Repaired.";
+        }
+        std::cout << std::endl;
+    }
+    if (repair && registryChanged)
+    {
+        std::ofstream file("data/users.txt.tmp");
+        for (const auto &username : registry)
+        {
+            if (userFiles.count(username))
+            {
+                file << username << "\n";
+            }
+        }
+        file.close();
+        std::remove("data/users.txt"); // Windows does not rename over an existing file
+        if (!file || std::rename("data/users.txt.tmp", "data/users.txt") != 0)
+        {
+            throw FinancialException("Error repairing users.txt: The file cannot be replaced.");
+        }
+    }
+    size_t usersWithProblems = 0, usersRepaired = 0;
+    for (size_t i = 0; i < usernames.size(); ++i)
+    {
+        for (const auto &problem : checks[i].problems)
+        {
+            std::cout << usernames[i] << ": " << problem << (checks[i].repaired ? " Repaired." : "") << std::endl;
+        }
+        usersWithProblems += !checks[i].problems.empty();
+        usersRepaired += checks[i].repaired;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Users checked: " << usernames.size() << std::endl;
+    std::cout << "Users with problems: " << usersWithProblems << " (" << usersRepaired << " repaired)" << std::endl;
+    std::cout << "Problems with the data folder: " << folderProblems.size() << " (" << folderRepaired << " repaired)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3) << "Elapsed: " << seconds << " s" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    if (!repair && (usersWithProblems > 0 || !folderProblems.empty()))
+    {
+        std::cout << "Run \"fsck --repair\" to repair what can be repaired." << std::endl;
+    }
+    return usersWithProblems == usersRepaired && folderProblems.size() == folderRepaired ? 0 : 1;
+}
+
+int runCommand(const std::string &command, const std::vector<std::string> &args);
+
+// This function handles "stats [--dump FILE] <command> [arguments]": it runs another command, then prints how long
+// its operations took and what they read, wrote, allocated and scanned, and writes the same as JSON to FILE if given.
+int statsCommand(const std::vector<std::string> &args)
+{
+    size_t first = 0;
+    std::string dumpPath;
+    if (args.size() >= 2 && args[0] == "--dump")
+    {
+        dumpPath = args[1];
+        first = 2;
+    }
+    if (first >= args.size())
+    {
+        std::cout << "Usage: stats [--dump FILE] <command> [arguments]" << std::endl;
+        return 1;
+    }
+    int status = runCommand(args[first], std::vector<std::string>(args.begin() + first + 1, args.end()));
+    std::cout << "--------------------------------------" << std::endl;
+    printStats(std::cout);
+    if (!dumpPath.empty())
+    {
+        dumpStats(dumpPath);
+    }
+    return status;
+}
+
+// This function runs one of the command line tools and returns its exit code.
+int runCommand(const std::string &command, const std::vector<std::string> &args)
+{
+    if (command == "batch-reports")
+    {
+        return batchReportsCommand(args);
+    }
+    if (command == "generate-data")
+    {
+        return generateDataCommand(args);
+    }
+    if (command == "bench")
+    {
+        return benchCommand(args);
+    }
+    if (command == "stats")
+    {
+        return statsCommand(args);
+    }
+    if (command == "archive")
+    {
+        return archiveCommand(args);
+    }
+    if (command == "import")
+    {
+        return importCommand(args);
+    }
+    if (command == "dedupe")
+    {
+        return dedupeCommand(args);
+    }
+    if (command == "group")
+    {
+        return groupCommand(args);
+    }
+    if (command == "group-report")
+    {
+        return groupReportCommand(args);
+    }
+    if (command == "fsck")
+    {
+        return fsckCommand(args);
+    }
+    std::cout << "Unknown command: " << command << std::endl;
+    return 1;
+}
+
+// Terminal output
+// The menus are written through TerminalRenderer, which takes the place of the stream buffer of std::cout. Output is
+// collected and sent in a single write when the program waits for input (std::cin is tied to a stream that triggers
+// this) instead of at every std::endl. When stdout is a terminal, clearTerminal starts a new screen with ANSI control
+// sequences instead of running "clear": when the screen is next shown it is compared line by line with the one on
+// display and only the lines that differ are rewritten. When stdout is not a terminal the output is passed on as is.
+
+const size_t TERMINAL_BUFFER_LIMIT = 1 << 16; // Output is written early once this many bytes are waiting
+
+class TerminalRenderer : public std::streambuf
+{
+private:
+    // This class is the stream buffer of the stream std::cin is tied to. Flushing it, as std::cin does before it
+    // reads, shows the pending output.
+    class InputTrigger : public std::streambuf
+    {
+    private:
+        TerminalRenderer &renderer;
+
+    protected:
+        int sync() override
+        {
+            renderer.present();
+            return 0;
+        }
+
+    public:
+        explicit InputTrigger(TerminalRenderer &renderer) : renderer(renderer) {}
+    };
+
+    std::string pending;            // Output not written yet
+    bool interactive;               // Set if stdout is a terminal that understands ANSI control sequences
+    bool newScreen;                 // Set by clear: pending holds a whole screen, from the top
+    std::vector<std::string> shown; // The lines on display; the cursor is on the last one
+    bool shownKnown;                // False once shown may differ from the display, e.g. after scrolling
+    InputTrigger trigger;
+    std::ostream triggerStream;
+    std::streambuf *original; // The stream buffer of std::cout before install, nullptr if not installed
+
+    static std::vector<std::string> splitScreenLines(const std::string &text) // The last line is the one the cursor ends on
+    {
+        std::vector<std::string> lines(1);
+        for (char c : text)
+        {
+            if (c == '\n')
+                lines.push_back(std::string());
+            else
+                lines.back().push_back(c);
+        }
+        return lines;
+    }
+
+    static void terminalSize(size_t &rows, size_t &columns)
+    {
+        rows = 24;
+        columns = 80;
+#ifndef _WIN32
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)
+        {
+            rows = size.ws_row > 0 ? size.ws_row : rows;
+            columns = size.ws_col > 0 ? size.ws_col : columns;
+        }
+#endif
+    }
+
+    static size_t displayWidth(const std::string &line) // Columns the line takes, one per character of UTF-8 text
+    {
+        size_t width = 0;
+        for (char c : line)
+        {
+            width += (static_cast<unsigned char>(c) & 0xC0) != 0x80; // Continuation bytes take no column of their own
+        }
+        return width;
+    }
+
+    // Whether every line takes a single row of the terminal. A longer line wraps onto the rows below it, and the
+    // lines are then no longer the rows they are shown on.
+    static bool fitsRows(std::vector<std::string>::const_iterator first, std::vector<std::string>::const_iterator last, size_t columns)
+    {
+        return std::all_of(first, last, [columns](const std::string &line)
+                           { return displayWidth(line) <= columns; });
+    }
+
+    static void writeAll(const std::string &text)
+    {
+#ifdef _WIN32
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::fflush(stdout);
+#else
+        for (size_t written = 0; written < text.size();)
+        {
+            ssize_t result = ::write(STDOUT_FILENO, text.data() + written, text.size() - written);
+            if (result < 0 && errno == EINTR)
+                continue;
+            if (result <= 0)
+                return; // Nothing can be shown; the output is dropped
+            written += static_cast<size_t>(result);
+        }
+#endif
+        STAT_ADD(STAT_BYTES_WRITTEN, text.size());
+    }
+
+    // Returns the control sequences that turn the display into screen, rewriting only the lines that changed, and
+    // leave the cursor at the end of its last line. Everything is redrawn if the display is not known, the screen
+    // does not fit or one of its lines is wider than the terminal and wraps.
+    std::string redraw(const std::string &screen)
+    {
+        std::vector<std::string> lines = splitScreenLines(screen);
+        size_t rows, columns;
+        terminalSize(rows, columns);
+        bool fits = lines.size() < rows && fitsRows(lines.begin(), lines.end(), columns);
+        std::string out;
+        if (!shownKnown || !fits)
+        {
+            out = "\x1b[H\x1b[2J" + screen;
+            shownKnown = fits;
+        }
+        else
+        {
+            for (size_t i = 0; i < lines.size(); ++i)
+            {
+                if (i >= shown.size() || shown[i] != lines[i])
+                {
+                    out += "\x1b[" + std::to_string(i + 1) + ";1H" + lines[i] + "\x1b[K";
+                }
+            }
+            if (shown.size() > lines.size())
+            {
+                out += "\x1b[" + std::to_string(lines.size() + 1) + ";1H\x1b[J"; // Erase what is left below
+            }
+            out += "\x1b[" + std::to_string(lines.size()) + ";" + std::to_string(displayWidth(lines.back()) + 1) + "H";
+        }
+        shown.swap(lines);
+        return out;
+    }
+
+    void writePending() // Write the pending output, keeping track of what is on display
+    {
+        if (pending.empty() && !newScreen)
+        {
+            return;
+        }
+        if (interactive && newScreen)
+        {
+            pending = redraw(pending);
+            newScreen = false;
+        }
+        else if (interactive && shownKnown)
+        {
+            std::vector<std::string> lines = splitScreenLines(pending);
+            size_t changed = shown.size() - 1; // The line the cursor is on and the ones added after it
+            shown.back() += lines[0];
+            shown.insert(shown.end(), lines.begin() + 1, lines.end());
+            size_t rows, columns;
+            terminalSize(rows, columns);
+            shownKnown = shown.size() < rows && fitsRows(shown.begin() + changed, shown.end(), columns);
+        }
+        writeAll(pending);
+        pending.clear();
+    }
+
+protected:
+    int overflow(int c) override
+    {
+        if (c != traits_type::eof())
+        {
+            pending.push_back(static_cast<char>(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *text, std::streamsize count) override
+    {
+        pending.append(text, static_cast<size_t>(count));
+        if (pending.size() >= TERMINAL_BUFFER_LIMIT && !newScreen) // A long listing; a screen waits for input
+        {
+            writePending();
+        }
+        return count;
+    }
+
+    int sync() override // std::endl and std::flush leave the output pending; present writes it
+    {
+        return 0;
+    }
+
+public:
+    TerminalRenderer() : interactive(false), newScreen(false), shown(1), shownKnown(false), trigger(*this), triggerStream(&trigger), original(nullptr) {}
+
+    ~TerminalRenderer()
+    {
+        uninstall();
     }
-    // Remove user from the set of users
-    users.erase(it);
-    // Delete user file
-    std::remove(("data/" + username + ".txt").c_str());
-    // remove user from users.txt
-    std::ifstream file("data/users.txt");             // Open users.txt
-    std::ofstream temp("data/temp.txt");              // Create temp.txt
-    for (std::string line; std::getline(file, line);) // Read users.txt line by line and write to temp.txt, except for the line containing the username
+
+    void install() // Route std::cout through the renderer
     {
-        if (line != username)
+        if (original)
         {
-            temp << line << std::endl;
+            return;
         }
+#ifndef _WIN32
+        interactive = isatty(STDOUT_FILENO) == 1;
+        const char *term = std::getenv("TERM");
+        interactive = interactive && term && std::string(term) != "dumb";
+#endif
+        original = std::cout.rdbuf(this);
+        std::cin.tie(&triggerStream);
     }
-    file.close();
-    temp.close();
-    std::remove("data/users.txt");                  // Delete users.txt
-    std::rename("data/temp.txt", "data/users.txt"); // Rename temp.txt to users.txt, effectively removing the user from users.txt
-    return nullptr;
-}
 
-void login(const std::string &username, const std::string &password, User *&user)
-{
-    // Check if user exists
-    auto it = users.find(username);
-    if (it == users.end())
+    void uninstall() // Write what is pending and give std::cout its stream buffer back
     {
-        throw FinancialException("User does not exist."); // Throw exception if user does not exist
+        if (!original)
+        {
+            return;
+        }
+        writePending();
+        std::cout.rdbuf(original);
+        std::cin.tie(&std::cout);
+        original = nullptr;
     }
-    // Load user data, if password is wrong add option to change password,try again or exit
-    int status = loadUserData(username, password, user);
-    if (status == -1)
+
+    // Write the pending output before the program waits for input. What the user then types is echoed by the
+    // terminal, so the line of the prompt is no longer known, and the cursor moves to the start of the next line.
+    void present()
     {
-        throw FinancialException("Invalid username."); // Throw exception if username is wrong
+        writePending();
+        if (interactive)
+        {
+            shown.back().push_back('\0'); // No line written by the program has a NUL, so this line is always redrawn
+            shown.push_back(std::string());
+            size_t rows, columns;
+            terminalSize(rows, columns);
+            shownKnown = shownKnown && shown.size() < rows && displayWidth(shown[shown.size() - 2]) < columns;
+        }
     }
-    else if (status == -2)
+
+    void clear() // Start a new screen; on a terminal, output that was not shown yet would be cleared away at once
     {
-        throw FinancialException("Invalid password."); // Throw exception if password is wrong
+        if (interactive)
+        {
+            pending.clear();
+            newScreen = true;
+        }
     }
-    std::cout << "User " << username << " logged in successfully." << std::endl;
+};
+
+TerminalRenderer &terminal() // The renderer of the interactive menus
+{
+    static TerminalRenderer renderer;
+    return renderer;
 }
 
 // User Interface Functions
@@ -726,6 +9115,16 @@ void userMenu()
     std::cout << "8. Generate Category Report" << std::endl;
     std::cout << "9. Logout" << std::endl;
     std::cout << "0. Delete Account" << std::endl;
+    std::cout << "A. Generate Time Series Report" << std::endl;
+    std::cout << "B. Edit Income/Expense" << std::endl;
+    std::cout << "C. Search Transactions" << std::endl;
+    std::cout << "D. Query Transactions" << std::endl;
+    std::cout << "E. Recurring Transactions" << std::endl;
+    std::cout << "F. Budgets" << std::endl;
+    std::cout << "G. Statistics" << std::endl;
+    std::cout << "H. Import Transactions" << std::endl;
+    std::cout << "I. Find Duplicates" << std::endl;
+    std::cout << "J. Forecast" << std::endl;
     std::cout << "#. Exit" << std::endl;
 }
 
@@ -734,9 +9133,10 @@ void userMenu()
 void clearTerminal()
 {
 #ifdef _WIN32
+    terminal().present();
     system("cls"); // For Windows
 #else
-    system("clear"); // For Unix-like systems
+    terminal().clear(); // For Unix-like systems
 #endif
 }
 
@@ -809,30 +9209,106 @@ void help()
     std::cin.ignore();
 }
 
+// Function to print the budget alerts raised by the last change of the user logged in
+void showBudgetAlerts(User *&user)
+{
+    for (const auto &alert : user->takeBudgetAlerts())
+    {
+        std::cout << "!! " << alert << std::endl;
+    }
+}
+
+// This function prints a transaction as the menus list it, after its id. Occurrences of recurring transactions
+// have no id and cannot be edited or removed, so they are shown with their date instead.
+void printTransaction(const Transaction *transaction)
+{
+    if (transaction->getId() == 0)
+    {
+        std::cout << "Recurring, " << transaction->getDate() << ": ";
+    }
+    else
+    {
+        std::cout << "ID " << transaction->getId() << ": ";
+    }
+    transaction->display();
+}
+
+// Function to warn about transactions of the user logged in that are duplicates of a new one. Returns whether the
+// new transaction should be added anyway; it is deleted if not.
+bool confirmDuplicates(User *&user, Transaction *transaction)
+{
+    std::vector<const Transaction *> duplicates = user->findDuplicates(transaction);
+    if (duplicates.empty())
+    {
+        return true;
+    }
+    std::cout << "This looks like a duplicate of:" << std::endl;
+    for (const auto &duplicate : duplicates)
+    {
+        printTransaction(duplicate);
+    }
+    std::cout << "Add it anyway? (y/n): ";
+    std::string choice;
+    std::getline(std::cin, choice);
+    if (choice == "y" || choice == "Y")
+    {
+        return true;
+    }
+    delete transaction;
+    std::cout << "The transaction was not added." << std::endl;
+    return false;
+}
+
+// This function asks for a currency when exchange rates are configured, otherwise every amount is in BDT
+Currency readCurrency(const std::string &prompt)
+{
+    if (exchangeRates.empty())
+    {
+        return BASE_CURRENCY;
+    }
+    std::cout << prompt << " (leave empty for " << BASE_CURRENCY.toString() << "): ";
+    std::string currencyString;
+    std::getline(std::cin, currencyString);
+    Currency currency;
+    if (!currencyString.empty() &&
+        (!Currency::parse(currencyString, currency) || !exchangeRates.has(currency)))
+    {
+        throw FinancialException("Unknown currency: " + currencyString); // No exchange rate for the currency
+    }
+    return currency;
+}
+
 // Function to add income to the user logged in
 void addIncome(User *&user)
 {
     std::string amountString, description;
-    double amount;
+    Money amount;
     std::cout << "Enter amount: ";
     std::getline(std::cin, amountString);
-    amount = std::stod(amountString);
+    if (!Money::parse(amountString, amount))
+    {
+        throw FinancialException("Invalid amount."); // Throw exception if amount is not a number
+    }
+    Currency currency = readCurrency("Enter currency");
     std::cout << "Enter description: ";
     std::getline(std::cin, description);
     std::cout << "Enter date (dd/mm/yyyy): ";
     std::string dateString;
     std::getline(std::cin, dateString);
-    int day, month, year;
-    sscanf(dateString.c_str(), "%d/%d/%d", &day, &month, &year);
-    Date date(day, month, year);
-    if (!date.checkValidity()) // Check if date is valid
+    Date date;
+    if (!Date::parse(dateString, date) || !date.checkValidity()) // Check if date is valid
     {
         std::cout << "Invalid date!" << std::endl; // Throw exception if date is invalid
         std::cout << "Press enter to continue..." << std::endl;
         std::cin.ignore();
         return;
     }
-    user->addTransaction(new Income(amount, description, date)); // Add income transaction
+    Income *income = new Income(amount, description, date);
+    income->setCurrency(currency);
+    if (confirmDuplicates(user, income))
+    {
+        user->addTransaction(income); // Add income transaction
+    }
     std::cout << "Press enter to continue..." << std::endl;
     std::cin.ignore();
 }
@@ -841,75 +9317,594 @@ void addIncome(User *&user)
 void addExpense(User *&user)
 {
     std::string amountString, description, categoryName;
-    double amount;
+    Money amount;
     std::cout << "Enter amount: ";
     std::getline(std::cin, amountString);
-    amount = std::stod(amountString);
+    if (!Money::parse(amountString, amount))
+    {
+        throw FinancialException("Invalid amount."); // Throw exception if amount is not a number
+    }
+    Currency currency = readCurrency("Enter currency");
     std::cout << "Enter description: ";
     std::getline(std::cin, description);
     std::cout << "Enter date (dd/mm/yyyy): ";
     std::string dateString;
     std::getline(std::cin, dateString);
-    int day, month, year;
-    sscanf(dateString.c_str(), "%d/%d/%d", &day, &month, &year);
-    Date date(day, month, year);
-    if (!date.checkValidity()) // Check if date is valid
+    Date date;
+    if (!Date::parse(dateString, date) || !date.checkValidity()) // Check if date is valid
     {
         std::cout << "Invalid date!" << std::endl; // Throw exception if date is invalid
         std::cout << "Press enter to continue..." << std::endl;
         std::cin.ignore();
         return;
     }
-    std::cout << "Enter category: ";
-    std::getline(std::cin, categoryName);
-    Category category(categoryName);
-    user->addTransaction(new Expense(amount, description, date, category)); // Add expense transaction
-    std::cout << "Press enter to continue..." << std::endl;
+    std::cout << "Enter category: ";
+    std::getline(std::cin, categoryName);
+    Category category(categoryName);
+    Expense *expense = new Expense(amount, description, date, category);
+    expense->setCurrency(currency);
+    if (confirmDuplicates(user, expense))
+    {
+        user->addTransaction(expense); // Add expense transaction
+        showBudgetAlerts(user);
+    }
+    std::cout << "Press enter to continue..." << std::endl;
+    std::cin.ignore();
+}
+
+// This function parses an id typed by the user. Returns false if text is not a whole non-negative number.
+bool parseId(const std::string &text, uint64_t &id)
+{
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    if (errno == ERANGE || *end != '\0')
+    {
+        return false;
+    }
+    id = value;
+    return true;
+}
+
+// Function to remove income or expense transactions of the user logged in, by id
+void removeIncome(User *&user)
+{
+    std::string idsString;
+    std::cout << "Enter IDs of income/expense to remove (separated by spaces): ";
+    std::getline(std::cin, idsString);
+    std::istringstream idsStream(idsString);
+    std::vector<uint64_t> ids;
+    for (std::string idString; idsStream >> idString;)
+    {
+        uint64_t id;
+        if (!parseId(idString, id))
+        {
+            std::cout << "Invalid ID: " << idString << std::endl; // Skipped; the other IDs are still removed
+            continue;
+        }
+        ids.push_back(id);
+    }
+    size_t removed = user->removeTransactions(ids);
+    std::cout << removed << " of " << ids.size() << " transactions removed." << std::endl;
+    std::cout << "Press enter to continue..." << std::endl;
+    std::cin.ignore();
+}
+
+// Function to edit an income or expense transaction of the user logged in, by id
+void editIncome(User *&user)
+{
+    std::string idString;
+    std::cout << "Enter ID of income/expense to edit: ";
+    std::getline(std::cin, idString);
+    uint64_t id;
+    if (!parseId(idString, id))
+    {
+        std::cout << "Invalid ID." << std::endl;
+        return;
+    }
+    const Transaction *transaction = user->findTransaction(id);
+    if (!transaction)
+    {
+        std::cout << "No transaction with this ID." << std::endl;
+        return;
+    }
+    const Expense *expenseTransaction = dynamic_cast<const Expense *>(transaction);
+    transaction->display();
+    std::cout << "Leave a field empty to keep its current value." << std::endl;
+
+    std::string amountString, description, dateString, categoryName;
+    Money amount = transaction->getAmount();
+    std::cout << "Enter amount (" << amount << "): ";
+    std::getline(std::cin, amountString);
+    if (!amountString.empty() && !Money::parse(amountString, amount))
+    {
+        throw FinancialException("Invalid amount."); // Throw exception if amount is not a number
+    }
+    description = transaction->getDescription();
+    std::cout << "Enter description (" << description << "): ";
+    std::string newDescription;
+    std::getline(std::cin, newDescription);
+    if (!newDescription.empty())
+    {
+        description = newDescription;
+    }
+    Date date = transaction->getDate();
+    std::cout << "Enter date (" << date << "): ";
+    std::getline(std::cin, dateString);
+    if (!dateString.empty() && (!Date::parse(dateString, date) || !date.checkValidity())) // Check if date is valid
+    {
+        throw FinancialException("Invalid date!");
+    }
+    if (expenseTransaction)
+    {
+        categoryName = expenseTransaction->getCategory().getName();
+        std::cout << "Enter category (" << categoryName << "): ";
+        std::string newCategoryName;
+        std::getline(std::cin, newCategoryName);
+        if (!newCategoryName.empty())
+        {
+            categoryName = newCategoryName;
+        }
+    }
+    user->editTransaction(id, amount, description, date, categoryName);
+    std::cout << "Transaction updated successfully." << std::endl;
+    showBudgetAlerts(user);
+}
+
+// Function to search the transactions of the user logged in by words of their description or category
+void searchTransactions(User *&user)
+{
+    std::string query;
+    std::cout << "Enter search words (all must match, word beginnings are enough): ";
+    std::getline(std::cin, query);
+    std::vector<const Transaction *> found = user->searchTransactions(query);
+    std::cout << found.size() << " transactions found." << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    for (const auto &transaction : found)
+    {
+        printTransaction(transaction);
+        std::cout << "--------------------------------------" << std::endl;
+    }
+}
+
+// Function to list and total the transactions of the user logged in that match several conditions
+void queryTransactions(User *&user)
+{
+    TransactionQuery query;
+    std::string line;
+    std::cout << "Enter type (i for income, e for expenses, leave empty for both): ";
+    std::getline(std::cin, line);
+    if (line == "i" || line == "I")
+    {
+        query.expenses = false;
+    }
+    else if (line == "e" || line == "E")
+    {
+        query.income = false;
+    }
+    else if (!line.empty())
+    {
+        throw FinancialException("Invalid type.");
+    }
+    std::cout << "Enter start date (dd/mm/yyyy, leave empty for all time): ";
+    std::getline(std::cin, line);
+    if (!line.empty())
+    {
+        query.hasDateRange = true;
+        std::string endDateString;
+        std::cout << "Enter end date (dd/mm/yyyy): ";
+        std::getline(std::cin, endDateString);
+        if (!Date::parse(line, query.startDate) || !query.startDate.checkValidity() ||
+            !Date::parse(endDateString, query.endDate) || !query.endDate.checkValidity()) // Check if dates are valid
+        {
+            throw FinancialException("Invalid date!");
+        }
+    }
+    std::cout << "Enter categories (separated by commas, leave empty for all): ";
+    std::getline(std::cin, line);
+    std::istringstream categoriesStream(line);
+    for (std::string categoryName; std::getline(categoriesStream, categoryName, ',');)
+    {
+        size_t first = categoryName.find_first_not_of(' ');
+        if (first != std::string::npos)
+        {
+            query.categories.push_back(categoryName.substr(first, categoryName.find_last_not_of(' ') - first + 1));
+        }
+    }
+    std::string maxAmountString;
+    std::cout << "Enter minimum amount (leave empty for none): ";
+    std::getline(std::cin, line);
+    std::cout << "Enter maximum amount (leave empty for none): ";
+    std::getline(std::cin, maxAmountString);
+    if (!line.empty() || !maxAmountString.empty())
+    {
+        query.hasAmountRange = true;
+        query.maxAmount = Money::fromMinorUnits(INT64_MAX);
+        if ((!line.empty() && !Money::parse(line, query.minAmount)) || (!maxAmountString.empty() && !Money::parse(maxAmountString, query.maxAmount)))
+        {
+            throw FinancialException("Invalid amount.");
+        }
+    }
+    std::cout << "Enter description words (leave empty for any): ";
+    std::getline(std::cin, query.text);
+
+    QueryResult result = user->query(query);
+    std::cout << "--------------------------------------" << std::endl;
+    for (const auto &transaction : result.transactions)
+    {
+        printTransaction(transaction);
+        std::cout << "--------------------------------------" << std::endl;
+    }
+    std::cout << "Transactions: " << result.count << std::endl;
+    std::cout << "Total Income: " << result.income << " " << BASE_CURRENCY.toString() << std::endl;
+    std::cout << "Total Expenses: " << result.expenses << " " << BASE_CURRENCY.toString() << std::endl;
+    std::cout << "Net: " << result.income - result.expenses << " " << BASE_CURRENCY.toString() << std::endl;
+}
+
+// Function to list, add and remove the recurring transactions of the user logged in
+void recurringTransactions(User *&user)
+{
+    const char *cadenceNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+    int32_t today = Date::today().toOrdinal();
+    for (const auto &rule : user->getRecurringRules())
+    {
+        int64_t first, last;
+        rule.occurrencesBetween(INT32_MIN, today, first, last);
+        std::cout << "ID " << rule.getId() << ": " << (rule.getType() == INCOME_TRANSACTION ? "Income: +" : "Expense: -") << rule.getAmount()
+                  << " " << BASE_CURRENCY.toString() << " - " << rule.getDescription();
+        if (rule.getType() == EXPENSE_TRANSACTION)
+        {
+            std::cout << " (" << rule.getCategoryName() << ")";
+        }
+        std::cout << std::endl;
+        std::cout << "   " << cadenceNames[rule.getCadence()] << " from " << rule.getStartDate();
+        if (rule.getHasEndDate())
+        {
+            std::cout << " to " << rule.getEndDate();
+        }
+        std::cout << ", " << last - first << " times so far" << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+    }
+    std::cout << "1. Add Recurring Transaction" << std::endl;
+    std::cout << "2. Remove Recurring Transaction" << std::endl;
+    std::cout << "Enter your choice (leave empty to go back): ";
+    std::string choice;
+    std::getline(std::cin, choice);
+    if (choice == "2")
+    {
+        std::string idString;
+        std::cout << "Enter ID of recurring transaction to remove: ";
+        std::getline(std::cin, idString);
+        std::cout << (user->removeRecurringRule(std::stoull(idString)) ? "Recurring transaction removed." : "No recurring transaction with this ID.") << std::endl;
+        return;
+    }
+    if (choice != "1")
+    {
+        return;
+    }
+
+    std::string line, amountString, description, categoryName;
+    std::cout << "Enter type (i for income, e for expense): ";
+    std::getline(std::cin, line);
+    if (line != "i" && line != "e")
+    {
+        throw FinancialException("Invalid type.");
+    }
+    TransactionType type = line == "i" ? INCOME_TRANSACTION : EXPENSE_TRANSACTION;
+    Money amount;
+    std::cout << "Enter amount: ";
+    std::getline(std::cin, amountString);
+    if (!Money::parse(amountString, amount))
+    {
+        throw FinancialException("Invalid amount."); // Throw exception if amount is not a number
+    }
+    std::cout << "Enter description: ";
+    std::getline(std::cin, description);
+    if (type == EXPENSE_TRANSACTION)
+    {
+        std::cout << "Enter category: ";
+        std::getline(std::cin, categoryName);
+    }
+    std::cout << "Enter how often it repeats (d for daily, w for weekly, m for monthly, y for yearly): ";
+    std::getline(std::cin, line);
+    size_t cadence = std::string("dwmy").find(line);
+    if (line.size() != 1 || cadence == std::string::npos)
+    {
+        throw FinancialException("Invalid choice!");
+    }
+    Date startDate, endDate;
+    std::cout << "Enter date of the first occurrence (dd/mm/yyyy): ";
+    std::getline(std::cin, line);
+    if (!Date::parse(line, startDate) || !startDate.checkValidity()) // Check if date is valid
+    {
+        throw FinancialException("Invalid date!");
+    }
+    std::cout << "Enter end date (dd/mm/yyyy, leave empty if it does not end): ";
+    std::getline(std::cin, line);
+    bool hasEndDate = !line.empty();
+    if (hasEndDate && (!Date::parse(line, endDate) || !endDate.checkValidity() || endDate < startDate))
+    {
+        throw FinancialException("Invalid date!");
+    }
+    user->addRecurringRule(RecurringRule(type, amount, description, categoryName, static_cast<TimeInterval>(cadence), startDate, hasEndDate, endDate));
+    std::cout << "Recurring transaction added successfully." << std::endl;
+}
+
+// Function to show the budget status of the user logged in and add or remove budgets
+void budgets(User *&user)
+{
+    const char *periodNames[] = {"Daily", "Weekly", "Monthly", "Yearly"};
+    const char *statusNames[] = {"OK", "WARNING", "EXCEEDED"};
+    int32_t today = Date::today().toOrdinal();
+    std::cout << std::left << std::setw(5) << "ID" << std::setw(20) << "Category" << std::setw(9) << "Period" << std::right << std::setw(14) << "Limit"
+              << std::setw(14) << "Spent" << std::setw(14) << "Remaining" << std::setw(7) << "Used" << "  Status" << std::endl;
+    for (const auto &budget : user->getBudgets()) // Status of the current period of every budget
+    {
+        Money spent = Money::fromMinorUnits(user->budgetSpent(budget, intervalBucket(today, budget.getPeriod())));
+        int64_t percent = budget.getLimit().getMinorUnits() > 0 ? spent.getMinorUnits() * 100 / budget.getLimit().getMinorUnits() : 100;
+        std::cout << std::left << std::setw(5) << budget.getId() << std::setw(20) << (budget.getCategoryName().empty() ? "(all expenses)" : budget.getCategoryName())
+                  << std::setw(9) << periodNames[budget.getPeriod()] << std::right << std::setw(14) << budget.getLimit() << std::setw(14) << spent
+                  << std::setw(14) << budget.getLimit() - spent << std::setw(6) << percent << "%  " << statusNames[budget.level(spent.getMinorUnits())] << std::endl;
+    }
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "1. Add Budget" << std::endl;
+    std::cout << "2. Remove Budget" << std::endl;
+    std::cout << "Enter your choice (leave empty to go back): ";
+    std::string choice;
+    std::getline(std::cin, choice);
+    if (choice == "2")
+    {
+        std::string idString;
+        std::cout << "Enter ID of budget to remove: ";
+        std::getline(std::cin, idString);
+        std::cout << (user->removeBudget(std::stoull(idString)) ? "Budget removed." : "No budget with this ID.") << std::endl;
+        return;
+    }
+    if (choice != "1")
+    {
+        return;
+    }
+
+    std::string categoryName, line;
+    std::cout << "Enter category (leave empty for all expenses): ";
+    std::getline(std::cin, categoryName);
+    std::cout << "Enter period (d for daily, w for weekly, m for monthly, y for yearly): ";
+    std::getline(std::cin, line);
+    size_t period = std::string("dwmy").find(line);
+    if (line.size() != 1 || period == std::string::npos)
+    {
+        throw FinancialException("Invalid choice!");
+    }
+    Money limit;
+    std::cout << "Enter limit: ";
+    std::getline(std::cin, line);
+    if (!Money::parse(line, limit) || limit <= Money())
+    {
+        throw FinancialException("Invalid amount.");
+    }
+    std::cout << "Enter percentage of the limit at which to warn (leave empty for 80): ";
+    std::getline(std::cin, line);
+    int warningPercent = line.empty() ? 80 : std::stoi(line);
+    if (warningPercent <= 0 || warningPercent > 100)
+    {
+        throw FinancialException("Invalid percentage.");
+    }
+    user->addBudget(Budget(categoryName, static_cast<TimeInterval>(period), limit, warningPercent));
+    std::cout << "Budget added successfully." << std::endl;
+}
+
+// This class writes report files on a background thread, each from a snapshot of the user, so that the menu
+// comes back at once even for long reports and the user can keep adding or removing transactions meanwhile.
+// Whether each file was written is told the next time the user menu is shown.
+class ReportExports
+{
+private:
+    std::mutex mutex;
+    std::vector<std::string> messages; // Outcome of every export finished since takeMessages was last called
+    WorkStealingPool pool;
+
+public:
+    ReportExports() : pool(1) {}
+
+    void submit(const std::string &description, std::function<void()> write) // Queue an export; description names the file
+    {
+        pool.submit([this, description, write]()
+                    {
+                        std::string message;
+                        try
+                        {
+                            write();
+                            message = description + " created successfully.";
+                        }
+                        catch (const std::exception &e)
+                        {
+                            message = description + " could not be created: " + e.what();
+                        }
+                        std::lock_guard<std::mutex> lock(mutex);
+                        messages.push_back(message); });
+    }
+
+    std::vector<std::string> takeMessages()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> taken;
+        taken.swap(messages);
+        return taken;
+    }
+};
+
+// The exports of the interactive session. Exports still queued when the application exits are finished first.
+ReportExports &reportExports()
+{
+    static ReportExports exports;
+    return exports;
+}
+
+// Function to view transactions of the user logged in
+void generateSummaryReport(User *&user)
+{
+    std::cout << "Enter start date (dd/mm/yyyy): ";
+    std::string startDateString;
+    std::getline(std::cin, startDateString);
+    Date startDate;
+    if (!Date::parse(startDateString, startDate) || !startDate.checkValidity()) // Check if date is valid
+    {
+        std::cout << "Invalid date!" << std::endl;
+        std::cout << "Press enter to continue..." << std::endl;
+        std::cin.ignore();
+        return;
+    }
+    std::cout << "Enter end date (dd/mm/yyyy): ";
+    std::string endDateString;
+    std::getline(std::cin, endDateString);
+    Date endDate;
+    if (!Date::parse(endDateString, endDate) || !endDate.checkValidity()) // Check if date is valid
+    {
+        std::cout << "Invalid date!" << std::endl;
+        std::cout << "Press enter to continue..." << std::endl;
+        std::cin.ignore();
+        return;
+    }
+    Currency currency = readCurrency("Enter report currency");
+    user->generateSummaryReport(startDate, endDate, currency);
+    std::cout << "Do you want to save the report to a file? (y/n): ";
+    char choice;
+    std::cin >> choice; // Check if user wants to save the report to a file
+    if (choice == 'y' || choice == 'Y')
+    {
+        try
+        {
+            std::shared_ptr<const User> view = user->snapshot();
+            reportExports().submit("Summary report file", [view, startDate, endDate, currency]()
+                                   { view->createSummaryReportFile(startDate, endDate, false, currency); });
+            std::cout << "The report file is being written in the background." << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+    }
+    //std::cout << "Press enter to continue..." << std::endl;
     std::cin.ignore();
 }
 
 // Function to view transactions of the user logged in
-void removeIncome(User *&user)
+void generateCategoryReport(User *&user)
 {
-    std::string indexString;
-    int index;
-    std::cout << "Enter index of income to remove: ";
-    std::getline(std::cin, indexString);
-    index = std::stoi(indexString);
-    user->removeTransaction(index);
-    std::cout << "Press enter to continue..." << std::endl;
+    std::string categoryName;
+    std::cout << "Enter category name: ";
+    std::getline(std::cin, categoryName);
+    std::cout << "Enter start date (dd/mm/yyyy, leave empty for all time): ";
+    std::string startDateString;
+    std::getline(std::cin, startDateString);
+    Date startDate, endDate;
+    bool allTime = startDateString.empty();
+    Currency currency;
+    if (!allTime)
+    {
+        if (!Date::parse(startDateString, startDate) || !startDate.checkValidity()) // Check if date is valid
+        {
+            std::cout << "Invalid date!" << std::endl;
+            return;
+        }
+        std::cout << "Enter end date (dd/mm/yyyy): ";
+        std::string endDateString;
+        std::getline(std::cin, endDateString);
+        if (!Date::parse(endDateString, endDate) || !endDate.checkValidity()) // Check if date is valid
+        {
+            std::cout << "Invalid date!" << std::endl;
+            return;
+        }
+        currency = readCurrency("Enter report currency");
+        user->generateCategoryReport(categoryName, startDate, endDate, currency);
+    }
+    else
+    {
+        currency = readCurrency("Enter report currency");
+        user->generateCategoryReport(categoryName, currency);
+    }
+    std::cout << "Do you want to save the report to a file? (y/n): ";
+    char choice;
+    std::cin >> choice; // Check if user wants to save the report to a file
+    if (choice == 'y' || choice == 'Y')
+    {
+        try
+        {
+            std::shared_ptr<const User> view = user->snapshot();
+            reportExports().submit("Category report file", [view, categoryName, allTime, startDate, endDate, currency]()
+                                   {
+                                       if (allTime)
+                                       {
+                                           view->createCategoryReportFile(categoryName, false, currency);
+                                       }
+                                       else
+                                       {
+                                           view->createCategoryReportFile(categoryName, startDate, endDate, false, currency);
+                                       } });
+            std::cout << "The report file is being written in the background." << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+    }
+    //std::cout << "Press enter to continue...";
     std::cin.ignore();
 }
 
-// Function to view transactions of the user logged in
-void generateSummaryReport(User *&user)
+// Function to generate a daily, weekly, monthly or yearly report of the user logged in
+void generateTimeSeriesReport(User *&user)
 {
     std::cout << "Enter start date (dd/mm/yyyy): ";
     std::string startDateString;
     std::getline(std::cin, startDateString);
-    int day, month, year;
-    sscanf(startDateString.c_str(), "%d/%d/%d", &day, &month, &year);
-    Date startDate(day, month, year);
-    if (!startDate.checkValidity()) // Check if date is valid
+    Date startDate;
+    if (!Date::parse(startDateString, startDate) || !startDate.checkValidity()) // Check if date is valid
     {
         std::cout << "Invalid date!" << std::endl;
-        std::cout << "Press enter to continue..." << std::endl;
-        std::cin.ignore();
         return;
     }
     std::cout << "Enter end date (dd/mm/yyyy): ";
     std::string endDateString;
     std::getline(std::cin, endDateString);
-    sscanf(endDateString.c_str(), "%d/%d/%d", &day, &month, &year);
-    Date endDate(day, month, year);
-    if (!endDate.checkValidity()) // Check if date is valid
+    Date endDate;
+    if (!Date::parse(endDateString, endDate) || !endDate.checkValidity()) // Check if date is valid
     {
         std::cout << "Invalid date!" << std::endl;
-        std::cout << "Press enter to continue..." << std::endl;
-        std::cin.ignore();
         return;
     }
-    user->generateSummaryReport(startDate, endDate);
+    std::cout << "Group by (d)ay, (w)eek, (m)onth or (y)ear: ";
+    std::string intervalString;
+    std::getline(std::cin, intervalString);
+    TimeInterval interval;
+    switch (intervalString.empty() ? 'm' : std::tolower(static_cast<unsigned char>(intervalString[0])))
+    {
+    case 'd':
+        interval = DAILY;
+        break;
+    case 'w':
+        interval = WEEKLY;
+        break;
+    case 'm':
+        interval = MONTHLY;
+        break;
+    case 'y':
+        interval = YEARLY;
+        break;
+    default:
+        std::cout << "Invalid interval!" << std::endl;
+        return;
+    }
+    std::cout << "Enter rolling average window in intervals (default 3): ";
+    std::string windowString;
+    std::getline(std::cin, windowString);
+    size_t window = windowString.empty() ? 3 : std::stoul(windowString);
+    Currency currency = readCurrency("Enter report currency");
+    user->generateTimeSeriesReport(startDate, endDate, interval, window, currency);
     std::cout << "Do you want to save the report to a file? (y/n): ";
     char choice;
     std::cin >> choice; // Check if user wants to save the report to a file
@@ -917,24 +9912,47 @@ void generateSummaryReport(User *&user)
     {
         try
         {
-            user->createSummaryReportFile(startDate, endDate);
+            std::shared_ptr<const User> view = user->snapshot();
+            reportExports().submit("Time series report file", [view, startDate, endDate, interval, window, currency]()
+                                   { view->createTimeSeriesReportFile(startDate, endDate, interval, window, false, currency); });
+            std::cout << "The report file is being written in the background." << std::endl;
         }
         catch (const std::exception &e)
         {
             std::cout << e.what() << std::endl;
         }
     }
-    //std::cout << "Press enter to continue..." << std::endl;
     std::cin.ignore();
 }
 
-// Function to view transactions of the user logged in
-void generateCategoryReport(User *&user)
+// Function to project the balance of the user logged in to the end of the month, the end of the year or a date
+void forecastReport(User *&user)
 {
-    std::string categoryName;
-    std::cout << "Enter category name: ";
-    std::getline(std::cin, categoryName);
-    user->generateCategoryReport(categoryName);
+    std::cout << "Forecast to the end of the (m)onth, the end of the (y)ear or a date (dd/mm/yyyy): ";
+    std::string endDateString;
+    std::getline(std::cin, endDateString);
+    Date today = Date::today();
+    Date endDate;
+    if (endDateString.empty() || endDateString == "m" || endDateString == "M")
+    {
+        endDate = Date(Date::daysInMonth(today.getMonth(), today.getYear()), today.getMonth(), today.getYear());
+    }
+    else if (endDateString == "y" || endDateString == "Y")
+    {
+        endDate = Date(31, 12, today.getYear());
+    }
+    else if (!Date::parse(endDateString, endDate) || !endDate.checkValidity()) // Check if date is valid
+    {
+        std::cout << "Invalid date!" << std::endl;
+        return;
+    }
+    if (!(today < endDate))
+    {
+        std::cout << "The forecast has to end after today." << std::endl;
+        return;
+    }
+    Currency currency = readCurrency("Enter report currency");
+    user->generateForecastReport(endDate, currency);
     std::cout << "Do you want to save the report to a file? (y/n): ";
     char choice;
     std::cin >> choice; // Check if user wants to save the report to a file
@@ -942,28 +9960,120 @@ void generateCategoryReport(User *&user)
     {
         try
         {
-            user->createCategoryReportFile(categoryName);
+            std::shared_ptr<const User> view = user->snapshot();
+            reportExports().submit("Forecast report file", [view, endDate, currency]()
+                                   { view->createForecastReportFile(endDate, false, currency); });
+            std::cout << "The report file is being written in the background." << std::endl;
         }
         catch (const std::exception &e)
         {
             std::cout << e.what() << std::endl;
         }
     }
-    //std::cout << "Press enter to continue...";
     std::cin.ignore();
 }
 
+// Function to add the transactions of a file to the user logged in, leaving out duplicates if asked to
+void importTransactionFile(User *&user)
+{
+    std::string path, choice;
+    std::cout << "Enter file to import: ";
+    std::getline(std::cin, path);
+    std::cout << "Skip transactions that are already recorded? (y/n): ";
+    std::getline(std::cin, choice);
+    bool keepDuplicates = !(choice == "y" || choice == "Y");
+    size_t duplicates;
+    size_t added = importTransactions(*user, path, keepDuplicates, duplicates);
+    std::cout << added << " transactions imported." << std::endl;
+    if (duplicates > 0)
+    {
+        std::cout << duplicates << (keepDuplicates ? " of them look like duplicates." : " duplicates skipped.") << std::endl;
+    }
+    showBudgetAlerts(user);
+}
+
+// Function to list the groups of duplicate transactions of the user logged in and remove the extra copies if asked to
+void findDuplicates(User *&user)
+{
+    std::vector<std::vector<const Transaction *>> groups = user->findDuplicateGroups();
+    size_t removable = 0; // Transactions removeDuplicates would remove
+    for (const auto &group : groups)
+    {
+        std::cout << group.size() << " copies of:" << std::endl;
+        for (const auto &transaction : group)
+        {
+            printTransaction(transaction);
+            if (transaction != group.front() && user->isUnarchived(transaction->getId()))
+            {
+                ++removable;
+            }
+        }
+        std::cout << "--------------------------------------" << std::endl;
+    }
+    std::cout << groups.size() << " groups of duplicates found." << std::endl;
+    if (removable == 0)
+    {
+        return;
+    }
+    std::cout << "Remove " << removable << " extra copies, keeping the first of each group? (y/n): ";
+    std::string choice;
+    std::getline(std::cin, choice);
+    if (choice == "y" || choice == "Y")
+    {
+        std::cout << user->removeDuplicates() << " transactions removed." << std::endl;
+    }
+}
+
+// Function to show how long the operations of this session took and what they read, wrote, allocated and scanned
+void statistics()
+{
+    printStats(std::cout);
+    if (!statsEnabled())
+    {
+        return;
+    }
+    std::cout << "Save the statistics to reports/stats.json? (y/n): ";
+    std::string choice;
+    std::getline(std::cin, choice);
+    if (choice == "y" || choice == "Y")
+    {
+        dumpStats("reports/stats.json");
+        std::cout << "Statistics saved to reports/stats.json" << std::endl;
+    }
+}
+
 // Driver function
 
-int main()
+int main(int argc, char *argv[])
 {
-    users.clear();                                    // Clear set of users
-    std::ifstream file("data/users.txt");             // Open users.txt
-    for (std::string line; std::getline(file, line);) // Read users.txt line by line and add each line to the set of users
+    if (argc > 1) // Command line tools, run without the interactive menus
     {
-        users.insert(line);
+        std::string command = argv[1];
+        std::vector<std::string> args(argv + 2, argv + argc);
+        try
+        {
+            exchangeRates.load("data/rates.txt");
+            return runCommand(command, args);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+        return 1;
+    }
+
+    terminal().install(); // The menus are drawn through the renderer from here on
+    loadRegisteredUsers();
+    try
+    {
+        exchangeRates.load("data/rates.txt");
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << e.what() << std::endl; // Continue with BDT only
+        std::cout << "Press enter to continue..." << std::endl;
+        std::cin.ignore();
     }
-    file.close();
     User *user = nullptr; // Pointer to user object. If user is logged in, this pointer points to the user object. Otherwise, it is nullptr.
     std::string input;    // String to store user input, used for menu choices
     int choice;
@@ -1065,6 +10175,10 @@ int main()
                 }
                 else // If user is logged in, show user menu
                 {
+                    for (const auto &message : reportExports().takeMessages()) // Report files finished in the background
+                    {
+                        std::cout << message << std::endl;
+                    }
                     userMenu();
                     std::cout << "Enter your choice: ";
                     std::getline(std::cin, input);
@@ -1129,16 +10243,41 @@ int main()
                         }
                         break;
                     }
+                    case 'B': // Edit income/expense
+                    case 'b':
+                    {
+                        clearTerminal();
+                        std::cout << "     Edit Income/Expense" << std::endl;
+                        std::cout << "-------------------------------" << std::endl;
+                        try
+                        {
+                            editIncome(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
                     case '4': // View transactions
                     {
                         clearTerminal();
                         std::cout << "            Transactions:" << std::endl;
                         std::cout << "--------------------------------------" << std::endl;
-                        std::vector<Transaction *> transactions = user->getTransactions();
-                        for (const auto &transaction : transactions)
+                        user->forEachTransaction([](const Transaction *transaction)
+                                                 {
+                                                     printTransaction(transaction);
+                                                     std::cout << "--------------------------------------" << std::endl; });
+                        user->generateOccurrences();
+                        user->forEachRecurringOccurrence([](const Transaction *transaction)
+                                                         {
+                                                             printTransaction(transaction);
+                                                             std::cout << "--------------------------------------" << std::endl; });
+                        if (user->getArchivedTransactionCount() > 0)
                         {
-                            transaction->display();
-                            std::cout << "--------------------------------------" << std::endl;
+                            std::cout << user->getArchivedTransactionCount() << " older transactions are archived. They count in the balance and the reports and can be found with Search." << std::endl;
                         }
                         std::cout << "Press enter to continue...";
                         std::cin.ignore();
@@ -1147,7 +10286,7 @@ int main()
                     case '5': // View balance
                     {
                         clearTerminal();
-                        std::cout << "Balance: " << user->getBalance() << " BDT" << std::endl;
+                        std::cout << "Balance: " << user->getBalance() << " " << BASE_CURRENCY.toString() << std::endl;
                         std::cout << "Press enter to continue...";
                         std::cin.ignore();
                         break;
@@ -1217,6 +10356,161 @@ int main()
                         std::cin.ignore();
                         break;
                     }
+                    case 'A': // Generate time series report
+                    case 'a':
+                    {
+                        clearTerminal();
+                        std::cout << "            Time Series Report" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            generateTimeSeriesReport(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl; // Throw exception if date or period is invalid
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'C': // Search transactions
+                    case 'c':
+                    {
+                        clearTerminal();
+                        std::cout << "         Search Transactions" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        searchTransactions(user);
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'D': // Query transactions
+                    case 'd':
+                    {
+                        clearTerminal();
+                        std::cout << "         Query Transactions" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            queryTransactions(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'E': // Recurring transactions
+                    case 'e':
+                    {
+                        clearTerminal();
+                        std::cout << "       Recurring Transactions" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            recurringTransactions(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'F': // Budgets
+                    case 'f':
+                    {
+                        clearTerminal();
+                        std::cout << "                Budgets" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            budgets(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'G': // Statistics
+                    case 'g':
+                    {
+                        clearTerminal();
+                        std::cout << "              Statistics" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            statistics();
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'H': // Import transactions
+                    case 'h':
+                    {
+                        clearTerminal();
+                        std::cout << "         Import Transactions" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            importTransactionFile(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'I': // Find duplicates
+                    case 'i':
+                    {
+                        clearTerminal();
+                        std::cout << "           Find Duplicates" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            findDuplicates(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
+                    case 'J': // Forecast
+                    case 'j':
+                    {
+                        clearTerminal();
+                        std::cout << "               Forecast" << std::endl;
+                        std::cout << "--------------------------------------" << std::endl;
+                        try
+                        {
+                            forecastReport(user);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            std::cout << e.what() << std::endl;
+                        }
+                        std::cout << "Press enter to continue..." << std::endl;
+                        std::cin.ignore();
+                        break;
+                    }
                     case '9': // Logout
                     {
                         clearTerminal();